@@ -0,0 +1,8 @@
+#include "megamorphic.hpp"
+
+#include <sh/copyable_function.hpp>
+
+namespace
+{
+	const bool registered = sh::benchmark::megamorphic::register_megamorphic<sh::copyable_function<int(int)>>("sh::copyable_function");
+} // anonymous namespace
@@ -0,0 +1,6 @@
+#include "megamorphic.hpp"
+
+namespace
+{
+	const bool registered = sh::benchmark::megamorphic::register_megamorphic<int(*)(int)>("function_pointer");
+} // anonymous namespace
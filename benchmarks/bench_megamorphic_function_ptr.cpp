@@ -0,0 +1,6 @@
+#include "megamorphic.hpp"
+
+namespace
+{
+	const bool registered = sh::benchmark::megamorphic::register_megamorphic<sh::function_ptr<int(int)>>("sh::function_ptr");
+} // anonymous namespace
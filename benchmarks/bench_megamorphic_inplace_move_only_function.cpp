@@ -0,0 +1,8 @@
+#include "megamorphic.hpp"
+
+#include <sh/inplace_move_only_function.hpp>
+
+namespace
+{
+	const bool registered = sh::benchmark::megamorphic::register_megamorphic<sh::inplace_move_only_function<int(int), 8>>("sh::inplace_move_only_function");
+} // anonymous namespace
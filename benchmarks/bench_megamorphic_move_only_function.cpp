@@ -0,0 +1,8 @@
+#include "megamorphic.hpp"
+
+#include <sh/move_only_function.hpp>
+
+namespace
+{
+	const bool registered = sh::benchmark::megamorphic::register_megamorphic<sh::move_only_function<int(int)>>("sh::move_only_function");
+} // anonymous namespace
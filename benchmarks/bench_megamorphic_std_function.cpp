@@ -0,0 +1,8 @@
+#include "megamorphic.hpp"
+
+#include <functional>
+
+namespace
+{
+	const bool registered = sh::benchmark::megamorphic::register_megamorphic<std::function<int(int)>>("std::function");
+} // anonymous namespace
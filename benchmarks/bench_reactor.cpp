@@ -0,0 +1,150 @@
+#include "benchmark.hpp"
+
+#include <sh/reactor.hpp>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace sh::benchmark;
+
+namespace
+{
+	// Write a byte to a pipe and dispatch its readiness, one loop iteration per operation.
+	const registrar pipe_round_trip{ "sh::reactor/pipe_round_trip", [](state& run)
+	{
+		run.pause();
+		int fds[2];
+		if (::pipe(fds) != 0)
+		{
+			return;
+		}
+		sh::reactor<> loop;
+		loop.add(fds[0], EPOLLIN, [fd = fds[0]](std::uint32_t)
+		{
+			char value;
+			static_cast<void>(::read(fd, &value, 1));
+		});
+		run.resume();
+		for (size_type i = 0; i < run.iterations(); ++i)
+		{
+			const char value = 'x';
+			static_cast<void>(::write(fds[1], &value, 1));
+			loop.run_once(-1);
+		}
+		run.pause();
+		::close(fds[0]);
+		::close(fds[1]);
+	} };
+
+	/**	Bind a socket to an ephemeral loopback port.
+	 *	@param fd The socket.
+	 *	@param address Receives the bound address.
+	 *	@return True if bound.
+	 */
+	bool bind_loopback(const int fd, sockaddr_in& address)
+	{
+		address = sockaddr_in{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t length = sizeof(address);
+		return ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0
+			&& ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) == 0;
+	}
+
+	/**	Send a byte from one connected socket and dispatch the other's readiness, one loop iteration per operation.
+	 *	Sockets go through the kernel's network stack where a pipe does not, so this is the cost servers see.
+	 *	@param run The benchmark state.
+	 *	@param sender The sending socket.
+	 *	@param receiver The receiving socket.
+	 */
+	void socket_round_trip(state& run, const int sender, const int receiver)
+	{
+		sh::reactor<> loop;
+		loop.add(receiver, EPOLLIN, [receiver](std::uint32_t)
+		{
+			char value;
+			static_cast<void>(::recv(receiver, &value, 1, 0));
+		});
+		run.resume();
+		for (size_type i = 0; i < run.iterations(); ++i)
+		{
+			const char value = 'x';
+			static_cast<void>(::send(sender, &value, 1, 0));
+			loop.run_once(-1);
+		}
+		run.pause();
+	}
+
+	// Datagrams between two UDP sockets on the loopback interface.
+	const registrar udp_round_trip{ "sh::reactor/udp_round_trip", [](state& run)
+	{
+		run.pause();
+		const int receiver = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		const int sender = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		sockaddr_in address;
+		if (receiver != -1 && sender != -1 && bind_loopback(receiver, address)
+			&& ::connect(sender, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+		{
+			socket_round_trip(run, sender, receiver);
+		}
+		::close(sender);
+		::close(receiver);
+	} };
+
+	// Bytes over a TCP connection on the loopback interface, with Nagle's algorithm off so each is sent at once.
+	const registrar tcp_round_trip{ "sh::reactor/tcp_round_trip", [](state& run)
+	{
+		run.pause();
+		const int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		const int sender = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		int receiver = -1;
+		sockaddr_in address;
+		const int enable = 1;
+		if (listener != -1 && sender != -1 && bind_loopback(listener, address) && ::listen(listener, 1) == 0
+			&& ::connect(sender, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0
+			&& (receiver = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) != -1
+			&& ::setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) == 0)
+		{
+			socket_round_trip(run, sender, receiver);
+		}
+		::close(receiver);
+		::close(sender);
+		::close(listener);
+	} };
+
+	// Post callbacks from another thread and run them on the loop.
+	const registrar cross_thread_post{ "sh::reactor/cross_thread_post", [](state& run)
+	{
+		run.pause();
+		sh::reactor<> loop;
+		size_type called = 0;
+		run.resume();
+		std::thread poster{ [&loop, &called, iterations = run.iterations()]()
+		{
+			for (size_type i = 0; i < iterations; ++i)
+			{
+				while (false == loop.post([&called]() { ++called; }))
+				{
+					std::this_thread::yield();
+				}
+			}
+		} };
+		while (called != run.iterations())
+		{
+			loop.run_once(-1);
+		}
+		poster.join();
+		run.pause();
+	} };
+} // anonymous namespace
+
+#endif
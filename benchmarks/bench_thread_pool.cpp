@@ -0,0 +1,99 @@
+#include "benchmark.hpp"
+#include "locked_pool.hpp"
+
+#include <sh/thread_pool.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace sh::benchmark;
+
+namespace
+{
+	/**	Wait for a count to reach zero, running queued tasks meanwhile.
+	 *	@param pool The pool.
+	 *	@param remaining The count.
+	 *	@tparam Pool The pool type.
+	 */
+	template <typename Pool>
+	void help_until_done(Pool& pool, const std::atomic<size_type>& remaining)
+	{
+		while (remaining.load(std::memory_order_acquire) != 0)
+		{
+			if (false == pool.try_run_one())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	/**	Register throughput benchmarks of one pool type at one thread count.
+	 *	@param name The pool's name.
+	 *	@param threads The pool's worker count, besides the submitting thread that helps.
+	 *	@tparam Pool The pool type, constructible from a thread count.
+	 */
+	template <typename Pool>
+	void register_pool(const std::string& name, const size_type threads)
+	{
+		const std::string suffix = "/threads=" + std::to_string(threads);
+		// Tasks submitted from outside the pool, which workers take from the shared queue.
+		registry::instance().add(name + "/external_submit" + suffix, [threads](state& run)
+		{
+			run.pause();
+			Pool pool{ threads };
+			std::atomic<size_type> remaining{ run.iterations() };
+			run.resume();
+			for (size_type i = 0; i < run.iterations(); ++i)
+			{
+				pool.submit([&remaining]() { remaining.fetch_sub(1, std::memory_order_release); });
+			}
+			help_until_done(pool, remaining);
+			run.pause();
+		});
+		// Tasks submitted from tasks, which a work-stealing pool keeps in the submitting worker's deque.
+		registry::instance().add(name + "/internal_fan_out" + suffix, [threads](state& run)
+		{
+			run.pause();
+			Pool pool{ threads };
+			std::atomic<size_type> remaining{ run.iterations() };
+			constexpr size_type fan_out = 64;
+			run.resume();
+			for (size_type begin = 0; begin < run.iterations(); begin += fan_out)
+			{
+				const size_type count = std::min(fan_out, run.iterations() - begin);
+				pool.submit([&pool, &remaining, count]()
+				{
+					for (size_type i = 0; i < count; ++i)
+					{
+						pool.submit([&remaining]() { remaining.fetch_sub(1, std::memory_order_release); });
+					}
+				});
+			}
+			help_until_done(pool, remaining);
+			run.pause();
+		});
+	}
+
+	/**	Register throughput benchmarks of one pool type at 1 to 64 threads, to show how each scales.
+	 *	@param name The pool's name.
+	 *	@tparam Pool The pool type, constructible from a thread count.
+	 */
+	template <typename Pool>
+	void register_pool(const std::string& name)
+	{
+		for (size_type threads = 1; threads <= 64; threads *= 2)
+		{
+			register_pool<Pool>(name, threads);
+		}
+	}
+
+	bool register_all()
+	{
+		register_pool<sh::thread_pool<>>("sh::thread_pool");
+		register_pool<locked_pool>("locked_pool");
+		return true;
+	}
+
+	const bool registered = register_all();
+} // anonymous namespace
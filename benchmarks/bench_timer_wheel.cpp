@@ -0,0 +1,59 @@
+#include "benchmark.hpp"
+
+#include <sh/timer_wheel.hpp>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace sh::benchmark;
+
+namespace
+{
+	/**	The number of timers pending while scheduling and cancelling.
+	 */
+	constexpr size_type pending_timers = 1000000;
+
+	// Schedule timers with random delays of up to a minute of millisecond ticks and fire them all.
+	const registrar schedule_fire{ "sh::timer_wheel/schedule_fire", [](state& run)
+	{
+		run.pause();
+		std::mt19937_64 random{ 42 };
+		std::vector<std::uint64_t> delays(run.iterations());
+		for (std::uint64_t& delay : delays)
+		{
+			delay = 1 + random() % 60000;
+		}
+		sh::timer_wheel<> wheel{ 0, run.iterations() };
+		size_type fired = 0;
+		run.resume();
+		for (const std::uint64_t delay : delays)
+		{
+			wheel.schedule(delay, [&fired]() { ++fired; });
+		}
+		while (false == wheel.empty())
+		{
+			wheel.advance(1000);
+		}
+		do_not_optimize(fired);
+	} };
+
+	// Schedule and cancel one timer while a million others are pending.
+	const registrar schedule_cancel{ "sh::timer_wheel/schedule_cancel_1M_pending", [](state& run)
+	{
+		run.pause();
+		std::mt19937_64 random{ 42 };
+		sh::timer_wheel<> wheel{ 0, pending_timers + 1 };
+		for (size_type i = 0; i < pending_timers; ++i)
+		{
+			wheel.schedule(1 + random() % 60000, []() {});
+		}
+		run.resume();
+		for (size_type i = 0; i < run.iterations(); ++i)
+		{
+			const auto timer = wheel.schedule(1 + (i * 7919) % 60000, []() {});
+			wheel.cancel(timer);
+		}
+		run.pause();
+	} };
+} // anonymous namespace
@@ -0,0 +1,217 @@
+#include "benchmark.hpp"
+
+#include <sh/copyable_function.hpp>
+#include <sh/function_ptr.hpp>
+#include <sh/function_ref.hpp>
+#include <sh/inplace_copyable_function.hpp>
+#include <sh/inplace_move_only_function.hpp>
+#include <sh/move_only_function.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+using namespace sh::benchmark;
+
+namespace
+{
+	/**	The number of wrappers constructed, moved or destroyed between pauses of the clock.
+	 */
+	constexpr size_type batch_size = 256;
+
+	/**	Uninitialized storage for a batch of wrappers.
+	 *	@tparam Wrapper The wrapper type.
+	 */
+	template <typename Wrapper>
+	struct batch final
+	{
+		struct alignas(Wrapper) slot final
+		{
+			unsigned char m_bytes[sizeof(Wrapper)];
+		};
+
+		Wrapper& operator[](const size_type i) noexcept
+		{
+			return *std::launder(reinterpret_cast<Wrapper*>(&m_slots[i]));
+		}
+		template <typename Arg>
+		void construct(const size_type count, Arg& arg)
+		{
+			for (size_type i = 0; i < count; ++i)
+			{
+				new(&m_slots[i]) Wrapper{ arg };
+				do_not_optimize((*this)[i]);
+			}
+		}
+		void construct_moved(const size_type count, batch& source) noexcept
+		{
+			for (size_type i = 0; i < count; ++i)
+			{
+				new(&m_slots[i]) Wrapper{ std::move(source[i]) };
+				do_not_optimize((*this)[i]);
+			}
+		}
+		void construct_copied(const size_type count, batch& source)
+		{
+			for (size_type i = 0; i < count; ++i)
+			{
+				new(&m_slots[i]) Wrapper{ static_cast<const Wrapper&>(source[i]) };
+				do_not_optimize((*this)[i]);
+			}
+		}
+		void destroy(const size_type count) noexcept
+		{
+			for (size_type i = 0; i < count; ++i)
+			{
+				do_not_optimize((*this)[i]);
+				(*this)[i].~Wrapper();
+			}
+		}
+
+		std::unique_ptr<slot[]> m_slots{ std::make_unique<slot[]>(batch_size) };
+	};
+
+	/**	Register construct, destroy, move, copy and call benchmarks of one wrapper holding one callable.
+	 *	@param name The benchmark name prefix, of wrapper and storage case.
+	 *	@param callable The callable to wrap, or to refer to if the wrapper is non-owning.
+	 *	@tparam Wrapper The wrapper type, with signature int(int).
+	 *	@tparam Callable The type of the given callable.
+	 */
+	template <typename Wrapper, typename Callable>
+	void register_wrapper(const std::string& name, const Callable callable)
+	{
+		registry::instance().add(name + "/construct", [callable](state& run) mutable
+		{
+			batch<Wrapper> wrappers;
+			for (size_type done = 0; done < run.iterations(); done += batch_size)
+			{
+				const size_type count = std::min(batch_size, run.iterations() - done);
+				wrappers.construct(count, callable);
+				run.pause();
+				wrappers.destroy(count);
+				run.resume();
+			}
+		});
+		registry::instance().add(name + "/destroy", [callable](state& run) mutable
+		{
+			batch<Wrapper> wrappers;
+			for (size_type done = 0; done < run.iterations(); done += batch_size)
+			{
+				const size_type count = std::min(batch_size, run.iterations() - done);
+				run.pause();
+				wrappers.construct(count, callable);
+				run.resume();
+				wrappers.destroy(count);
+			}
+		});
+		registry::instance().add(name + "/move", [callable](state& run) mutable
+		{
+			batch<Wrapper> sources;
+			batch<Wrapper> destinations;
+			for (size_type done = 0; done < run.iterations(); done += batch_size)
+			{
+				const size_type count = std::min(batch_size, run.iterations() - done);
+				run.pause();
+				sources.construct(count, callable);
+				run.resume();
+				destinations.construct_moved(count, sources);
+				run.pause();
+				sources.destroy(count);
+				destinations.destroy(count);
+				run.resume();
+			}
+		});
+		if constexpr (std::is_copy_constructible_v<Wrapper>)
+		{
+			registry::instance().add(name + "/copy", [callable](state& run) mutable
+			{
+				batch<Wrapper> sources;
+				batch<Wrapper> destinations;
+				for (size_type done = 0; done < run.iterations(); done += batch_size)
+				{
+					const size_type count = std::min(batch_size, run.iterations() - done);
+					run.pause();
+					sources.construct(count, callable);
+					run.resume();
+					destinations.construct_copied(count, sources);
+					run.pause();
+					sources.destroy(count);
+					destinations.destroy(count);
+					run.resume();
+				}
+			});
+		}
+		registry::instance().add(name + "/call", [callable](state& run) mutable
+		{
+			Wrapper wrapper{ callable };
+			int value = 0;
+			for (size_type i = 0; i < run.iterations(); ++i)
+			{
+				do_not_optimize(wrapper);
+				value = wrapper(int{ value });
+			}
+			do_not_optimize(value);
+		});
+	}
+
+	/**	A capture that fits every wrapper's in-place storage.
+	 */
+	struct small_capture final
+	{
+		std::intptr_t m_value;
+	};
+	/**	A capture too large for the in-place storage of move_only_function, copyable_function and std::function.
+	 */
+	struct large_capture final
+	{
+		std::array<int, 12> m_values;
+	};
+	/**	A capture more aligned than any wrapper's default in-place storage.
+	 */
+	struct alignas(32) aligned_capture final
+	{
+		int m_value;
+	};
+
+	/**	Register every wrapper for one storage case.
+	 *	@param storage The storage case's name.
+	 *	@param callable The callable.
+	 *	@tparam Callable The type of the given callable.
+	 */
+	template <typename Callable>
+	void register_storage(const std::string& storage, const Callable callable)
+	{
+		constexpr std::size_t inplace_alignment = std::max(alignof(void*), alignof(Callable));
+		register_wrapper<std::function<int(int)>>("std::function/" + storage, callable);
+#if defined(__cpp_lib_move_only_function)
+		register_wrapper<std::move_only_function<int(int)>>("std::move_only_function/" + storage, callable);
+#endif
+		register_wrapper<sh::copyable_function<int(int)>>("sh::copyable_function/" + storage, callable);
+		register_wrapper<sh::move_only_function<int(int)>>("sh::move_only_function/" + storage, callable);
+		register_wrapper<sh::inplace_copyable_function<int(int), 64, inplace_alignment>>("sh::inplace_copyable_function/" + storage, callable);
+		register_wrapper<sh::inplace_move_only_function<int(int), 64, inplace_alignment>>("sh::inplace_move_only_function/" + storage, callable);
+		register_wrapper<sh::function_ref<int(int)>>("sh::function_ref/" + storage, callable);
+	}
+
+	/**	Register every wrapper and storage case.
+	 *	@return True.
+	 */
+	bool register_all()
+	{
+		register_storage("empty", [](const int value) { return value + 1; });
+		register_storage("inplace", [capture = small_capture{ 1 }](const int value) { return value + static_cast<int>(capture.m_value); });
+		register_storage("heap", [capture = large_capture{}](const int value) { return value + capture.m_values[11] + 1; });
+		register_storage("overaligned", [capture = aligned_capture{ 1 }](const int value) { return value + capture.m_value; });
+		// function_ptr only points at callables, so has one storage case.
+		register_wrapper<sh::function_ptr<int(int)>>("sh::function_ptr/pointer", [](const int value) { return value + 1; });
+		return true;
+	}
+
+	const bool registered = register_all();
+} // anonymous namespace
@@ -0,0 +1,597 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__BENCHMARKS__BENCHMARK_HPP
+#define INC_SH__BENCHMARKS__BENCHMARK_HPP
+
+/**	@file
+ *	This file declares a small, dependency-free microbenchmark harness:
+ *	registration, calibration, warmup, repetitions and percentile reports,
+ *	optionally with hardware counters and JSON output.
+ */
+
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace sh
+{
+
+namespace benchmark
+{
+
+using size_type = std::size_t;
+using clock_type = std::chrono::steady_clock;
+
+/**	Prevent the compiler from assuming anything about memory across this point.
+ */
+inline void clobber_memory() noexcept
+{
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : : "memory");
+#endif
+}
+/**	Prevent the compiler from optimizing away the computation of a value.
+ *	@param value The value, which is treated as read and possibly modified.
+ *	@tparam T The value's type.
+ */
+template <typename T>
+inline void do_not_optimize(T& value) noexcept
+{
+#if defined(_MSC_VER)
+	static_cast<void>(*static_cast<const volatile char*>(static_cast<const volatile void*>(&value)));
+	_ReadWriteBarrier();
+#elif defined(__clang__)
+	asm volatile("" : "+r,m"(value) : : "memory");
+#else
+	asm volatile("" : "+m,r"(value) : : "memory");
+#endif
+}
+/**	Prevent the compiler from optimizing away the computation of a value.
+ *	@param value The value, which is treated as read.
+ *	@tparam T The value's type.
+ */
+template <typename T>
+inline void do_not_optimize(const T& value) noexcept
+{
+#if defined(_MSC_VER)
+	static_cast<void>(*static_cast<const volatile char*>(static_cast<const volatile void*>(&value)));
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+/**	The state of one timed run of a benchmark body.
+ *	@detail The body performs iterations() operations. The clock runs from
+ *	before the body is called until it returns, except between pause and
+ *	resume, which bodies use to exclude setup and teardown from batches.
+ */
+class state final
+{
+public:
+	/**	Constructor.
+	 *	@param iterations The number of operations to perform.
+	 *	@param counters Hardware counters to pause and resume with the clock, or null.
+	 */
+	explicit state(const size_type iterations, perf_counters* const counters = nullptr) noexcept
+		: m_iterations{ iterations }
+		, m_counters{ counters }
+	{ }
+
+	/**	The number of operations the body must perform.
+	 *	@return The iteration count.
+	 */
+	size_type iterations() const noexcept
+	{
+		return m_iterations;
+	}
+	/**	Stop the clock, if running.
+	 */
+	void pause() noexcept
+	{
+		if (m_running)
+		{
+			m_elapsed += clock_type::now() - m_start;
+			m_running = false;
+			if (m_counters != nullptr)
+			{
+				m_counters->pause();
+			}
+		}
+	}
+	/**	Restart the clock.
+	 */
+	void resume() noexcept
+	{
+		if (m_counters != nullptr)
+		{
+			m_counters->resume();
+		}
+		m_running = true;
+		m_start = clock_type::now();
+	}
+
+	/**	Start the clock, before calling the body.
+	 */
+	void start() noexcept
+	{
+		m_elapsed = clock_type::duration::zero();
+		if (m_counters != nullptr)
+		{
+			m_counters->reset();
+		}
+		resume();
+	}
+	/**	Stop the clock, after the body returns, which may have left it paused.
+	 *	@return The time the clock ran.
+	 */
+	clock_type::duration stop() noexcept
+	{
+		pause();
+		return m_elapsed;
+	}
+
+private:
+	size_type m_iterations;
+	perf_counters* m_counters;
+	clock_type::time_point m_start{};
+	clock_type::duration m_elapsed{ clock_type::duration::zero() };
+	bool m_running{ false };
+};
+
+using body_type = std::function<void(state&)>;
+
+/**	Options controlling how benchmarks run.
+ */
+struct options final
+{
+	/**	Run only benchmarks whose names contain this.
+	 */
+	std::string m_filter;
+	/**	The number of timed repetitions, after one warmup repetition.
+	 */
+	size_type m_repetitions{ 11 };
+	/**	The minimum duration of each repetition, reached by calibrating the iteration count.
+	 */
+	std::chrono::nanoseconds m_min_time{ std::chrono::milliseconds{ 20 } };
+	/**	List the benchmarks rather than running them.
+	 */
+	bool m_list{ false };
+	/**	Also measure hardware counters, in separate passes that do not affect the timings.
+	 */
+	bool m_counters{ false };
+	/**	If not empty, the path of a JSON file to which to write the results.
+	 */
+	std::string m_json;
+};
+
+/**	The measurements of one benchmark.
+ */
+struct result final
+{
+	std::string m_name;
+	/**	The number of operations per repetition.
+	 */
+	size_type m_iterations{ 0 };
+	/**	Nanoseconds per operation of each repetition, sorted ascending.
+	 */
+	std::vector<double> m_samples;
+	/**	Hardware events per operation, the median of the counted passes, if counted.
+	 */
+	perf_counters::values_type m_counters{};
+	/**	True if m_counters holds measurements.
+	 */
+	bool m_counted{ false };
+
+	/**	A percentile of the repetitions, by nearest rank.
+	 *	@param fraction The percentile as a fraction in [0, 1].
+	 *	@return Nanoseconds per operation.
+	 */
+	double percentile(const double fraction) const noexcept
+	{
+		if (m_samples.empty())
+		{
+			return 0;
+		}
+		const double rank = fraction * static_cast<double>(m_samples.size() - 1);
+		return m_samples[static_cast<size_type>(rank + 0.5)];
+	}
+	/**	The median of the repetitions.
+	 *	@return Nanoseconds per operation.
+	 */
+	double median() const noexcept
+	{
+		return percentile(0.5);
+	}
+};
+
+/**	The process-wide list of registered benchmarks.
+ */
+class registry final
+{
+public:
+	/**	The process-wide registry.
+	 *	@return A reference to a static registry.
+	 */
+	static registry& instance()
+	{
+		static registry instance;
+		return instance;
+	}
+
+	/**	Register a benchmark.
+	 *	@param name The name, with '/' separating levels such as wrapper, storage and operation.
+	 *	@param body The body, performing state::iterations() operations per call.
+	 */
+	void add(std::string name, body_type body)
+	{
+		m_benchmarks.emplace_back(std::move(name), std::move(body));
+	}
+	/**	The registered benchmarks, sorted by name.
+	 *	@return The benchmarks.
+	 */
+	const std::vector<std::pair<std::string, body_type>>& benchmarks()
+	{
+		std::stable_sort(m_benchmarks.begin(), m_benchmarks.end(), [](const auto& lhs, const auto& rhs)
+		{
+			return lhs.first < rhs.first;
+		});
+		return m_benchmarks;
+	}
+
+private:
+	registry() = default;
+
+	std::vector<std::pair<std::string, body_type>> m_benchmarks;
+};
+
+/**	Registers a benchmark during static initialization.
+ */
+struct registrar final
+{
+	registrar(std::string name, body_type body)
+	{
+		registry::instance().add(std::move(name), std::move(body));
+	}
+};
+
+/**	Time one call of a body.
+ *	@param body The body.
+ *	@param iterations The number of operations.
+ *	@param counters Hardware counters to run with the clock, or null.
+ *	@return The time the clock ran.
+ */
+inline clock_type::duration time_body(const body_type& body, const size_type iterations, perf_counters* const counters = nullptr)
+{
+	state run{ iterations, counters };
+	run.start();
+	body(run);
+	return run.stop();
+}
+/**	Calibrate, warm up and repeatedly time a benchmark, then count hardware events if given counters.
+ *	@detail Reading counters at every pause and resume costs system calls,
+ *	so counting happens in passes after, and separate from, the timed
+ *	repetitions.
+ *	@param name The benchmark's name.
+ *	@param body The benchmark's body.
+ *	@param settings The options.
+ *	@param counters Hardware counters, or null to only time.
+ *	@return The measurements.
+ */
+inline result run(const std::string& name, const body_type& body, const options& settings, perf_counters* const counters = nullptr)
+{
+	result measured;
+	measured.m_name = name;
+	// Grow the iteration count until a run lasts the minimum time; this also warms caches and predictors.
+	size_type iterations = 1;
+	for (;;)
+	{
+		const auto elapsed = time_body(body, iterations);
+		if (elapsed >= settings.m_min_time || iterations >= (size_type{ 1 } << 40))
+		{
+			break;
+		}
+		const double scale = elapsed.count() <= 0 ? 100.0
+			: std::min(100.0, 1.4 * static_cast<double>(settings.m_min_time.count()) / static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+		iterations = std::max(iterations + 1, static_cast<size_type>(static_cast<double>(iterations) * scale));
+	}
+	measured.m_iterations = iterations;
+	time_body(body, iterations);
+	for (size_type i = 0; i < settings.m_repetitions; ++i)
+	{
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(time_body(body, iterations));
+		measured.m_samples.push_back(static_cast<double>(elapsed.count()) / static_cast<double>(iterations));
+	}
+	std::sort(measured.m_samples.begin(), measured.m_samples.end());
+	if (counters != nullptr && counters->available())
+	{
+		constexpr size_type passes = 3;
+		std::array<perf_counters::values_type, passes> counted;
+		for (perf_counters::values_type& pass : counted)
+		{
+			time_body(body, iterations, counters);
+			pass = counters->totals();
+		}
+		for (size_type event = 0; event < perf_counters::event_count; ++event)
+		{
+			std::array<double, passes> per_pass;
+			for (size_type i = 0; i < passes; ++i)
+			{
+				per_pass[i] = counted[i][event] / static_cast<double>(iterations);
+			}
+			std::sort(per_pass.begin(), per_pass.end());
+			measured.m_counters[event] = per_pass[passes / 2];
+		}
+		measured.m_counted = true;
+	}
+	return measured;
+}
+
+/**	Parse options from the command line.
+ *	@detail Accepts --filter=TEXT, --repetitions=N, --min-time-ms=N, --list,
+ *	--counters and --json=PATH.
+ *	@param argc The argument count.
+ *	@param argv The arguments.
+ *	@param settings The options to update.
+ *	@return True if every argument was understood.
+ */
+inline bool parse(const int argc, char** const argv, options& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* const arg = argv[i];
+		const auto value = [arg](const char* const prefix) -> const char*
+		{
+			const size_type length = std::strlen(prefix);
+			return std::strncmp(arg, prefix, length) == 0 ? arg + length : nullptr;
+		};
+		if (const char* const filter = value("--filter="))
+		{
+			settings.m_filter = filter;
+		}
+		else if (const char* const repetitions = value("--repetitions="))
+		{
+			settings.m_repetitions = std::max<size_type>(1, std::strtoull(repetitions, nullptr, 10));
+		}
+		else if (const char* const min_time = value("--min-time-ms="))
+		{
+			settings.m_min_time = std::chrono::milliseconds{ std::strtoull(min_time, nullptr, 10) };
+		}
+		else if (const char* const json = value("--json="))
+		{
+			settings.m_json = json;
+		}
+		else if (std::strcmp(arg, "--list") == 0)
+		{
+			settings.m_list = true;
+		}
+		else if (std::strcmp(arg, "--counters") == 0)
+		{
+			settings.m_counters = true;
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--filter=TEXT] [--repetitions=N] [--min-time-ms=N] [--list] [--counters] [--json=PATH]\n", argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+/**	Write a JSON string literal, escaping as needed.
+ *	@param file The file to which to write.
+ *	@param text The string's contents.
+ */
+inline void write_json_string(std::FILE* const file, const std::string& text)
+{
+	std::fputc('"', file);
+	for (const char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			std::fprintf(file, "\\%c", c);
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			std::fprintf(file, "\\u%04x", static_cast<unsigned>(c));
+		}
+		else
+		{
+			std::fputc(c, file);
+		}
+	}
+	std::fputc('"', file);
+}
+/**	Write results as JSON, for comparing runs across builds.
+ *	@param path The file's path.
+ *	@param results The measurements.
+ *	@param counters The hardware counters used, or null.
+ *	@return True if the file was written.
+ */
+inline bool write_json(const std::string& path, const std::vector<result>& results, const perf_counters* const counters)
+{
+	std::FILE* const file = std::fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	std::fprintf(file, "{\n\t\"context\": {\n\t\t\"compiler\": ");
+#if defined(__VERSION__)
+	write_json_string(file, __VERSION__);
+#elif defined(_MSC_FULL_VER)
+	write_json_string(file, "MSVC " + std::to_string(_MSC_FULL_VER));
+#else
+	write_json_string(file, "unknown");
+#endif
+	std::fprintf(file, ",\n\t\t\"cplusplus\": %ld,\n\t\t\"assertions\": %s,\n\t\t\"counters\": [",
+		static_cast<long>(__cplusplus),
+#if defined(NDEBUG)
+		"false"
+#else
+		"true"
+#endif
+	);
+	bool first = true;
+	for (size_type event = 0; counters != nullptr && event < perf_counters::event_count; ++event)
+	{
+		if (counters->valid(event))
+		{
+			std::fprintf(file, "%s\"%s\"", first ? "" : ", ", perf_counters::name(event));
+			first = false;
+		}
+	}
+	std::fprintf(file, "]\n\t},\n\t\"benchmarks\": [");
+	for (size_type i = 0; i < results.size(); ++i)
+	{
+		const result& measured = results[i];
+		std::fprintf(file, "%s\n\t\t{\n\t\t\t\"name\": ", i == 0 ? "" : ",");
+		write_json_string(file, measured.m_name);
+		std::fprintf(file, ",\n\t\t\t\"iterations\": %zu,\n\t\t\t\"median_ns\": %.4f,\n\t\t\t\"p10_ns\": %.4f,\n\t\t\t\"p90_ns\": %.4f,\n\t\t\t\"samples_ns\": [",
+			measured.m_iterations, measured.median(), measured.percentile(0.1), measured.percentile(0.9));
+		for (size_type j = 0; j < measured.m_samples.size(); ++j)
+		{
+			std::fprintf(file, "%s%.4f", j == 0 ? "" : ", ", measured.m_samples[j]);
+		}
+		std::fprintf(file, "]");
+		if (measured.m_counted)
+		{
+			std::fprintf(file, ",\n\t\t\t\"per_operation\": {");
+			first = true;
+			for (size_type event = 0; event < perf_counters::event_count; ++event)
+			{
+				if (counters->valid(event))
+				{
+					std::fprintf(file, "%s\"%s\": %.4f", first ? " " : ", ", perf_counters::name(event), measured.m_counters[event]);
+					first = false;
+				}
+			}
+			std::fprintf(file, " }");
+		}
+		std::fprintf(file, "\n\t\t}");
+	}
+	std::fprintf(file, "\n\t]\n}\n");
+	return std::fclose(file) == 0;
+}
+
+/**	Run every registered benchmark matching the options and print a table.
+ *	@detail With --counters, columns of hardware events per operation follow
+ *	for each event that could be opened; if none could, a note goes to
+ *	stderr and only times are reported.
+ *	@param argc The argument count.
+ *	@param argv The arguments.
+ *	@return The process exit code.
+ */
+inline int run_all(const int argc, char** const argv)
+{
+	options settings;
+	if (false == parse(argc, argv, settings))
+	{
+		return EXIT_FAILURE;
+	}
+	std::unique_ptr<perf_counters> counters;
+	if (settings.m_counters && false == settings.m_list)
+	{
+		counters = std::make_unique<perf_counters>();
+		if (false == counters->available())
+		{
+			std::fprintf(stderr, "hardware counters unavailable (%s); reporting times only\n", counters->error().c_str());
+			counters.reset();
+		}
+	}
+	if (false == settings.m_list)
+	{
+		std::printf("%-56s %12s %10s %10s %10s", "benchmark (ns/op)", "iterations", "median", "p10", "p90");
+		for (size_type event = 0; counters != nullptr && event < perf_counters::event_count; ++event)
+		{
+			if (counters->valid(event))
+			{
+				std::printf(" %13s", perf_counters::name(event));
+			}
+		}
+		std::printf("\n");
+	}
+	std::vector<result> results;
+	for (const auto& [name, body] : registry::instance().benchmarks())
+	{
+		if (name.find(settings.m_filter) == std::string::npos)
+		{
+			continue;
+		}
+		if (settings.m_list)
+		{
+			std::printf("%s\n", name.c_str());
+			continue;
+		}
+		results.push_back(run(name, body, settings, counters.get()));
+		const result& measured = results.back();
+		std::printf("%-56s %12zu %10.2f %10.2f %10.2f", name.c_str(), measured.m_iterations,
+			measured.median(), measured.percentile(0.1), measured.percentile(0.9));
+		for (size_type event = 0; counters != nullptr && event < perf_counters::event_count; ++event)
+		{
+			if (counters->valid(event))
+			{
+				std::printf(" %13.2f", measured.m_counters[event]);
+			}
+		}
+		std::printf("\n");
+		std::fflush(stdout);
+	}
+	if (false == settings.m_json.empty() && false == write_json(settings.m_json, results, counters.get()))
+	{
+		std::fprintf(stderr, "cannot write %s\n", settings.m_json.c_str());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+} // namespace benchmark
+
+} // namespace sh
+
+#endif
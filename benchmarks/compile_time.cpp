@@ -0,0 +1,345 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**	@file
+ *	Measures the compile-time cost of wrapper instantiations: generates
+ *	translation units instantiating each wrapper with many distinct
+ *	callable and signature pairs, compiles each with the project's compiler,
+ *	and reports wall time and peak compiler memory, also per instantiation
+ *	beyond a baseline that includes the same header and defines the same
+ *	callables but instantiates no wrappers, so parsing the header is not
+ *	counted as instantiation.
+ */
+
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace sh::benchmark;
+
+namespace
+{
+	/**	How to generate one wrapper's instantiations.
+	 */
+	struct wrapper_spec final
+	{
+		/**	The wrapper's name, as reported.
+		 */
+		const char* m_name;
+		/**	The header to include.
+		 */
+		const char* m_header;
+		/**	The wrapper type, with SIG standing for the signature.
+		 */
+		const char* m_type;
+		/**	True if the wrapper refers to, rather than owns, its callable.
+		 */
+		bool m_refers;
+	};
+
+	const wrapper_spec specs[] = {
+		{ "std::function", "<functional>", "std::function<SIG>", false },
+		{ "sh::function_ptr", "<sh/function_ptr.hpp>", "sh::function_ptr<SIG>", true },
+		{ "sh::function_ref", "<sh/function_ref.hpp>", "sh::function_ref<SIG>", true },
+		{ "sh::copyable_function", "<sh/copyable_function.hpp>", "sh::copyable_function<SIG>", false },
+		{ "sh::move_only_function", "<sh/move_only_function.hpp>", "sh::move_only_function<SIG>", false },
+		{ "sh::inplace_copyable_function", "<sh/inplace_copyable_function.hpp>", "sh::inplace_copyable_function<SIG, 16>", false },
+		{ "sh::inplace_move_only_function", "<sh/inplace_move_only_function.hpp>", "sh::inplace_move_only_function<SIG, 16>", false },
+	};
+
+	/**	One compilation's cost.
+	 */
+	struct measurement final
+	{
+		bool m_succeeded{ false };
+		double m_seconds{ 0 };
+		/**	The compiler's peak resident memory, in kibibytes.
+		 */
+		long m_peak_kib{ 0 };
+	};
+
+	/**	Generate a translation unit.
+	 *	@param path The file to write.
+	 *	@param spec The wrapper.
+	 *	@param count The number of distinct callable and signature pairs.
+	 *	@param instantiate False to call the callables directly, as the wrapper's baseline.
+	 *	@return True if written.
+	 */
+	bool generate(const std::string& path, const wrapper_spec& spec, const size_type count, const bool instantiate)
+	{
+		std::FILE* const file = std::fopen(path.c_str(), "w");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		std::fprintf(file, "#include %s\n", spec.m_header);
+		std::fprintf(file, "\n"
+			"template <int Index> struct argument { int m_value; };\n"
+			"template <int Index> struct callable { int operator()(argument<Index> value) const noexcept { return value.m_value + Index; } };\n"
+			"template <int Index> const callable<Index> instance{};\n\n");
+		const std::string type = spec.m_type;
+		const size_type placeholder = type.find("SIG");
+		for (size_type i = 0; i < count; ++i)
+		{
+			const std::string signature = "int(argument<" + std::to_string(i) + ">)";
+			if (false == instantiate)
+			{
+				std::fprintf(file, "int run_%zu(const argument<%zu> value) { return instance<%zu>(argument<%zu>{ value }); }\n", i, i, i, i);
+				continue;
+			}
+			std::string wrapper = type;
+			wrapper.replace(placeholder, 3, signature);
+			std::fprintf(file, "int run_%zu(const argument<%zu> value) { const %s wrapper{ %s }; return wrapper(argument<%zu>{ value }); }\n",
+				i, i, wrapper.c_str(), spec.m_refers ? ("instance<" + std::to_string(i) + ">").c_str() : ("callable<" + std::to_string(i) + ">{}").c_str(), i);
+		}
+		return std::fclose(file) == 0;
+	}
+
+	/**	Compile a translation unit, measuring the compiler.
+	 *	@param arguments The compiler's command line.
+	 *	@return The cost, which did not succeed if the compiler could not run or failed.
+	 */
+	measurement compile(const std::vector<std::string>& arguments)
+	{
+		std::vector<char*> argv;
+		for (const std::string& argument : arguments)
+		{
+			argv.push_back(const_cast<char*>(argument.c_str()));
+		}
+		argv.push_back(nullptr);
+		measurement result;
+		const auto start = clock_type::now();
+		const pid_t child = ::fork();
+		if (child == 0)
+		{
+			::execvp(argv[0], argv.data());
+			::_exit(127);
+		}
+		if (child < 0)
+		{
+			return result;
+		}
+		int status = 0;
+		rusage usage;
+		if (::wait4(child, &status, 0, &usage) != child)
+		{
+			return result;
+		}
+		result.m_seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+#if defined(__APPLE__)
+		result.m_peak_kib = usage.ru_maxrss / 1024;
+#else
+		result.m_peak_kib = usage.ru_maxrss;
+#endif
+		result.m_succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		return result;
+	}
+
+	/**	One wrapper's cost at one count, with its baseline.
+	 */
+	struct result_row final
+	{
+		const char* m_name;
+		size_type m_count;
+		measurement m_measured;
+		/**	The same header and callables without wrapper instantiations.
+		 */
+		measurement m_baseline;
+	};
+
+	/**	Parse a comma-separated list of counts.
+	 *	@param text The list.
+	 *	@return The counts.
+	 */
+	std::vector<size_type> parse_counts(const char* text)
+	{
+		std::vector<size_type> counts;
+		while (*text != '\0')
+		{
+			char* end = nullptr;
+			counts.push_back(std::strtoull(text, &end, 10));
+			text = *end == ',' ? end + 1 : end + std::strlen(end);
+		}
+		return counts;
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	std::vector<size_type> counts{ 100, 1000, 10000 };
+	std::string filter;
+	std::string directory = "compile-time";
+	std::string json;
+	std::string flags = "-O2";
+	bool time_trace = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* const arg = argv[i];
+		const auto value = [arg](const char* const prefix) -> const char*
+		{
+			const size_type length = std::strlen(prefix);
+			return std::strncmp(arg, prefix, length) == 0 ? arg + length : nullptr;
+		};
+		if (const char* const text = value("--filter="))
+		{
+			filter = text;
+		}
+		else if (const char* const list = value("--counts="))
+		{
+			counts = parse_counts(list);
+		}
+		else if (const char* const path = value("--directory="))
+		{
+			directory = path;
+		}
+		else if (const char* const options = value("--flags="))
+		{
+			flags = options;
+		}
+		else if (const char* const path = value("--json="))
+		{
+			json = path;
+		}
+		else if (std::strcmp(arg, "--time-trace") == 0)
+		{
+			time_trace = true;
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--filter=TEXT] [--counts=N,...] [--directory=PATH] [--flags=TEXT] [--time-trace] [--json=PATH]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (time_trace && false == SH_COMPILE_TIME_TRACE)
+	{
+		std::fprintf(stderr, "-ftime-trace requires clang; measuring without it\n");
+		time_trace = false;
+	}
+	::mkdir(directory.c_str(), 0755);
+
+	std::printf("%-32s %8s %10s %10s %10s %14s %14s\n", "wrapper", "count", "seconds", "baseline", "peak MiB", "ms/instance", "KiB/instance");
+	std::vector<result_row> results;
+	for (const size_type count : counts)
+	{
+		for (const wrapper_spec& spec : specs)
+		{
+			if (std::string{ spec.m_name }.find(filter) == std::string::npos)
+			{
+				continue;
+			}
+			std::string stem = spec.m_name;
+			for (char& c : stem)
+			{
+				c = c == ':' ? '_' : c;
+			}
+			stem = directory + "/" + stem + "_" + std::to_string(count);
+			result_row row{ spec.m_name, count, {}, {} };
+			for (const bool instantiate : { false, true })
+			{
+				const std::string source = stem + (instantiate ? "" : "_baseline");
+				if (false == generate(source + ".cpp", spec, count, instantiate))
+				{
+					std::fprintf(stderr, "cannot write %s.cpp\n", source.c_str());
+					return EXIT_FAILURE;
+				}
+				std::vector<std::string> arguments{ SH_COMPILE_TIME_CXX, "-std=c++17", "-I" SH_COMPILE_TIME_INCLUDE, "-c", source + ".cpp", "-o", source + ".o" };
+				for (size_type begin = 0; begin < flags.size(); )
+				{
+					const size_type end = std::min(flags.find(' ', begin), flags.size());
+					if (end > begin)
+					{
+						arguments.push_back(flags.substr(begin, end - begin));
+					}
+					begin = end + 1;
+				}
+				if (time_trace)
+				{
+					arguments.push_back("-ftime-trace");
+				}
+				const measurement measured = compile(arguments);
+				if (false == measured.m_succeeded)
+				{
+					std::fprintf(stderr, "failed to compile %s.cpp\n", source.c_str());
+					return EXIT_FAILURE;
+				}
+				(instantiate ? row.m_measured : row.m_baseline) = measured;
+			}
+			const double instances = static_cast<double>(std::max<size_type>(1, count));
+			std::printf("%-32s %8zu %10.2f %10.2f %10.1f %14.3f %14.2f\n", spec.m_name, count, row.m_measured.m_seconds,
+				row.m_baseline.m_seconds, static_cast<double>(row.m_measured.m_peak_kib) / 1024,
+				1000 * (row.m_measured.m_seconds - row.m_baseline.m_seconds) / instances,
+				static_cast<double>(row.m_measured.m_peak_kib - row.m_baseline.m_peak_kib) / instances);
+			std::fflush(stdout);
+			results.push_back(row);
+		}
+	}
+	if (time_trace)
+	{
+		std::printf("traces: %s/*.json\n", directory.c_str());
+	}
+
+	if (false == json.empty())
+	{
+		std::FILE* const file = std::fopen(json.c_str(), "w");
+		if (file == nullptr)
+		{
+			std::fprintf(stderr, "cannot write %s\n", json.c_str());
+			return EXIT_FAILURE;
+		}
+		std::fprintf(file, "{\n\t\"compiler\": ");
+		write_json_string(file, SH_COMPILE_TIME_CXX);
+		std::fprintf(file, ",\n\t\"flags\": ");
+		write_json_string(file, flags);
+		std::fprintf(file, ",\n\t\"results\": [");
+		for (size_type i = 0; i < results.size(); ++i)
+		{
+			std::fprintf(file, "%s\n\t\t{ \"wrapper\": ", i == 0 ? "" : ",");
+			write_json_string(file, results[i].m_name);
+			std::fprintf(file, ", \"count\": %zu, \"seconds\": %.3f, \"peak_kib\": %ld, \"baseline_seconds\": %.3f, \"baseline_peak_kib\": %ld }",
+				results[i].m_count, results[i].m_measured.m_seconds, results[i].m_measured.m_peak_kib,
+				results[i].m_baseline.m_seconds, results[i].m_baseline.m_peak_kib);
+		}
+		std::fprintf(file, "\n\t]\n}\n");
+		std::fclose(file);
+	}
+	return EXIT_SUCCESS;
+}
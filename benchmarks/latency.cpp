@@ -0,0 +1,242 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "benchmark.hpp"
+#include "latency.hpp"
+#include "locked_pool.hpp"
+
+#include <sh/mpmc_function_queue.hpp>
+#include <sh/reactor.hpp>
+#include <sh/thread_pool.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace sh::benchmark;
+
+namespace
+{
+	using task_type = latency_target::task_type;
+	using measure_type = latency_report(*)(const latency_options&);
+
+	latency_report measure_thread_pool(const latency_options& options)
+	{
+		sh::thread_pool<> pool{ options.m_consumers };
+		return measure_latency({ [&pool](task_type&& task) { pool.submit(std::move(task)); }, nullptr }, options);
+	}
+	latency_report measure_locked_pool(const latency_options& options)
+	{
+		locked_pool pool{ options.m_consumers };
+		return measure_latency({ [&pool](task_type&& task) { pool.submit(std::move(task)); }, nullptr }, options);
+	}
+	latency_report measure_mpmc_function_queue(const latency_options& options)
+	{
+		sh::mpmc_function_queue<void(), sizeof(task_type)> queue{ 4096 };
+		return measure_latency({
+			[&queue](task_type&& task)
+			{
+				while (false == queue.try_push(std::move(task)))
+				{
+					std::this_thread::yield();
+				}
+			},
+			[&queue]() { return queue.try_invoke(); }
+		}, options);
+	}
+#if defined(__linux__)
+	latency_report measure_reactor(const latency_options& options)
+	{
+		// A reactor runs on one thread.
+		latency_options single = options;
+		single.m_consumers = 1;
+		sh::reactor<> loop{ 4096 };
+		return measure_latency({
+			[&loop](task_type&& task)
+			{
+				while (false == loop.post(std::move(task)))
+				{
+					std::this_thread::yield();
+				}
+			},
+			[&loop]() { return loop.run_once(1) != 0; }
+		}, single);
+	}
+#endif
+
+	const std::vector<std::pair<const char*, measure_type>> targets{
+		{ "locked_pool", &measure_locked_pool },
+		{ "sh::mpmc_function_queue", &measure_mpmc_function_queue },
+#if defined(__linux__)
+		{ "sh::reactor", &measure_reactor },
+#endif
+		{ "sh::thread_pool", &measure_thread_pool },
+	};
+
+	/**	Parse a comma-separated list of processor indices.
+	 *	@param text The list.
+	 *	@return The indices.
+	 */
+	std::vector<int> parse_cpus(const char* text)
+	{
+		std::vector<int> cpus;
+		while (*text != '\0')
+		{
+			char* end = nullptr;
+			cpus.push_back(static_cast<int>(std::strtol(text, &end, 10)));
+			text = *end == ',' ? end + 1 : end + std::strlen(end);
+		}
+		return cpus;
+	}
+	/**	Write one histogram's summary as a JSON object.
+	 *	@param file The file to which to write.
+	 *	@param histogram The histogram.
+	 */
+	void write_json_summary(std::FILE* const file, const latency_histogram& histogram)
+	{
+		std::fprintf(file, "{ \"count\": %llu, \"mean_ns\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p99_9_ns\": %llu, \"max_ns\": %llu }",
+			static_cast<unsigned long long>(histogram.count()), histogram.mean(),
+			static_cast<unsigned long long>(histogram.percentile(50)), static_cast<unsigned long long>(histogram.percentile(99)),
+			static_cast<unsigned long long>(histogram.percentile(99.9)), static_cast<unsigned long long>(histogram.max()));
+	}
+	/**	Print one histogram's summary as a table row.
+	 *	@param name The target's name.
+	 *	@param kind Which latency the histogram holds.
+	 *	@param histogram The histogram.
+	 */
+	void print_summary(const char* const name, const char* const kind, const latency_histogram& histogram)
+	{
+		std::printf("%-26s %-9s %10.2f %10.2f %10.2f %12.2f\n", name, kind,
+			static_cast<double>(histogram.percentile(50)) / 1000, static_cast<double>(histogram.percentile(99)) / 1000,
+			static_cast<double>(histogram.percentile(99.9)) / 1000, static_cast<double>(histogram.max()) / 1000);
+	}
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	latency_options options;
+	std::string filter;
+	std::string json;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* const arg = argv[i];
+		const auto value = [arg](const char* const prefix) -> const char*
+		{
+			const std::size_t length = std::strlen(prefix);
+			return std::strncmp(arg, prefix, length) == 0 ? arg + length : nullptr;
+		};
+		if (const char* const text = value("--filter="))
+		{
+			filter = text;
+		}
+		else if (const char* const producers = value("--producers="))
+		{
+			options.m_producers = std::max<std::size_t>(1, std::strtoull(producers, nullptr, 10));
+		}
+		else if (const char* const consumers = value("--consumers="))
+		{
+			options.m_consumers = std::max<std::size_t>(1, std::strtoull(consumers, nullptr, 10));
+		}
+		else if (const char* const tasks = value("--tasks="))
+		{
+			options.m_tasks = std::max<std::size_t>(1, std::strtoull(tasks, nullptr, 10));
+		}
+		else if (const char* const rate = value("--rate="))
+		{
+			options.m_rate = std::strtod(rate, nullptr);
+		}
+		else if (const char* const cpus = value("--cpus="))
+		{
+			options.m_cpus = parse_cpus(cpus);
+		}
+		else if (const char* const path = value("--json="))
+		{
+			json = path;
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--filter=TEXT] [--producers=N] [--consumers=N] [--tasks=N] [--rate=PER_SECOND] [--cpus=A,B,...] [--json=PATH]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::printf("%zu producer(s), %zu consumer(s), %zu tasks each, ", options.m_producers, options.m_consumers, options.m_tasks);
+	if (options.m_rate > 0)
+	{
+		std::printf("open loop at %g tasks/s each\n", options.m_rate);
+	}
+	else
+	{
+		std::printf("closed loop\n");
+	}
+	std::printf("%-26s %-9s %10s %10s %10s %12s\n", "target (us)", "latency", "p50", "p99", "p99.9", "max");
+	std::vector<std::pair<const char*, latency_report>> reports;
+	for (const auto& [name, measure] : targets)
+	{
+		if (std::string{ name }.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+		reports.emplace_back(name, measure(options));
+		print_summary(name, "service", reports.back().second.m_service);
+		print_summary(name, "response", reports.back().second.m_response);
+		std::fflush(stdout);
+	}
+
+	if (false == json.empty())
+	{
+		std::FILE* const file = std::fopen(json.c_str(), "w");
+		if (file == nullptr)
+		{
+			std::fprintf(stderr, "cannot write %s\n", json.c_str());
+			return EXIT_FAILURE;
+		}
+		std::fprintf(file, "{\n\t\"options\": { \"producers\": %zu, \"consumers\": %zu, \"tasks\": %zu, \"rate\": %.1f },\n\t\"targets\": [",
+			options.m_producers, options.m_consumers, options.m_tasks, options.m_rate);
+		for (std::size_t i = 0; i < reports.size(); ++i)
+		{
+			std::fprintf(file, "%s\n\t\t{ \"name\": ", i == 0 ? "" : ",");
+			write_json_string(file, reports[i].first);
+			std::fprintf(file, ", \"duration_ns\": %lld,\n\t\t\t\"service\": ", static_cast<long long>(reports[i].second.m_duration.count()));
+			write_json_summary(file, reports[i].second.m_service);
+			std::fprintf(file, ",\n\t\t\t\"response\": ");
+			write_json_summary(file, reports[i].second.m_response);
+			std::fprintf(file, " }");
+		}
+		std::fprintf(file, "\n\t]\n}\n");
+		std::fclose(file);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,466 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__BENCHMARKS__LATENCY_HPP
+#define INC_SH__BENCHMARKS__LATENCY_HPP
+
+/**	@file
+ *	This file declares a log-linear latency histogram, in the manner of
+ *	HdrHistogram, and a harness measuring enqueue-to-execute latency of
+ *	executors and queues of move_only_function<void()> tasks.
+ */
+
+#include <sh/move_only_function.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace sh
+{
+
+namespace benchmark
+{
+
+/**	Counts values in buckets of bounded relative error.
+ *	@detail Values below the sub-bucket count are counted exactly; above,
+ *	each power of two is split into half as many linear sub-buckets, so
+ *	every value is counted with at least the given significant decimal
+ *	digits of precision. Recording does not allocate.
+ */
+class latency_histogram final
+{
+public:
+	using size_type = std::size_t;
+	using value_type = std::uint64_t;
+
+	/**	Constructor.
+	 *	@param highest The largest value to distinguish; larger values count as this.
+	 *	@param digits The significant decimal digits to preserve, from 1 to 5.
+	 */
+	explicit latency_histogram(const value_type highest = value_type{ 3600 } * 1000 * 1000 * 1000, const int digits = 3)
+	{
+		const value_type largest_exact = 2 * static_cast<value_type>(std::pow(10.0, std::clamp(digits, 1, 5)));
+		while ((value_type{ 1 } << m_sub_bucket_bits) < largest_exact)
+		{
+			++m_sub_bucket_bits;
+		}
+		m_highest = std::max(highest, (value_type{ 1 } << m_sub_bucket_bits) - 1);
+		m_counts.resize(index(m_highest) + 1);
+	}
+
+	/**	Count a value.
+	 *	@param value The value.
+	 *	@param count The number of times to count it.
+	 */
+	void record(const value_type value, const value_type count = 1) noexcept
+	{
+		m_counts[index(std::min(value, m_highest))] += count;
+		m_total += count;
+		m_max = std::max(m_max, value);
+		m_min = std::min(m_min, value);
+		m_sum += static_cast<double>(value) * static_cast<double>(count);
+	}
+	/**	Count a value, correcting for coordinated omission.
+	 *	@detail A measurement loop that waits for each operation before
+	 *	starting the next stops sampling while an operation stalls. Given the
+	 *	interval at which it meant to sample, this also counts the values the
+	 *	samples it missed would have had: value - interval, value - 2 *
+	 *	interval, and so on while at least interval.
+	 *	@param value The value.
+	 *	@param interval The expected interval between samples, or zero to not correct.
+	 */
+	void record_corrected(const value_type value, const value_type interval) noexcept
+	{
+		record(value);
+		if (interval == 0)
+		{
+			return;
+		}
+		for (value_type missed = value; missed >= 2 * interval; )
+		{
+			missed -= interval;
+			record(missed);
+		}
+	}
+	/**	Add another histogram's counts to this.
+	 *	@param other A histogram constructed with the same arguments.
+	 */
+	void merge(const latency_histogram& other) noexcept
+	{
+		for (size_type i = 0; i < std::min(m_counts.size(), other.m_counts.size()); ++i)
+		{
+			m_counts[i] += other.m_counts[i];
+		}
+		m_total += other.m_total;
+		m_max = std::max(m_max, other.m_max);
+		m_min = std::min(m_min, other.m_min);
+		m_sum += other.m_sum;
+	}
+	/**	Remove every count.
+	 */
+	void reset() noexcept
+	{
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		m_total = 0;
+		m_max = 0;
+		m_min = ~value_type{ 0 };
+		m_sum = 0;
+	}
+
+	/**	The number of values counted.
+	 *	@return The count.
+	 */
+	value_type count() const noexcept
+	{
+		return m_total;
+	}
+	/**	The largest value counted, exactly.
+	 *	@return The maximum, or zero if empty.
+	 */
+	value_type max() const noexcept
+	{
+		return m_max;
+	}
+	/**	The smallest value counted, exactly.
+	 *	@return The minimum, or zero if empty.
+	 */
+	value_type min() const noexcept
+	{
+		return m_total == 0 ? 0 : m_min;
+	}
+	/**	The mean of the values counted.
+	 *	@return The mean, or zero if empty.
+	 */
+	double mean() const noexcept
+	{
+		return m_total == 0 ? 0 : m_sum / static_cast<double>(m_total);
+	}
+	/**	The value below or at which a percentage of values fall.
+	 *	@param percentile The percentage, from 0 to 100.
+	 *	@return The highest value equivalent, within the precision, to that at the percentile, or zero if empty.
+	 */
+	value_type percentile(const double percentile) const noexcept
+	{
+		if (m_total == 0)
+		{
+			return 0;
+		}
+		const value_type rank = std::max<value_type>(1, static_cast<value_type>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(m_total))));
+		value_type seen = 0;
+		for (size_type i = 0; i < m_counts.size(); ++i)
+		{
+			seen += m_counts[i];
+			if (seen >= rank)
+			{
+				return std::min(highest_equivalent(i), m_max);
+			}
+		}
+		return m_max;
+	}
+
+private:
+	/**	The bucket counting a value.
+	 *	@param value The value, no more than m_highest.
+	 *	@return The index into m_counts.
+	 */
+	size_type index(const value_type value) const noexcept
+	{
+		size_type shift = 0;
+		while ((value >> shift) >= (value_type{ 1 } << m_sub_bucket_bits))
+		{
+			++shift;
+		}
+		return shift * (size_type{ 1 } << (m_sub_bucket_bits - 1)) + static_cast<size_type>(value >> shift);
+	}
+	/**	The largest value counted by a bucket.
+	 *	@param bucket The index into m_counts.
+	 *	@return The value.
+	 */
+	value_type highest_equivalent(const size_type bucket) const noexcept
+	{
+		const size_type half = size_type{ 1 } << (m_sub_bucket_bits - 1);
+		if (bucket < 2 * half)
+		{
+			return bucket;
+		}
+		const size_type shift = bucket / half - 1;
+		return (static_cast<value_type>(bucket - shift * half) << shift) + (value_type{ 1 } << shift) - 1;
+	}
+
+	/**	The log2 of the number of exactly counted values.
+	 */
+	size_type m_sub_bucket_bits{ 1 };
+	value_type m_highest{ 0 };
+	std::vector<value_type> m_counts;
+	value_type m_total{ 0 };
+	value_type m_max{ 0 };
+	value_type m_min{ ~value_type{ 0 } };
+	double m_sum{ 0 };
+};
+
+/**	Pin the calling thread to one processor.
+ *	@param cpu The processor's index, or negative to not pin.
+ *	@return True if pinned.
+ */
+inline bool pin_current_thread(const int cpu) noexcept
+{
+#if defined(__linux__)
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+	static_cast<void>(cpu);
+	return false;
+#endif
+}
+
+/**	How to load the executor or queue under test.
+ */
+struct latency_options final
+{
+	/**	The number of threads submitting tasks.
+	 */
+	std::size_t m_producers{ 1 };
+	/**	The number of threads the harness runs to call latency_target::m_run_one, if given.
+	 */
+	std::size_t m_consumers{ 1 };
+	/**	The number of tasks each producer submits.
+	 */
+	std::size_t m_tasks{ 100000 };
+	/**	Tasks per second per producer, at fixed intervals regardless of
+	 *	completion, or zero for closed-loop load where each producer waits for
+	 *	its task to execute before submitting the next.
+	 */
+	double m_rate{ 0 };
+	/**	Processors to which to pin producers and then consumers, cycling, or empty to not pin.
+	 */
+	std::vector<int> m_cpus;
+};
+
+/**	An executor or queue under test.
+ */
+struct latency_target final
+{
+	using task_type = sh::move_only_function<void()>;
+
+	/**	Submit a task, from any producer thread, retrying while full.
+	 */
+	std::function<void(task_type&&)> m_submit;
+	/**	Run one queued task, from any consumer thread, returning false if
+	 *	there was none. Leave empty for executors that run tasks on their own
+	 *	threads.
+	 */
+	std::function<bool()> m_run_one;
+};
+
+/**	The latencies measured by one run.
+ */
+struct latency_report final
+{
+	/**	Nanoseconds from submitting each task until it began executing.
+	 */
+	latency_histogram m_service;
+	/**	Nanoseconds from when each task should have been submitted until it
+	 *	began executing, so including time producers were held up: corrected
+	 *	for coordinated omission.
+	 */
+	latency_histogram m_response;
+	/**	The wall-clock duration of the run.
+	 */
+	std::chrono::nanoseconds m_duration{ 0 };
+};
+
+/**	Measure enqueue-to-execute latency.
+ *	@detail Open-loop producers submit on a fixed schedule and the response
+ *	latency is measured from each task's scheduled time, so a stall that
+ *	delays later submissions is charged to them. Closed-loop producers wait
+ *	for each task, so their response latency is corrected by the histogram,
+ *	taking the mean interval between submissions as the expected interval.
+ *	Timestamps are kept per task, each on its own cache line, and counted
+ *	into histograms after the run, so recording does not perturb it.
+ *	@param target The executor or queue.
+ *	@param options The load.
+ *	@return The latencies.
+ */
+inline latency_report measure_latency(const latency_target& target, const latency_options& options)
+{
+	using clock = std::chrono::steady_clock;
+	struct alignas(64) timestamps final
+	{
+		clock::time_point m_intended;
+		clock::time_point m_enqueued;
+		clock::time_point m_executed;
+		std::atomic<bool> m_done{ false };
+	};
+
+	const std::size_t producers = std::max<std::size_t>(1, options.m_producers);
+	const std::size_t total = producers * options.m_tasks;
+	const std::unique_ptr<timestamps[]> records = std::make_unique<timestamps[]>(total);
+	std::atomic<std::size_t> executed{ 0 };
+	std::atomic<bool> stopping{ false };
+	const auto cpu = [&options](const std::size_t thread) noexcept
+	{
+		return options.m_cpus.empty() ? -1 : options.m_cpus[thread % options.m_cpus.size()];
+	};
+
+	std::vector<std::thread> consumers;
+	if (target.m_run_one)
+	{
+		for (std::size_t i = 0; i < std::max<std::size_t>(1, options.m_consumers); ++i)
+		{
+			consumers.emplace_back([&target, &stopping, core = cpu(producers + i)]()
+			{
+				pin_current_thread(core);
+				while (false == stopping.load(std::memory_order_relaxed))
+				{
+					if (false == target.m_run_one())
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+	}
+
+	const std::chrono::nanoseconds period{ options.m_rate > 0 ? static_cast<std::int64_t>(1e9 / options.m_rate) : 0 };
+	std::atomic<std::size_t> ready{ 0 };
+	clock::time_point start;
+	std::vector<std::thread> producer_threads;
+	for (std::size_t p = 0; p < producers; ++p)
+	{
+		producer_threads.emplace_back([&, p]()
+		{
+			pin_current_thread(cpu(p));
+			ready.fetch_add(1, std::memory_order_acq_rel);
+			while (ready.load(std::memory_order_acquire) != producers + 1)
+			{
+				std::this_thread::yield();
+			}
+			timestamps* const mine = &records[p * options.m_tasks];
+			for (std::size_t k = 0; k < options.m_tasks; ++k)
+			{
+				timestamps& record = mine[k];
+				if (period.count() > 0)
+				{
+					record.m_intended = start + period * static_cast<std::int64_t>(k);
+					while (clock::now() < record.m_intended)
+					{
+						std::this_thread::yield();
+					}
+				}
+				record.m_enqueued = clock::now();
+				if (period.count() == 0)
+				{
+					record.m_intended = record.m_enqueued;
+				}
+				target.m_submit([&record, &executed]()
+				{
+					record.m_executed = clock::now();
+					record.m_done.store(true, std::memory_order_release);
+					executed.fetch_add(1, std::memory_order_release);
+				});
+				while (period.count() == 0 && false == record.m_done.load(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	while (ready.load(std::memory_order_acquire) != producers)
+	{
+		std::this_thread::yield();
+	}
+	start = clock::now() + std::chrono::milliseconds{ 1 };
+	ready.fetch_add(1, std::memory_order_acq_rel);
+	for (std::thread& thread : producer_threads)
+	{
+		thread.join();
+	}
+	while (executed.load(std::memory_order_acquire) != total)
+	{
+		std::this_thread::yield();
+	}
+	latency_report report;
+	report.m_duration = clock::now() - start;
+	stopping.store(true, std::memory_order_relaxed);
+	for (std::thread& thread : consumers)
+	{
+		thread.join();
+	}
+
+	const auto nanoseconds = [](const clock::duration duration) noexcept
+	{
+		return static_cast<latency_histogram::value_type>(std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+	};
+	for (std::size_t p = 0; p < producers; ++p)
+	{
+		const timestamps* const mine = &records[p * options.m_tasks];
+		const auto interval = options.m_tasks < 2 || period.count() > 0 ? 0
+			: nanoseconds(mine[options.m_tasks - 1].m_enqueued - mine[0].m_enqueued) / (options.m_tasks - 1);
+		for (std::size_t k = 0; k < options.m_tasks; ++k)
+		{
+			report.m_service.record(nanoseconds(mine[k].m_executed - mine[k].m_enqueued));
+			if (period.count() > 0)
+			{
+				report.m_response.record(nanoseconds(mine[k].m_executed - mine[k].m_intended));
+			}
+			else
+			{
+				report.m_response.record_corrected(nanoseconds(mine[k].m_executed - mine[k].m_enqueued), interval);
+			}
+		}
+	}
+	return report;
+}
+
+} // namespace benchmark
+
+} // namespace sh
+
+#endif
@@ -0,0 +1,140 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__BENCHMARKS__LOCKED_POOL_HPP
+#define INC_SH__BENCHMARKS__LOCKED_POOL_HPP
+
+/**	@file
+ *	This file declares the simplest thread pool, against which benchmarks
+ *	compare thread_pool.
+ */
+
+#include <sh/move_only_function.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+namespace benchmark
+{
+
+/**	A baseline pool for comparison: one deque guarded by one mutex, shared by every thread.
+ */
+class locked_pool final
+{
+public:
+	locked_pool(const locked_pool&) = delete;
+	locked_pool& operator=(const locked_pool&) = delete;
+
+	explicit locked_pool(std::size_t thread_count)
+	{
+		for (; thread_count > 0; --thread_count)
+		{
+			m_threads.emplace_back([this]() { work(); });
+		}
+	}
+	~locked_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_stopping = true;
+		}
+		m_ready.notify_all();
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	template <typename Callable>
+	void submit(Callable&& callable)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_tasks.emplace_back(std::forward<Callable>(callable));
+		}
+		m_ready.notify_one();
+	}
+	bool try_run_one()
+	{
+		sh::move_only_function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			if (m_tasks.empty())
+			{
+				return false;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+		return true;
+	}
+
+private:
+	void work()
+	{
+		for (;;)
+		{
+			sh::move_only_function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{ m_mutex };
+				m_ready.wait(lock, [this]() { return m_stopping || false == m_tasks.empty(); });
+				if (m_tasks.empty())
+				{
+					return;
+				}
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::deque<sh::move_only_function<void()>> m_tasks;
+	bool m_stopping{ false };
+	std::vector<std::thread> m_threads;
+};
+
+} // namespace benchmark
+
+} // namespace sh
+
+#endif
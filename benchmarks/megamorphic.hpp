@@ -0,0 +1,202 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__BENCHMARKS__MEGAMORPHIC_HPP
+#define INC_SH__BENCHMARKS__MEGAMORPHIC_HPP
+
+/**	@file
+ *	This file declares benchmarks calling arrays of wrappers spread over up
+ *	to 1024 generated callable types, sorted by type or shuffled, to
+ *	saturate the branch target buffer and instruction cache. Each wrapper
+ *	registers from its own bench_megamorphic_*.cpp, as every one
+ *	instantiates 1024 callable types and compiles slowly.
+ */
+
+#include "benchmark.hpp"
+
+#include <sh/function_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+namespace benchmark
+{
+
+namespace megamorphic
+{
+
+/**	The number of wrappers called in turn, enough to cycle through far more targets than a branch target buffer holds.
+ */
+constexpr size_type wrapper_count = 8192;
+/**	The largest number of distinct callable types.
+ */
+constexpr size_type max_types = 1024;
+
+/**	One of many generated callable types, each with distinct code.
+ *	@tparam Index The type's index, which also varies its arithmetic.
+ */
+template <size_type Index>
+struct generated_callable final
+{
+	int operator()(const int value) const noexcept
+	{
+		// Unsigned, so the result wraps rather than overflowing once callers feed results back in.
+		return static_cast<int>(static_cast<unsigned>(value) * static_cast<unsigned>(2 * Index + 1) + static_cast<unsigned>(Index));
+	}
+};
+/**	A long-lived instance of each generated callable, for non-owning wrappers.
+ */
+template <size_type Index>
+const generated_callable<Index> generated_instance{};
+
+/**	Wrap a generated callable.
+ *	@return The wrapper.
+ *	@tparam Wrapper The wrapper type, with signature int(int).
+ *	@tparam Index The callable's index.
+ */
+template <typename Wrapper, size_type Index>
+Wrapper make_wrapper()
+{
+	if constexpr (std::is_same_v<Wrapper, int(*)(int)>)
+	{
+		return [](const int value) { return generated_callable<Index>{}(value); };
+	}
+	else if constexpr (std::is_same_v<Wrapper, sh::function_ptr<int(int)>>)
+	{
+		return Wrapper{ generated_instance<Index> };
+	}
+	else
+	{
+		return Wrapper{ generated_callable<Index>{} };
+	}
+}
+/**	A table wrapping each generated callable by index.
+ *	@return The table of factories.
+ *	@tparam Wrapper The wrapper type.
+ *	@tparam Indices Every callable index.
+ */
+template <typename Wrapper, size_type... Indices>
+constexpr std::array<Wrapper(*)(), sizeof...(Indices)> make_factories(std::index_sequence<Indices...>) noexcept
+{
+	return { { &make_wrapper<Wrapper, Indices>... } };
+}
+
+/**	The order of wrappers in the array.
+ */
+enum class layout
+{
+	/**	Wrappers of the same type are adjacent, so consecutive calls mostly reach the same target.
+	 */
+	sorted,
+	/**	Wrappers are shuffled, so consecutive calls reach unpredictable targets.
+	 */
+	random
+};
+
+/**	Register a benchmark calling wrappers spread over several callable types.
+ *	@param name The benchmark name prefix, of the wrapper.
+ *	@param types The number of distinct callable types.
+ *	@param order The order of the wrappers.
+ *	@tparam Wrapper The wrapper type, with signature int(int).
+ */
+template <typename Wrapper>
+void register_dispatch(const std::string& name, const size_type types, const layout order)
+{
+	const std::string order_name = order == layout::sorted ? "sorted" : "random";
+	registry::instance().add(name + "/types=" + std::to_string(types) + "/" + order_name, [types, order](state& run)
+	{
+		run.pause();
+		static constexpr auto factories = make_factories<Wrapper>(std::make_index_sequence<max_types>{});
+		std::vector<size_type> indices(wrapper_count);
+		for (size_type i = 0; i < wrapper_count; ++i)
+		{
+			indices[i] = i % types;
+		}
+		if (order == layout::sorted)
+		{
+			std::sort(indices.begin(), indices.end());
+		}
+		else
+		{
+			std::shuffle(indices.begin(), indices.end(), std::mt19937_64{ 42 });
+		}
+		std::vector<Wrapper> wrappers;
+		wrappers.reserve(wrapper_count);
+		for (const size_type index : indices)
+		{
+			wrappers.push_back(factories[index]());
+		}
+		int value = 0;
+		run.resume();
+		for (size_type done = 0; done < run.iterations(); done += wrapper_count)
+		{
+			const size_type count = std::min(wrapper_count, run.iterations() - done);
+			for (size_type i = 0; i < count; ++i)
+			{
+				value = wrappers[i](int{ value });
+			}
+		}
+		run.pause();
+		do_not_optimize(value);
+	});
+}
+
+/**	Register every type count and layout of one wrapper.
+ *	@param name The wrapper's name.
+ *	@return True, for initializing a static.
+ *	@tparam Wrapper The wrapper type.
+ */
+template <typename Wrapper>
+bool register_megamorphic(const std::string& name)
+{
+	for (size_type types = 1; types <= max_types; types *= 2)
+	{
+		register_dispatch<Wrapper>("megamorphic/" + name, types, layout::sorted);
+		register_dispatch<Wrapper>("megamorphic/" + name, types, layout::random);
+	}
+	return true;
+}
+
+} // namespace megamorphic
+
+} // namespace benchmark
+
+} // namespace sh
+
+#endif
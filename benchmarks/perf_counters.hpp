@@ -0,0 +1,245 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__BENCHMARKS__PERF_COUNTERS_HPP
+#define INC_SH__BENCHMARKS__PERF_COUNTERS_HPP
+
+/**	@file
+ *	This file declares optional hardware performance counters for the
+ *	benchmark harness, read through Linux perf_event_open.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sh
+{
+
+namespace benchmark
+{
+
+/**	Counts hardware events of the calling thread, in user space only.
+ *	@detail Each event is opened separately, so an event the processor or
+ *	kernel does not support is skipped rather than disabling the rest, and
+ *	the kernel may multiplex events onto fewer hardware counters; counts are
+ *	scaled by the fraction of time each event was scheduled. Elsewhere than
+ *	Linux, or where perf_event_paranoid forbids access, no event is
+ *	available and every operation does nothing.
+ */
+class perf_counters final
+{
+public:
+	using size_type = std::size_t;
+	using values_type = std::array<double, 5>;
+
+	/**	The number of events.
+	 */
+	constexpr static size_type event_count = std::tuple_size<values_type>::value;
+
+	perf_counters(const perf_counters&) = delete;
+	perf_counters& operator=(const perf_counters&) = delete;
+
+	/**	Constructor. Opens and enables every supported event.
+	 */
+	perf_counters() noexcept
+	{
+#if defined(__linux__)
+		constexpr std::uint64_t cache_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		const std::array<std::pair<std::uint32_t, std::uint64_t>, event_count> events{ {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1I | cache_miss },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_miss },
+		} };
+		for (size_type i = 0; i < event_count; ++i)
+		{
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.size = sizeof(attributes);
+			attributes.type = events[i].first;
+			attributes.config = events[i].second;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			m_fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+			if (m_fds[i] < 0 && m_error.empty())
+			{
+				m_error = std::strerror(errno);
+			}
+		}
+#endif
+	}
+	/**	Destructor. Closes every event.
+	 */
+	~perf_counters()
+	{
+#if defined(__linux__)
+		for (const int fd : m_fds)
+		{
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+		}
+#endif
+	}
+
+	/**	The name of an event.
+	 *	@param event The event's index.
+	 *	@return A short name, suitable for column headings and JSON keys.
+	 */
+	static const char* name(const size_type event) noexcept
+	{
+		constexpr const char* names[event_count] = { "cycles", "instructions", "branch_misses", "l1i_misses", "l1d_misses" };
+		return names[event];
+	}
+	/**	Test if an event is counted.
+	 *	@param event The event's index.
+	 *	@return True if the event was opened.
+	 */
+	bool valid(const size_type event) const noexcept
+	{
+		return m_fds[event] >= 0;
+	}
+	/**	Test if any event is counted.
+	 *	@return True if at least one event was opened.
+	 */
+	bool available() const noexcept
+	{
+		for (size_type i = 0; i < event_count; ++i)
+		{
+			if (valid(i))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	/**	Why the first event that could not be opened failed.
+	 *	@return A description, or empty if every event was opened.
+	 */
+	const std::string& error() const noexcept
+	{
+		return m_error;
+	}
+
+	/**	Zero the totals.
+	 */
+	void reset() noexcept
+	{
+		m_totals.fill(0);
+	}
+	/**	Start counting, adding to the totals.
+	 */
+	void resume() noexcept
+	{
+		for (size_type i = 0; i < event_count; ++i)
+		{
+			m_start[i] = read(i);
+		}
+	}
+	/**	Stop counting, adding the events since resume to the totals.
+	 */
+	void pause() noexcept
+	{
+		for (size_type i = 0; i < event_count; ++i)
+		{
+			const sample end = read(i);
+			const std::uint64_t running = end.m_running - m_start[i].m_running;
+			if (running != 0)
+			{
+				const double enabled = static_cast<double>(end.m_enabled - m_start[i].m_enabled);
+				m_totals[i] += static_cast<double>(end.m_value - m_start[i].m_value) * enabled / static_cast<double>(running);
+			}
+		}
+	}
+	/**	The events counted between each resume and pause since reset.
+	 *	@return The totals, or zero for events that are not counted.
+	 */
+	const values_type& totals() const noexcept
+	{
+		return m_totals;
+	}
+
+private:
+	/**	The counter value and scheduling times of one event, as read.
+	 */
+	struct sample final
+	{
+		std::uint64_t m_value{ 0 };
+		std::uint64_t m_enabled{ 0 };
+		std::uint64_t m_running{ 0 };
+	};
+
+	/**	Read one event.
+	 *	@param event The event's index.
+	 *	@return The sample, or zeroes if the event is not counted.
+	 */
+	sample read(const size_type event) const noexcept
+	{
+		sample result;
+#if defined(__linux__)
+		if (valid(event) && ::read(m_fds[event], &result, sizeof(result)) != static_cast<ssize_t>(sizeof(result)))
+		{
+			result = sample{};
+		}
+#else
+		static_cast<void>(event);
+#endif
+		return result;
+	}
+
+	std::array<int, event_count> m_fds{ { -1, -1, -1, -1, -1 } };
+	std::array<sample, event_count> m_start{};
+	values_type m_totals{};
+	std::string m_error;
+};
+
+} // namespace benchmark
+
+} // namespace sh
+
+#endif
@@ -0,0 +1,375 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__ACTOR_MAILBOX_HPP
+#define INC_SH__ACTOR_MAILBOX_HPP
+
+/**	@file
+ *	This file declares an actor mailbox whose messages are intrusive nodes
+ *	holding their closures in-line, allocated from a per-mailbox pool.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Assumed size of a cache line, used to keep producer and consumer state apart.
+	 */
+	constexpr std::size_t actor_mailbox_cache_line_size = 64;
+
+	/**	Table of functions to operate on a closure stored in an actor_mailbox message.
+	 *	@detail Messages are never relocated, so no move is needed.
+	 */
+	struct actor_mailbox_vtable final
+	{
+		using call_type = void(*)(void* const);
+		using dtor_type = void(*)(void* const) noexcept;
+
+		/**	Calls the given storage.
+		 */
+		const call_type m_call;
+		/**	Destructs the given storage.
+		 */
+		const dtor_type m_dtor;
+	};
+
+	/**	The vtable for a closure type.
+	 *	@return A reference to the static vtable.
+	 *	@tparam Callable The closure type.
+	 */
+	template <typename Callable>
+	const actor_mailbox_vtable& actor_mailbox_vtable_for() noexcept
+	{
+		static const actor_mailbox_vtable instance{
+			[](void* const storage)
+			{
+				(*static_cast<Callable*>(storage))();
+			},
+			[](void* const storage) noexcept
+			{
+				static_cast<Callable*>(storage)->~Callable();
+			}
+		};
+		return instance;
+	}
+} // namespace detail
+
+/**	Implements an actor's mailbox of closures.
+ *	@detail Each message is one node holding the intrusive link, a vtable
+ *	pointer and the closure. Nodes come from a fixed array owned by the
+ *	mailbox, through a lock-free free list whose head carries a tag against
+ *	ABA, and only when it is exhausted from operator new. Sending is a
+ *	wait-free multi-producer push onto an intrusive queue; draining, by a
+ *	single consumer at a time, calls messages in the order they were pushed.
+ *	With post, the mailbox schedules its own draining upon an executor,
+ *	submitting a drain task only when going from idle to busy, and each
+ *	drain task calls a bounded batch before yielding the thread.
+ *	@tparam MessageCapacity The number of in-place storage bytes per message.
+ */
+template <std::size_t MessageCapacity = sizeof(void*) * 4>
+class actor_mailbox final
+{
+public:
+	using size_type = std::size_t;
+	static constexpr std::size_t capacity = MessageCapacity;
+
+	actor_mailbox(const actor_mailbox&) = delete;
+	actor_mailbox(actor_mailbox&&) = delete;
+	actor_mailbox& operator=(const actor_mailbox&) = delete;
+	actor_mailbox& operator=(actor_mailbox&&) = delete;
+
+	/**	Constructor.
+	 *	@param pool_capacity The number of messages the pool holds before falling back to operator new.
+	 *	@param batch_size The maximum number of messages each drain task scheduled by post calls.
+	 */
+	explicit actor_mailbox(const size_type pool_capacity = 64, const size_type batch_size = 64)
+		: m_pool{ std::make_unique<node[]>(pool_capacity) }
+		, m_batch_size{ batch_size > 0 ? batch_size : 1 }
+	{
+		assert(pool_capacity < npos);
+		for (std::uint32_t i = static_cast<std::uint32_t>(pool_capacity); i-- > 0; )
+		{
+			m_pool[i].m_pool_next.store(static_cast<std::uint32_t>(m_free.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+			m_free.store(i, std::memory_order_relaxed);
+		}
+	}
+	/**	Destructor.
+	 *	@detail Destroys undelivered messages without calling them. No drain may be running or scheduled.
+	 */
+	~actor_mailbox()
+	{
+		while (node* const next = pop())
+		{
+			next->m_vtable->m_dtor(&next->m_storage);
+			deallocate(next);
+		}
+	}
+
+	/**	Thread-safe. Append a message.
+	 *	@param callable An invocable to store in the message and call when drained.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_invocable_v<std::decay_t<Callable>&>>>
+	void push(Callable&& callable)
+	{
+		using callable_type = std::decay_t<Callable>;
+		static_assert(sizeof(callable_type) <= MessageCapacity, "Callable too large for MessageCapacity");
+		static_assert(alignof(callable_type) <= alignof(std::max_align_t), "Callable alignment too large for actor_mailbox");
+		node* const message = allocate();
+		try
+		{
+			new(&message->m_storage) callable_type{ std::forward<Callable>(callable) };
+		}
+		catch (...)
+		{
+			deallocate(message);
+			throw;
+		}
+		message->m_vtable = &detail::actor_mailbox_vtable_for<callable_type>();
+		message->m_next.store(nullptr, std::memory_order_relaxed);
+		// Sequentially consistent to pair with the drain task's check in run.
+		node* const previous = m_tail.exchange(message, std::memory_order_seq_cst);
+		previous->m_next.store(message, std::memory_order_release);
+	}
+	/**	Thread-safe. Append a message and ensure a drain task is scheduled.
+	 *	@param executor The executor upon which to drain. Requires submit(callable).
+	 *	@param callable An invocable to store in the message and call when drained.
+	 *	@tparam Executor The executor type, such as thread_pool.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Executor, typename Callable>
+	void post(Executor& executor, Callable&& callable)
+	{
+		push(std::forward<Callable>(callable));
+		schedule(executor);
+	}
+	/**	Consumer only. Call up to the given number of messages in order.
+	 *	@detail If a message throws, it is destroyed and the exception propagates.
+	 *	@param max_count The maximum number of messages to call.
+	 *	@return The number of messages called.
+	 */
+	size_type drain(const size_type max_count = std::numeric_limits<size_type>::max())
+	{
+		size_type count = 0;
+		while (count < max_count)
+		{
+			node* const message = pop();
+			if (message == nullptr)
+			{
+				break;
+			}
+			struct release_guard final
+			{
+				~release_guard()
+				{
+					m_message->m_vtable->m_dtor(&m_message->m_storage);
+					m_mailbox.deallocate(m_message);
+				}
+
+				actor_mailbox& m_mailbox;
+				node* const m_message;
+			} guard{ *this, message };
+			++count;
+			message->m_vtable->m_call(&message->m_storage);
+		}
+		return count;
+	}
+	/**	Consumer only. Test if every pushed message has been drained.
+	 *	@return True if empty.
+	 */
+	bool empty() const noexcept
+	{
+		return m_head == &m_stub && m_tail.load(std::memory_order_seq_cst) == &m_stub;
+	}
+
+private:
+	static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+	/**	A message: link, vtable and closure.
+	 */
+	struct node final
+	{
+		std::atomic<node*> m_next{ nullptr };
+		const detail::actor_mailbox_vtable* m_vtable{ nullptr };
+		/**	The next free pool node while this is free.
+		 */
+		std::atomic<std::uint32_t> m_pool_next{ npos };
+		/**	True if this belongs to the pool rather than operator new.
+		 */
+		bool m_pooled{ true };
+		alignas(std::max_align_t) std::byte m_storage[MessageCapacity];
+	};
+
+	node* allocate()
+	{
+		std::uint64_t head = m_free.load(std::memory_order_acquire);
+		while (static_cast<std::uint32_t>(head) != npos)
+		{
+			const std::uint32_t index = static_cast<std::uint32_t>(head);
+			const std::uint64_t next = ((head >> 32) + 1) << 32 | m_pool[index].m_pool_next.load(std::memory_order_relaxed);
+			if (m_free.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return &m_pool[index];
+			}
+		}
+		node* const allocated = new node;
+		allocated->m_pooled = false;
+		return allocated;
+	}
+	void deallocate(node* const message) noexcept
+	{
+		if (false == message->m_pooled)
+		{
+			delete message;
+			return;
+		}
+		const std::uint32_t index = static_cast<std::uint32_t>(message - m_pool.get());
+		std::uint64_t head = m_free.load(std::memory_order_relaxed);
+		do
+		{
+			message->m_pool_next.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+		} while (false == m_free.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | index, std::memory_order_release, std::memory_order_relaxed));
+	}
+	/**	Consumer only. Unlink the oldest message.
+	 *	@return The message, or null if none is fully linked.
+	 */
+	node* pop() noexcept
+	{
+		node* head = m_head;
+		node* next = head->m_next.load(std::memory_order_acquire);
+		if (head == &m_stub)
+		{
+			if (next == nullptr)
+			{
+				return nullptr;
+			}
+			m_head = next;
+			head = next;
+			next = next->m_next.load(std::memory_order_acquire);
+		}
+		if (next != nullptr)
+		{
+			m_head = next;
+			return head;
+		}
+		if (head != m_tail.load(std::memory_order_acquire))
+		{
+			// A push is between its exchange and its link.
+			return nullptr;
+		}
+		// Re-insert the stub so the last message can be unlinked.
+		m_stub.m_next.store(nullptr, std::memory_order_relaxed);
+		node* const previous = m_tail.exchange(&m_stub, std::memory_order_acq_rel);
+		previous->m_next.store(&m_stub, std::memory_order_release);
+		next = head->m_next.load(std::memory_order_acquire);
+		if (next != nullptr)
+		{
+			m_head = next;
+			return head;
+		}
+		return nullptr;
+	}
+	/**	Submit a drain task unless one is already scheduled.
+	 */
+	template <typename Executor>
+	void schedule(Executor& executor)
+	{
+		if (false == m_scheduled.exchange(true, std::memory_order_seq_cst))
+		{
+			executor.submit([this, &executor]()
+			{
+				run(executor);
+			});
+		}
+	}
+	/**	The body of a drain task.
+	 */
+	template <typename Executor>
+	void run(Executor& executor)
+	{
+		struct reschedule_guard final
+		{
+			~reschedule_guard()
+			{
+				// Read while this is still the consumer: once m_scheduled is
+				// cleared, another drain may start and move m_head.
+				const bool drained = m_mailbox.m_head == &m_mailbox.m_stub;
+				m_mailbox.m_scheduled.store(false, std::memory_order_seq_cst);
+				// Pairs with the exchange in schedule, so a push that saw a drain
+				// already scheduled is either drained above or seen here.
+				if (false == drained || m_mailbox.m_tail.load(std::memory_order_seq_cst) != &m_mailbox.m_stub)
+				{
+					m_mailbox.schedule(m_executor);
+				}
+			}
+
+			actor_mailbox& m_mailbox;
+			Executor& m_executor;
+		} guard{ *this, executor };
+		drain(m_batch_size);
+	}
+
+	/**	The pool's nodes.
+	 */
+	const std::unique_ptr<node[]> m_pool;
+	const size_type m_batch_size;
+	/**	The free list's head index in the low half, and a tag incremented on each change in the high half.
+	 */
+	alignas(detail::actor_mailbox_cache_line_size) std::atomic<std::uint64_t> m_free{ npos };
+	/**	The most recently pushed node.
+	 */
+	alignas(detail::actor_mailbox_cache_line_size) std::atomic<node*> m_tail{ &m_stub };
+	/**	True while a drain task is scheduled or running.
+	 */
+	std::atomic<bool> m_scheduled{ false };
+	/**	Consumer only. The oldest node, possibly the stub.
+	 */
+	alignas(detail::actor_mailbox_cache_line_size) node* m_head{ &m_stub };
+	/**	Stands in for a message so the queue is never empty of nodes.
+	 */
+	node m_stub;
+};
+
+} // namespace sh
+
+#endif
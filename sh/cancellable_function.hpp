@@ -0,0 +1,345 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__CANCELLABLE_FUNCTION_HPP
+#define INC_SH__CANCELLABLE_FUNCTION_HPP
+
+/**	@file
+ *	This file declares cancellation sources and tokens addressed by index
+ *	into a shared slab, and a function wrapper that skips its call once its
+ *	token is cancelled.
+ */
+
+#include "move_only_function.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	The process-wide slab of cancellation epochs, one per live cancel_source.
+	 *	@detail Entries live in chunks that are never freed or moved, so a
+	 *	token keeps a pointer to its entry and its check is a single load.
+	 *	Only creating and destroying sources takes the mutex.
+	 */
+	class cancel_slab final
+	{
+	public:
+		static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+
+		cancel_slab(const cancel_slab&) = delete;
+		cancel_slab& operator=(const cancel_slab&) = delete;
+
+		/**	The process-wide slab.
+		 *	@return A reference to a static slab.
+		 */
+		static cancel_slab& instance() noexcept
+		{
+			static cancel_slab instance;
+			return instance;
+		}
+
+		/**	The epoch of an entry.
+		 *	@param index The entry's index.
+		 *	@return A reference to the entry's epoch.
+		 */
+		std::atomic<std::uint32_t>& epoch(const std::uint32_t index) noexcept
+		{
+			return m_chunks[index >> chunk_bits].load(std::memory_order_acquire)[index & (chunk_size - 1)];
+		}
+		/**	Claim an entry.
+		 *	@return The entry's index.
+		 */
+		std::uint32_t acquire()
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			if (false == m_free.empty())
+			{
+				const std::uint32_t index = m_free.back();
+				m_free.pop_back();
+				return index;
+			}
+			const std::uint32_t index = m_size;
+			if ((index & (chunk_size - 1)) == 0)
+			{
+				if ((index >> chunk_bits) >= chunk_count)
+				{
+					throw std::bad_alloc{};
+				}
+				m_chunks[index >> chunk_bits].store(new std::atomic<std::uint32_t>[chunk_size]{}, std::memory_order_release);
+			}
+			m_free.reserve(index + 1);
+			++m_size;
+			return index;
+		}
+		/**	Return an entry, which the caller has already cancelled, for reuse.
+		 *	@param index The entry's index.
+		 */
+		void release(const std::uint32_t index) noexcept
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			// Reserved by acquire, so cannot throw.
+			m_free.push_back(index);
+		}
+
+	private:
+		static constexpr unsigned chunk_bits = 10;
+		static constexpr std::size_t chunk_size = std::size_t{ 1 } << chunk_bits;
+		static constexpr std::size_t chunk_count = 4096;
+
+		cancel_slab() = default;
+		/**	Destructor.
+		 *	@detail Chunks are deliberately leaked, as tokens may be checked during static destruction.
+		 */
+		~cancel_slab() = default;
+
+		std::mutex m_mutex;
+		std::array<std::atomic<std::atomic<std::uint32_t>*>, chunk_count> m_chunks{};
+		std::vector<std::uint32_t> m_free;
+		std::uint32_t m_size{ 0 };
+	};
+} // namespace detail
+
+/**	A handle observing whether a cancel_source has been cancelled since the handle was taken.
+ *	@detail Holds a pointer to the source's slab entry and its epoch at the
+ *	time. The token is cancelled once the entry's epoch moves on, which
+ *	happens when the source is cancelled or destroyed. A default token is
+ *	never cancelled.
+ */
+class cancel_token final
+{
+public:
+	/**	Default constructor, for a token that is never cancelled.
+	 */
+	constexpr cancel_token() noexcept = default;
+
+	/**	Test if cancelled.
+	 *	@detail One acquire load of the slab entry.
+	 *	@return True if the source was cancelled or destroyed after this was taken.
+	 */
+	bool cancelled() const noexcept
+	{
+		return m_entry != nullptr && m_entry->load(std::memory_order_acquire) != m_epoch;
+	}
+	/**	Test if this may ever be cancelled.
+	 *	@return True if taken from a cancel_source.
+	 */
+	constexpr bool cancellable() const noexcept
+	{
+		return m_entry != nullptr;
+	}
+
+private:
+	friend class cancel_source;
+
+	cancel_token(const std::atomic<std::uint32_t>& entry, const std::uint32_t epoch) noexcept
+		: m_entry{ &entry }
+		, m_epoch{ epoch }
+	{ }
+
+	/**	The source's slab entry, which is never freed, or null if never cancelled.
+	 */
+	const std::atomic<std::uint32_t>* m_entry{ nullptr };
+	std::uint32_t m_epoch{ 0 };
+};
+
+/**	Cancels a group of tokens at once.
+ *	@detail Cancelling increments the source's epoch in the slab, which
+ *	cancels every token taken so far in O(1). Tokens taken afterwards
+ *	belong to a new group. Destroying the source cancels its tokens too.
+ */
+class cancel_source final
+{
+public:
+	cancel_source(const cancel_source&) = delete;
+	cancel_source& operator=(const cancel_source&) = delete;
+
+	/**	Constructor, claiming a slab entry.
+	 */
+	cancel_source()
+		: m_index{ detail::cancel_slab::instance().acquire() }
+	{ }
+	/**	Move constructor.
+	 *	@param other The source to move into this. Afterwards, other has no entry.
+	 */
+	cancel_source(cancel_source&& other) noexcept
+		: m_index{ std::exchange(other.m_index, detail::cancel_slab::npos) }
+	{ }
+	/**	Destructor, cancelling all tokens.
+	 */
+	~cancel_source()
+	{
+		reset();
+	}
+	/**	Move assignment, cancelling this source's tokens.
+	 *	@param other The source to move into this.
+	 *	@return A reference to this.
+	 */
+	cancel_source& operator=(cancel_source&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_index = std::exchange(other.m_index, detail::cancel_slab::npos);
+		}
+		return *this;
+	}
+
+	/**	Take a token, cancelled by the next call to cancel.
+	 *	@return The token.
+	 */
+	cancel_token token() const noexcept
+	{
+		assert(m_index != detail::cancel_slab::npos);
+		const std::atomic<std::uint32_t>& entry = detail::cancel_slab::instance().epoch(m_index);
+		return cancel_token{ entry, entry.load(std::memory_order_relaxed) };
+	}
+	/**	Cancel every token taken so far.
+	 */
+	void cancel() noexcept
+	{
+		assert(m_index != detail::cancel_slab::npos);
+		detail::cancel_slab::instance().epoch(m_index).fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	void reset() noexcept
+	{
+		if (m_index != detail::cancel_slab::npos)
+		{
+			cancel();
+			detail::cancel_slab::instance().release(std::exchange(m_index, detail::cancel_slab::npos));
+		}
+	}
+
+	std::uint32_t m_index;
+};
+
+/**	Implements a function wrapper that is only called while its token is not cancelled.
+ *	@detail A cancellable_function of a void signature keeps that signature,
+ *	so may itself be stored in a move_only_function<void()>, task queue and
+ *	the like. Otherwise, calling returns an empty optional if cancelled.
+ *	@tparam Signature The function signature.
+ *	@tparam Function The wrapper holding the target, such as move_only_function or inplace_move_only_function.
+ */
+template <typename Signature, typename Function = sh::move_only_function<Signature>>
+class cancellable_function;
+
+template <typename ResultType, typename... Args, typename Function>
+class cancellable_function<ResultType(Args...), Function> final
+{
+public:
+	using function_type = Function;
+	using result_type = std::conditional_t<std::is_void_v<ResultType>, void, std::optional<ResultType>>;
+
+	cancellable_function() noexcept = default;
+	cancellable_function(cancellable_function&&) noexcept = default;
+	cancellable_function& operator=(cancellable_function&&) noexcept = default;
+
+	/**	Constructor.
+	 *	@param token The token whose cancellation prevents calls.
+	 *	@param callable An invocable to wrap.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable>
+	cancellable_function(const cancel_token token, Callable&& callable)
+		: m_function{ std::forward<Callable>(callable) }
+		, m_token{ token }
+	{ }
+
+	/**	Call the target unless cancelled.
+	 *	@param args The arguments to pass to the target.
+	 *	@return Nothing if the target returns void, otherwise its result or an empty optional if cancelled.
+	 *	@tparam OperatorArgs The arguments to forward to the target.
+	 */
+	template <typename... OperatorArgs>
+	result_type operator()(OperatorArgs&&... args)
+	{
+		if constexpr (std::is_void_v<ResultType>)
+		{
+			if (false == m_token.cancelled())
+			{
+				m_function(std::forward<OperatorArgs>(args)...);
+			}
+		}
+		else
+		{
+			if (m_token.cancelled())
+			{
+				return result_type{};
+			}
+			return result_type{ m_function(std::forward<OperatorArgs>(args)...) };
+		}
+	}
+	/**	Test if the token is cancelled.
+	 *	@return True if calls are skipped.
+	 */
+	bool cancelled() const noexcept
+	{
+		return m_token.cancelled();
+	}
+	/**	The token.
+	 *	@return The token given on construction.
+	 */
+	cancel_token token() const noexcept
+	{
+		return m_token;
+	}
+	/**	Test if this holds a target.
+	 *	@return True if non-null.
+	 */
+	explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(m_function);
+	}
+
+private:
+	Function m_function;
+	cancel_token m_token;
+};
+
+} // namespace sh
+
+#endif
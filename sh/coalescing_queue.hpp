@@ -0,0 +1,424 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__COALESCING_QUEUE_HPP
+#define INC_SH__COALESCING_QUEUE_HPP
+
+/**	@file
+ *	This file declares a queue of deferred calls that runs each distinct
+ *	target at most once per flush.
+ */
+
+#include "function_ptr.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+/**	Implements a queue of deferred calls, coalescing repeated posts of the same target.
+ *	@tparam Signature The function signature of the callbacks.
+ */
+template <typename Signature>
+class coalescing_queue;
+
+/**	Implements a queue of deferred calls, coalescing repeated posts of the same target.
+ *	@detail Each pending call is identified by a key, by default the address
+ *	of the callback's target, and posting a key that is already pending
+ *	either keeps the pending arguments or replaces them. Pending calls are
+ *	kept in posting order alongside an open-addressing table of their
+ *	indices; the table is emptied in O(1) per flush by stamping slots with a
+ *	flush counter. Storage grows to the largest number of distinct calls
+ *	pending at once and is retained, so the steady state does not allocate.
+ *	Not thread-safe.
+ *	@tparam Args The arguments with which callbacks are called, stored decayed.
+ */
+template <typename... Args>
+class coalescing_queue<void(Args...)> final
+{
+public:
+	using callback_type = sh::function_ptr<void(Args...)>;
+	using key_type = const void*;
+	using size_type = std::size_t;
+
+	coalescing_queue(const coalescing_queue&) = delete;
+	coalescing_queue& operator=(const coalescing_queue&) = delete;
+
+	/**	Constructor.
+	 *	@param capacity The number of distinct pending calls for which to reserve space.
+	 */
+	explicit coalescing_queue(const size_type capacity = 0)
+	{
+		reserve(capacity);
+	}
+
+	/**	Reserve space for distinct pending calls.
+	 *	@param capacity The number of distinct pending calls for which to reserve space.
+	 */
+	void reserve(const size_type capacity)
+	{
+		m_entries.reserve(capacity);
+		m_flushing.reserve(capacity);
+		if (capacity * 2 > m_slots.size())
+		{
+			rehash(capacity * 2);
+		}
+	}
+	/**	The number of distinct pending calls.
+	 *	@return The pending call count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_entries.size();
+	}
+	/**	Test if there are no pending calls.
+	 *	@return True if nothing is pending.
+	 */
+	bool empty() const noexcept
+	{
+		return m_entries.empty();
+	}
+	/**	Test if a call with a given key is pending.
+	 *	@param key The key.
+	 *	@return True if pending.
+	 */
+	bool pending(const key_type key) const noexcept
+	{
+		return find(key) != npos;
+	}
+	/**	Test if a call of a given callback's target is pending.
+	 *	@param callback The callback.
+	 *	@return True if pending.
+	 */
+	bool pending(const callback_type& callback) const noexcept
+	{
+		return pending(callback.target_address());
+	}
+
+	/**	Post a call of a callback, unless its target is already pending.
+	 *	@param callback A non-null callback, whose target must outlive the call.
+	 *	@param args The arguments with which to call it.
+	 *	@return True if newly pending, or false if the pending call's arguments were kept.
+	 *	@tparam PostArgs The types of the given arguments.
+	 */
+	template <typename... PostArgs>
+	bool post(const callback_type callback, PostArgs&&... args)
+	{
+		return insert<false>(callback.target_address(), callback, std::forward<PostArgs>(args)...);
+	}
+	/**	Post a call of a callback, replacing the arguments of any pending call of its target.
+	 *	@param callback A non-null callback, whose target must outlive the call.
+	 *	@param args The arguments with which to call it.
+	 *	@return True if newly pending, or false if the pending call's arguments were replaced.
+	 *	@tparam PostArgs The types of the given arguments.
+	 */
+	template <typename... PostArgs>
+	bool post_latest(const callback_type callback, PostArgs&&... args)
+	{
+		return insert<true>(callback.target_address(), callback, std::forward<PostArgs>(args)...);
+	}
+	/**	Post a call of a callback under a given key, unless that key is already pending.
+	 *	@param key The key, such as the address of the object that the call concerns.
+	 *	@param callback A non-null callback, whose target must outlive the call.
+	 *	@param args The arguments with which to call it.
+	 *	@return True if newly pending, or false if the pending call was kept.
+	 *	@tparam PostArgs The types of the given arguments.
+	 */
+	template <typename... PostArgs>
+	bool post_for(const key_type key, const callback_type callback, PostArgs&&... args)
+	{
+		return insert<false>(key, callback, std::forward<PostArgs>(args)...);
+	}
+	/**	Post a call of a callback under a given key, replacing any pending call of that key.
+	 *	@param key The key, such as the address of the object that the call concerns.
+	 *	@param callback A non-null callback, whose target must outlive the call.
+	 *	@param args The arguments with which to call it.
+	 *	@return True if newly pending, or false if the pending call was replaced.
+	 *	@tparam PostArgs The types of the given arguments.
+	 */
+	template <typename... PostArgs>
+	bool post_latest_for(const key_type key, const callback_type callback, PostArgs&&... args)
+	{
+		return insert<true>(key, callback, std::forward<PostArgs>(args)...);
+	}
+
+	/**	Call each pending call once, in the order first posted.
+	 *	@detail Calls posted by the callbacks are pending for the next flush.
+	 *	If a callback throws, the calls after it remain pending ahead of any
+	 *	posted since, merged with them by key as if posted first, and the
+	 *	exception propagates.
+	 *	Must not be called from a callback.
+	 *	@return The number of calls made.
+	 */
+	size_type flush()
+	{
+		assert(false == m_flushing_now);
+		if (m_entries.empty())
+		{
+			return 0;
+		}
+		m_entries.swap(m_flushing);
+		clear_slots();
+		m_flushing_now = true;
+		size_type i = 0;
+		try
+		{
+			for (; i < m_flushing.size(); ++i)
+			{
+				entry& current = m_flushing[i];
+				std::apply(current.m_callback, std::move(current.m_args));
+			}
+		}
+		catch (...)
+		{
+			restore(i + 1);
+			throw;
+		}
+		m_flushing.clear();
+		m_flushing_now = false;
+		return i;
+	}
+	/**	Discard all pending calls.
+	 */
+	void clear() noexcept
+	{
+		m_entries.clear();
+		clear_slots();
+	}
+
+private:
+	static constexpr std::uint32_t npos = ~std::uint32_t{ 0 };
+
+	/**	A pending call.
+	 */
+	struct entry final
+	{
+		template <typename... PostArgs>
+		entry(const key_type key, const callback_type callback, const bool latest, PostArgs&&... args)
+			: m_key{ key }
+			, m_callback{ callback }
+			, m_args{ std::forward<PostArgs>(args)... }
+			, m_latest{ latest }
+		{ }
+
+		key_type m_key;
+		callback_type m_callback;
+		std::tuple<std::decay_t<Args>...> m_args;
+		/**	True if posted or last replaced by a post that replaces pending calls.
+		 */
+		bool m_latest;
+	};
+	/**	An open-addressing table slot, occupied only if stamped with the current m_stamp.
+	 */
+	struct slot final
+	{
+		std::uint32_t m_index{ 0 };
+		std::uint32_t m_stamp{ 0 };
+	};
+
+	/**	The first slot to probe for a key.
+	 *	@param key The key.
+	 *	@return The slot's index.
+	 */
+	size_type home(const key_type key) const noexcept
+	{
+		// Fibonacci hashing of the address, keeping the well-mixed upper bits.
+		const std::uint64_t hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key)) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_type>(hash >> 32) & (m_slots.size() - 1);
+	}
+	/**	Find the pending call of a key.
+	 *	@param key The key.
+	 *	@return Its index within m_entries, or npos.
+	 */
+	std::uint32_t find(const key_type key) const noexcept
+	{
+		if (m_slots.empty())
+		{
+			return npos;
+		}
+		for (size_type i = home(key);; i = (i + 1) & (m_slots.size() - 1))
+		{
+			const slot& current = m_slots[i];
+			if (current.m_stamp != m_stamp)
+			{
+				return npos;
+			}
+			if (m_entries[current.m_index].m_key == key)
+			{
+				return current.m_index;
+			}
+		}
+	}
+	/**	Occupy a free slot with the index of an entry whose key is not present.
+	 *	@param key The entry's key.
+	 *	@param index The entry's index within m_entries.
+	 */
+	void place(const key_type key, const std::uint32_t index) noexcept
+	{
+		size_type i = home(key);
+		while (m_slots[i].m_stamp == m_stamp)
+		{
+			i = (i + 1) & (m_slots.size() - 1);
+		}
+		m_slots[i].m_index = index;
+		m_slots[i].m_stamp = m_stamp;
+	}
+	/**	Add or update a pending call.
+	 *	@param key The key.
+	 *	@param callback The callback.
+	 *	@param args The arguments.
+	 *	@return True if newly pending.
+	 *	@tparam Replace True to replace the callback and arguments of a pending call of key.
+	 *	@tparam PostArgs The types of the given arguments.
+	 */
+	template <bool Replace, typename... PostArgs>
+	bool insert(const key_type key, const callback_type callback, PostArgs&&... args)
+	{
+		assert(callback != nullptr);
+		const std::uint32_t index = find(key);
+		if (index != npos)
+		{
+			if constexpr (Replace)
+			{
+				entry& current = m_entries[index];
+				current.m_callback = callback;
+				current.m_args = std::tuple<std::decay_t<Args>...>{ std::forward<PostArgs>(args)... };
+				current.m_latest = true;
+			}
+			return false;
+		}
+		if ((m_entries.size() + 1) * 2 > m_slots.size())
+		{
+			rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+		}
+		m_entries.emplace_back(key, callback, Replace, std::forward<PostArgs>(args)...);
+		place(key, static_cast<std::uint32_t>(m_entries.size() - 1));
+		return true;
+	}
+	/**	Empty the table in O(1) by advancing the stamp.
+	 */
+	void clear_slots() noexcept
+	{
+		if (++m_stamp == 0)
+		{
+			for (slot& each : m_slots)
+			{
+				each.m_stamp = 0;
+			}
+			m_stamp = 1;
+		}
+	}
+	/**	Grow the table and re-insert the pending calls.
+	 *	@param minimum The minimum number of slots.
+	 */
+	void rehash(const size_type minimum)
+	{
+		size_type count = 16;
+		while (count < minimum)
+		{
+			count *= 2;
+		}
+		m_slots.assign(count, slot{});
+		m_stamp = 1;
+		for (size_type i = 0; i < m_entries.size(); ++i)
+		{
+			place(m_entries[i].m_key, static_cast<std::uint32_t>(i));
+		}
+	}
+	/**	Make the uncalled part of an interrupted flush pending again.
+	 *	@param first The index within m_flushing of the first uncalled entry.
+	 */
+	void restore(const size_type first)
+	{
+		m_flushing_now = false;
+		m_flushing.erase(m_flushing.begin(), m_flushing.begin() + static_cast<std::ptrdiff_t>(first));
+		for (entry& each : m_entries)
+		{
+			m_flushing.push_back(std::move(each));
+		}
+		m_entries.clear();
+		m_entries.swap(m_flushing);
+		// Keep the place of any key posted both before and during the flush,
+		// with the later call if that replaced pending calls, else the earlier.
+		clear_slots();
+		size_type kept = 0;
+		for (size_type i = 0; i < m_entries.size(); ++i)
+		{
+			const std::uint32_t earlier = find(m_entries[i].m_key);
+			if (earlier != npos)
+			{
+				if (m_entries[i].m_latest)
+				{
+					entry& merged = m_entries[earlier];
+					merged.m_callback = m_entries[i].m_callback;
+					merged.m_args = std::move(m_entries[i].m_args);
+					merged.m_latest = true;
+				}
+			}
+			else
+			{
+				if (kept != i)
+				{
+					m_entries[kept] = std::move(m_entries[i]);
+				}
+				place(m_entries[kept].m_key, static_cast<std::uint32_t>(kept));
+				++kept;
+			}
+		}
+		m_entries.erase(m_entries.begin() + static_cast<std::ptrdiff_t>(kept), m_entries.end());
+	}
+
+	/**	Pending calls, in the order first posted.
+	 */
+	std::vector<entry> m_entries;
+	/**	The calls being flushed, swapped with m_entries to retain both capacities.
+	 */
+	std::vector<entry> m_flushing;
+	/**	The open-addressing table of indices into m_entries, a power of two at most half full.
+	 */
+	std::vector<slot> m_slots;
+	/**	The stamp of occupied slots.
+	 */
+	std::uint32_t m_stamp{ 1 };
+	/**	True while flush is calling callbacks.
+	 */
+	bool m_flushing_now{ false };
+};
+
+} // namespace sh
+
+#endif
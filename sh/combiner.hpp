@@ -0,0 +1,300 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__COMBINER_HPP
+#define INC_SH__COMBINER_HPP
+
+/**	@file
+ *	This file declares a flat-combining wrapper that applies operations,
+ *	passed as function_ref, to a shared state in batches.
+ */
+
+#include "function_ref.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Assumed size of a cache line, used to keep publication slots apart.
+	 */
+	constexpr std::size_t combiner_cache_line_size = 64;
+
+	/**	A small number identifying the calling thread, assigned on first use.
+	 *	@return The calling thread's index.
+	 */
+	inline std::size_t combiner_thread_index() noexcept
+	{
+		static std::atomic<std::size_t> next{ 0 };
+		thread_local const std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
+
+	/**	Hint to the processor that the caller is spinning.
+	 */
+	inline void combiner_pause() noexcept
+	{
+#if defined(_MSC_VER)
+		_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+} // namespace detail
+
+/**	Implements flat combining over a shared state.
+ *	@detail Each caller publishes its operation in a publication slot, chosen
+ *	by its thread, and then either takes the combiner lock or waits. The lock
+ *	holder applies every published operation in one pass over the slots,
+ *	keeping the state hot in its cache, while the other callers spin on
+ *	their own slots until their operations are done. Nothing is allocated
+ *	per operation; a thread finding its slots taken by other threads applies
+ *	its operation under the lock directly.
+ *	@tparam State The shared state type.
+ */
+template <typename State>
+class combiner final
+{
+public:
+	using state_type = State;
+	using size_type = std::size_t;
+	using operation_type = sh::function_ref<void(State&)>;
+
+	combiner(const combiner&) = delete;
+	combiner(combiner&&) = delete;
+	combiner& operator=(const combiner&) = delete;
+	combiner& operator=(combiner&&) = delete;
+
+	/**	Constructor.
+	 *	@param state The initial state.
+	 *	@param slot_count The number of publication slots, or zero for twice the hardware thread count.
+	 */
+	explicit combiner(State state = State{}, const size_type slot_count = 0)
+		: m_slot_count{ slot_count > 0 ? slot_count : std::max<size_type>(8, std::thread::hardware_concurrency() * 2) }
+		, m_slots{ std::make_unique<slot[]>(m_slot_count) }
+		, m_state{ std::move(state) }
+	{ }
+
+	/**	Apply an operation to the state, exclusively of all other operations.
+	 *	@detail Returns once the operation has been applied, by this thread
+	 *	or by another. Exceptions thrown by the operation are rethrown here.
+	 *	@param operation The operation, which must not call into this combiner.
+	 */
+	void apply(const operation_type operation)
+	{
+		slot* const published = publish(operation);
+		if (published == nullptr)
+		{
+			lock();
+			const unlock_guard guard{ *this };
+			operation(m_state);
+			return;
+		}
+		for (unsigned spins = 0; published->m_status.load(std::memory_order_acquire) != slot_done; ++spins)
+		{
+			if (try_lock())
+			{
+				const unlock_guard guard{ *this };
+				combine();
+			}
+			else if (spins < spin_limit)
+			{
+				detail::combiner_pause();
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		const std::exception_ptr exception = std::exchange(published->m_exception, nullptr);
+		published->m_status.store(slot_free, std::memory_order_release);
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+	/**	Apply a callable to the state and return its result.
+	 *	@param callable Invoked with State&.
+	 *	@return The result of callable.
+	 *	@tparam Callable The callable type.
+	 */
+	template <typename Callable>
+	std::invoke_result_t<Callable&, State&> execute(Callable&& callable)
+	{
+		using result_type = std::invoke_result_t<Callable&, State&>;
+		if constexpr (std::is_void_v<result_type>)
+		{
+			apply(callable);
+		}
+		else if constexpr (std::is_reference_v<result_type>)
+		{
+			std::remove_reference_t<result_type>* result = nullptr;
+			apply([&callable, &result](State& state)
+			{
+				result_type reference = std::invoke(callable, state);
+				result = std::addressof(reference);
+			});
+			return static_cast<result_type>(*result);
+		}
+		else
+		{
+			std::optional<result_type> result;
+			apply([&callable, &result](State& state) { result.emplace(std::invoke(callable, state)); });
+			return std::move(*result);
+		}
+	}
+	/**	Access the state without synchronization, such as once no other thread can apply operations.
+	 *	@return A reference to the state.
+	 */
+	State& unsafe_state() noexcept
+	{
+		return m_state;
+	}
+
+private:
+	static constexpr std::uint32_t slot_free = 0;
+	static constexpr std::uint32_t slot_claimed = 1;
+	static constexpr std::uint32_t slot_pending = 2;
+	static constexpr std::uint32_t slot_done = 3;
+	/**	The number of slots probed from the thread's own before applying directly.
+	 */
+	static constexpr size_type probe_limit = 4;
+	/**	The number of pauses before waiting callers start yielding.
+	 */
+	static constexpr unsigned spin_limit = 256;
+
+	/**	A publication slot.
+	 */
+	struct alignas(detail::combiner_cache_line_size) slot final
+	{
+		std::atomic<std::uint32_t> m_status{ slot_free };
+		const operation_type* m_operation{ nullptr };
+		std::exception_ptr m_exception;
+	};
+	struct unlock_guard final
+	{
+		~unlock_guard()
+		{
+			m_combiner.m_locked.store(false, std::memory_order_release);
+		}
+
+		combiner& m_combiner;
+	};
+
+	/**	Claim a slot near the calling thread's own and publish an operation in it.
+	 *	@param operation The operation, which outlives the slot's use.
+	 *	@return The slot, or null if all probed slots are taken.
+	 */
+	slot* publish(const operation_type& operation) noexcept
+	{
+		const size_type first = detail::combiner_thread_index();
+		for (size_type i = 0; i < probe_limit; ++i)
+		{
+			slot& candidate = m_slots[(first + i) % m_slot_count];
+			std::uint32_t expected = slot_free;
+			if (candidate.m_status.compare_exchange_strong(expected, slot_claimed, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				candidate.m_operation = &operation;
+				candidate.m_status.store(slot_pending, std::memory_order_release);
+				return &candidate;
+			}
+		}
+		return nullptr;
+	}
+	bool try_lock() noexcept
+	{
+		return false == m_locked.load(std::memory_order_relaxed)
+			&& false == m_locked.exchange(true, std::memory_order_acquire);
+	}
+	void lock() noexcept
+	{
+		for (unsigned spins = 0; false == try_lock(); ++spins)
+		{
+			if (spins < spin_limit)
+			{
+				detail::combiner_pause();
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+	/**	Lock holder only. Apply every pending operation.
+	 */
+	void combine() noexcept
+	{
+		for (size_type i = 0; i < m_slot_count; ++i)
+		{
+			slot& candidate = m_slots[i];
+			if (candidate.m_status.load(std::memory_order_acquire) != slot_pending)
+			{
+				continue;
+			}
+			try
+			{
+				(*candidate.m_operation)(m_state);
+			}
+			catch (...)
+			{
+				candidate.m_exception = std::current_exception();
+			}
+			candidate.m_status.store(slot_done, std::memory_order_release);
+		}
+	}
+
+	const size_type m_slot_count;
+	const std::unique_ptr<slot[]> m_slots;
+	alignas(detail::combiner_cache_line_size) std::atomic<bool> m_locked{ false };
+	alignas(detail::combiner_cache_line_size) State m_state;
+};
+
+} // namespace sh
+
+#endif
@@ -68,7 +68,7 @@ namespace detail
 		constexpr static std::size_t alignment = alignof(void*);
 
 		/**	Return true if the provided type can be stored in-place.
-		 *	@detail If the type is too large, it must be stored in externally
+		 *	@detail If the type is too large or over-aligned, it must be stored in externally
 		 *	allocated memory. If the type is not nothrow move constructible,
 		 *	copyable_function cannot assume that it's safe to move and remain
 		 *	itself nothrow movable, hence it will likewise require storaging in
@@ -77,7 +77,7 @@ namespace detail
 		template <typename Callable>
 		constexpr static bool store_inplace() noexcept
 		{
-			return sizeof(Callable) <= capacity && std::is_nothrow_move_constructible_v<Callable>;
+			return sizeof(Callable) <= capacity && alignof(Callable) <= alignment && std::is_nothrow_move_constructible_v<Callable>;
 		}
 
 		alignas(alignment) std::byte m_inplace[capacity];
@@ -168,7 +168,7 @@ namespace detail
 				}
 				else
 				{
-					dst_storage.m_allocated = new Callable{ reinterpret_cast<const Callable&>(src_storage.m_inplace) };
+					dst_storage.m_allocated = new Callable{ *static_cast<const Callable*>(src_storage.m_allocated) };
 				}
 			} }
 			, m_move{ [](copyable_function_storage& dst_storage, copyable_function_storage& src_storage) noexcept -> void
@@ -264,8 +264,14 @@ namespace detail
 		 */
 		copyable_function& operator=(const copyable_function& other)
 		{
-			m_vtable->m_dtor(m_storage);
-			m_vtable->m_copy(m_storage, other.m_storage);
+			if (this != &other)
+			{
+				m_vtable->m_dtor(m_storage);
+				// Null until the copy succeeds, as it may throw.
+				m_vtable = &null_vtable();
+				other.m_vtable->m_copy(m_storage, other.m_storage);
+				m_vtable = other.m_vtable;
+			}
 			return *this;
 		}
 		/**	Move assigment.
@@ -0,0 +1,654 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__CORO_HPP
+#define INC_SH__CORO_HPP
+
+/**	@file
+ *	This file declares a lazy coroutine task type, awaitables that resume
+ *	coroutines upon executors without allocating, and a recycling pool for
+ *	coroutine frames. Requires C++20 coroutine support and is otherwise empty.
+ */
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "move_only_function.hpp"
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace sh
+{
+
+/**	Recycles coroutine frames through per-thread free lists.
+ *	@detail Frame sizes are rounded up to a multiple of the granularity and
+ *	each size class keeps a bounded list of freed frames for the thread that
+ *	freed them. Frames larger than the largest class come from operator new.
+ */
+class coroutine_frame_pool final
+{
+public:
+	static constexpr std::size_t granularity = 64;
+	static constexpr std::size_t class_count = 16;
+	static constexpr std::size_t max_cached = 64;
+
+	coroutine_frame_pool() = delete;
+
+	/**	Allocate a frame.
+	 *	@param size The frame size in bytes.
+	 *	@return The frame's storage.
+	 */
+	static void* allocate(const std::size_t size)
+	{
+		const std::size_t index = size_class(size);
+		if (index < class_count)
+		{
+			cache& local = local_cache();
+			if (free_block* const block = local.m_heads[index])
+			{
+				local.m_heads[index] = block->m_next;
+				--local.m_counts[index];
+				return block;
+			}
+			return ::operator new((index + 1) * granularity);
+		}
+		return ::operator new(size);
+	}
+	/**	Free a frame, caching it for reuse by the calling thread.
+	 *	@param frame The frame's storage.
+	 *	@param size The size given to allocate.
+	 */
+	static void deallocate(void* const frame, const std::size_t size) noexcept
+	{
+		const std::size_t index = size_class(size);
+		if (index < class_count)
+		{
+			cache& local = local_cache();
+			if (local.m_counts[index] < max_cached)
+			{
+				local.m_heads[index] = new(frame) free_block{ local.m_heads[index] };
+				++local.m_counts[index];
+				return;
+			}
+		}
+		::operator delete(frame);
+	}
+	/**	Release the calling thread's cached frames.
+	 */
+	static void trim() noexcept
+	{
+		local_cache().release();
+	}
+
+private:
+	struct free_block final
+	{
+		free_block* m_next;
+	};
+	/**	One thread's free lists.
+	 */
+	struct cache final
+	{
+		~cache()
+		{
+			release();
+		}
+		void release() noexcept
+		{
+			for (std::size_t i = 0; i < class_count; ++i)
+			{
+				while (free_block* const block = m_heads[i])
+				{
+					m_heads[i] = block->m_next;
+					::operator delete(block);
+				}
+				m_counts[i] = 0;
+			}
+		}
+
+		free_block* m_heads[class_count]{};
+		std::size_t m_counts[class_count]{};
+	};
+
+	static constexpr std::size_t size_class(const std::size_t size) noexcept
+	{
+		return size == 0 ? 0 : (size - 1) / granularity;
+	}
+	static cache& local_cache() noexcept
+	{
+		thread_local cache instance;
+		return instance;
+	}
+};
+
+template <typename T = void>
+class task;
+
+namespace detail
+{
+	/**	A callable resuming a coroutine, small enough for the in-place storage of every sh wrapper.
+	 */
+	struct coroutine_resumer final
+	{
+		void operator()() const
+		{
+			m_handle.resume();
+		}
+
+		std::coroutine_handle<> m_handle;
+	};
+	static_assert(move_only_function_storage::store_inplace<coroutine_resumer>(), "Resuming a coroutine through move_only_function must not allocate.");
+
+	/**	Submit a callable to an executor through submit or, failing that, post.
+	 *	@param executor The executor.
+	 *	@param callable The callable.
+	 *	@tparam Executor The executor type.
+	 *	@tparam Callable The callable type.
+	 */
+	template <typename Executor, typename Callable>
+	void coroutine_submit(Executor& executor, Callable&& callable)
+	{
+		if constexpr (requires { executor.submit(std::forward<Callable>(callable)); })
+		{
+			executor.submit(std::forward<Callable>(callable));
+		}
+		else
+		{
+			executor.post(std::forward<Callable>(callable));
+		}
+	}
+
+	/**	The parts of a task's promise that do not depend on its result type.
+	 */
+	class task_promise_base
+	{
+	public:
+		/**	Resumes the awaiting coroutine, if any, once the task completes.
+		 */
+		struct final_awaiter final
+		{
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			template <typename Promise>
+			std::coroutine_handle<> await_suspend(const std::coroutine_handle<Promise> completed) const noexcept
+			{
+				const std::coroutine_handle<> continuation = completed.promise().m_continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() const noexcept
+			{ }
+		};
+
+		static void* operator new(const std::size_t size)
+		{
+			return coroutine_frame_pool::allocate(size);
+		}
+		static void operator delete(void* const frame, const std::size_t size) noexcept
+		{
+			coroutine_frame_pool::deallocate(frame, size);
+		}
+
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+		final_awaiter final_suspend() const noexcept
+		{
+			return {};
+		}
+		void unhandled_exception() noexcept
+		{
+			m_exception = std::current_exception();
+		}
+
+		/**	The coroutine awaiting this task.
+		 */
+		std::coroutine_handle<> m_continuation;
+		std::exception_ptr m_exception;
+	};
+
+	/**	The promise of a task producing a value.
+	 *	@tparam T The result type.
+	 */
+	template <typename T>
+	class task_promise final : public task_promise_base
+	{
+	public:
+		task<T> get_return_object() noexcept;
+
+		template <typename Value>
+		void return_value(Value&& value)
+		{
+			m_value.emplace(std::forward<Value>(value));
+		}
+		T result()
+		{
+			if (m_exception)
+			{
+				std::rethrow_exception(m_exception);
+			}
+			return std::move(*m_value);
+		}
+
+		std::optional<T> m_value;
+	};
+
+	/**	The promise of a task producing nothing.
+	 */
+	template <>
+	class task_promise<void> final : public task_promise_base
+	{
+	public:
+		task<void> get_return_object() noexcept;
+
+		void return_void() const noexcept
+		{ }
+		void result()
+		{
+			if (m_exception)
+			{
+				std::rethrow_exception(m_exception);
+			}
+		}
+	};
+} // namespace detail
+
+/**	Implements a lazily started coroutine producing a value of type T.
+ *	@detail The coroutine starts when first awaited and, on completion,
+ *	resumes its awaiter by symmetric transfer. Frames come from
+ *	coroutine_frame_pool. Exceptions propagate to the awaiter.
+ *	@tparam T The result type.
+ */
+template <typename T>
+class task final
+{
+public:
+	using promise_type = detail::task_promise<T>;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+
+	/**	Default constructor, for a task with no coroutine.
+	 */
+	task() noexcept = default;
+	/**	Constructor taking ownership of a coroutine.
+	 *	@param handle The coroutine.
+	 */
+	explicit task(const handle_type handle) noexcept
+		: m_handle{ handle }
+	{ }
+	/**	Move constructor.
+	 *	@param other The task to move into this.
+	 */
+	task(task&& other) noexcept
+		: m_handle{ std::exchange(other.m_handle, nullptr) }
+	{ }
+	/**	Destructor.
+	 *	@detail Destroys the coroutine, which must not be running.
+	 */
+	~task()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+	/**	Move assignment.
+	 *	@param other The task to move into this.
+	 *	@return A reference to this.
+	 */
+	task& operator=(task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_handle)
+			{
+				m_handle.destroy();
+			}
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	/**	Test if this owns a coroutine.
+	 *	@return True if this may be awaited.
+	 */
+	explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(m_handle);
+	}
+	/**	Test if the coroutine has completed.
+	 *	@return True if completed.
+	 */
+	bool done() const noexcept
+	{
+		return m_handle.done();
+	}
+
+	/**	Start the coroutine and suspend the awaiter until it completes.
+	 *	@return An awaitable producing the task's result.
+	 */
+	auto operator co_await() const noexcept
+	{
+		struct awaiter final
+		{
+			bool await_ready() const noexcept
+			{
+				return m_handle.done();
+			}
+			std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaiting) const noexcept
+			{
+				m_handle.promise().m_continuation = awaiting;
+				return m_handle;
+			}
+			T await_resume() const
+			{
+				return m_handle.promise().result();
+			}
+
+			handle_type m_handle;
+		};
+		return awaiter{ m_handle };
+	}
+
+private:
+	handle_type m_handle;
+};
+
+namespace detail
+{
+	template <typename T>
+	task<T> task_promise<T>::get_return_object() noexcept
+	{
+		return task<T>{ std::coroutine_handle<task_promise<T>>::from_promise(*this) };
+	}
+	inline task<void> task_promise<void>::get_return_object() noexcept
+	{
+		return task<void>{ std::coroutine_handle<task_promise<void>>::from_promise(*this) };
+	}
+
+	/**	Signals sync_wait, on the waiting thread's stack, that its coroutine has finished.
+	 */
+	class sync_wait_signal final
+	{
+	public:
+		void set()
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			m_done = true;
+			m_condition.notify_one();
+		}
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_condition.wait(lock, [this]() { return m_done; });
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_done{ false };
+	};
+
+	/**	A coroutine that destroys its own frame on completion and then signals sync_wait.
+	 */
+	struct sync_wait_task final
+	{
+		struct promise_type final
+		{
+			struct final_awaiter final
+			{
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+				void await_suspend(const std::coroutine_handle<promise_type> completed) const noexcept
+				{
+					sync_wait_signal& signal = *completed.promise().m_signal;
+					// Destroyed first, as sync_wait may return as soon as signalled.
+					completed.destroy();
+					signal.set();
+				}
+				void await_resume() const noexcept
+				{ }
+			};
+
+			sync_wait_task get_return_object() noexcept
+			{
+				return sync_wait_task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+			}
+			std::suspend_always initial_suspend() const noexcept
+			{
+				return {};
+			}
+			final_awaiter final_suspend() const noexcept
+			{
+				return {};
+			}
+			void return_void() const noexcept
+			{ }
+			void unhandled_exception() const noexcept
+			{
+				std::terminate();
+			}
+
+			sync_wait_signal* m_signal{ nullptr };
+		};
+
+		std::coroutine_handle<promise_type> m_handle;
+	};
+
+	/**	Await a task, storing its result or exception.
+	 */
+	template <typename T, typename Result>
+	sync_wait_task sync_wait_run(task<T>& awaited, Result& result, std::exception_ptr& exception)
+	{
+		try
+		{
+			if constexpr (std::is_void_v<T>)
+			{
+				co_await awaited;
+			}
+			else
+			{
+				result.emplace(co_await awaited);
+			}
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+	}
+
+	/**	A coroutine that runs until completion and then destroys its own frame.
+	 */
+	struct detached_task final
+	{
+		struct promise_type final
+		{
+			detached_task get_return_object() const noexcept
+			{
+				return {};
+			}
+			std::suspend_never initial_suspend() const noexcept
+			{
+				return {};
+			}
+			std::suspend_never final_suspend() const noexcept
+			{
+				return {};
+			}
+			void return_void() const noexcept
+			{ }
+			void unhandled_exception() const noexcept
+			{
+				std::terminate();
+			}
+		};
+	};
+} // namespace detail
+
+/**	Start a task on the calling thread and wait for it to complete.
+ *	@detail The task may move itself to other threads meanwhile.
+ *	@param awaited The task.
+ *	@return The task's result.
+ *	@tparam T The result type.
+ */
+template <typename T>
+T sync_wait(task<T> awaited)
+{
+	using result_type = std::conditional_t<std::is_void_v<T>, std::nullptr_t, std::optional<T>>;
+	result_type result{};
+	std::exception_ptr exception;
+	detail::sync_wait_signal signal;
+	const detail::sync_wait_task waiter = detail::sync_wait_run(awaited, result, exception);
+	waiter.m_handle.promise().m_signal = &signal;
+	waiter.m_handle.resume();
+	signal.wait();
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+	if constexpr (false == std::is_void_v<T>)
+	{
+		return std::move(*result);
+	}
+}
+
+/**	An awaitable that suspends the awaiting coroutine and resumes it upon an executor.
+ *	@detail The coroutine handle is submitted within a callable of a single
+ *	pointer, which every sh wrapper stores in-place, so nothing is allocated
+ *	by the hand-off itself.
+ *	@tparam Executor The executor type. Requires submit(callable) or post(callable).
+ */
+template <typename Executor>
+class schedule_awaitable final
+{
+public:
+	explicit schedule_awaitable(Executor& executor) noexcept
+		: m_executor{ executor }
+	{ }
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+	void await_suspend(const std::coroutine_handle<> awaiting) const
+	{
+		detail::coroutine_submit(m_executor, detail::coroutine_resumer{ awaiting });
+	}
+	void await_resume() const noexcept
+	{ }
+
+private:
+	Executor& m_executor;
+};
+
+/**	Resume the awaiting coroutine upon an executor.
+ *	@param executor The executor, such as thread_pool or reactor.
+ *	@return An awaitable.
+ *	@tparam Executor The executor type. Requires submit(callable) or post(callable).
+ */
+template <typename Executor>
+schedule_awaitable<Executor> schedule_on(Executor& executor) noexcept
+{
+	return schedule_awaitable<Executor>{ executor };
+}
+
+/**	Start a task upon an executor without waiting for it.
+ *	@detail The task's frame is destroyed once it completes. The task must not throw.
+ *	@param executor The executor upon which to start the task.
+ *	@param started The task.
+ *	@tparam Executor The executor type. Requires submit(callable) or post(callable).
+ */
+template <typename Executor>
+void spawn(Executor& executor, task<void> started)
+{
+	[](Executor& on, task<void> owned) -> detail::detached_task
+	{
+		co_await schedule_on(on);
+		co_await owned;
+	}(executor, std::move(started));
+}
+
+/**	Adapts an executor that accepts move_only_function<void()> for use with schedule_on and spawn.
+ *	@detail Coroutines are submitted as callables small enough to be stored
+ *	in-place by move_only_function, so resuming through the adapted executor
+ *	does not allocate.
+ *	@tparam Submit The type of a callable passing a move_only_function<void()> to the executor.
+ */
+template <typename Submit>
+class coroutine_executor final
+{
+public:
+	/**	Constructor.
+	 *	@param submit Called with each move_only_function<void()> to execute.
+	 */
+	explicit coroutine_executor(Submit submit)
+		: m_submit{ std::move(submit) }
+	{ }
+
+	/**	Submit a callable to the adapted executor.
+	 *	@param callable An invocable to wrap in a move_only_function<void()>.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable>
+	void submit(Callable&& callable)
+	{
+		m_submit(sh::move_only_function<void()>{ std::forward<Callable>(callable) });
+	}
+	/**	Resume the awaiting coroutine upon the adapted executor.
+	 *	@return An awaitable.
+	 */
+	schedule_awaitable<coroutine_executor> schedule() noexcept
+	{
+		return schedule_awaitable<coroutine_executor>{ *this };
+	}
+
+private:
+	Submit m_submit;
+};
+
+} // namespace sh
+
+#endif
+
+#endif
@@ -0,0 +1,328 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__FUNCTION_BULK_HPP
+#define INC_SH__FUNCTION_BULK_HPP
+
+/**	@file
+ *	This file declares a builder that constructs many closures into one
+ *	contiguous allocation, each referenced by a copyable_function.
+ */
+
+#include "copyable_function.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	The alignment of every entry within a function bulk block, and the maximum alignment of its closures.
+	 */
+	constexpr std::size_t function_bulk_alignment = alignof(std::max_align_t);
+
+	/**	Round a byte count up to a multiple of function_bulk_alignment.
+	 *	@param size The byte count.
+	 *	@return The rounded byte count.
+	 */
+	constexpr std::size_t function_bulk_align(const std::size_t size) noexcept
+	{
+		return (size + function_bulk_alignment - 1) & ~(function_bulk_alignment - 1);
+	}
+
+	/**	The start of a function bulk block, followed by its entries.
+	 *	@detail Each entry is an entry header followed by a closure.
+	 */
+	struct alignas(function_bulk_alignment) function_bulk_block final
+	{
+		/**	The header of each entry.
+		 */
+		struct alignas(function_bulk_alignment) entry final
+		{
+			using destroy_type = void(*)(void*) noexcept;
+
+			/**	Destroys the closure following this.
+			 */
+			destroy_type m_destroy;
+			/**	The size of this entry, including the closure, in bytes.
+			 */
+			std::size_t m_size;
+		};
+
+		/**	The number of builders and targets referring to this block.
+		 */
+		std::atomic<std::size_t> m_references{ 1 };
+		/**	The number of entry bytes allocated.
+		 */
+		std::size_t m_capacity{ 0 };
+		/**	The number of entry bytes constructed.
+		 */
+		std::size_t m_used{ 0 };
+
+		/**	The size of the entry for a closure type.
+		 *	@return The entry's size in bytes.
+		 *	@tparam Callable The closure type.
+		 */
+		template <typename Callable>
+		static constexpr std::size_t entry_size() noexcept
+		{
+			static_assert(alignof(Callable) <= function_bulk_alignment, "function_bulk does not support over-aligned closures.");
+			return sizeof(entry) + function_bulk_align(sizeof(Callable));
+		}
+		/**	Allocate a block.
+		 *	@param capacity The number of entry bytes.
+		 *	@return The block, with one reference.
+		 */
+		static function_bulk_block* allocate(const std::size_t capacity)
+		{
+			function_bulk_block* const block = new(::operator new(sizeof(function_bulk_block) + capacity)) function_bulk_block{};
+			block->m_capacity = capacity;
+			return block;
+		}
+		/**	Add a reference.
+		 */
+		void acquire() noexcept
+		{
+			m_references.fetch_add(1, std::memory_order_relaxed);
+		}
+		/**	Remove a reference, destroying every closure and freeing the block if it was the last.
+		 */
+		void release() noexcept
+		{
+			if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				unsigned char* const entries = reinterpret_cast<unsigned char*>(this + 1);
+				for (std::size_t offset = 0; offset < m_used; )
+				{
+					entry* const each = reinterpret_cast<entry*>(entries + offset);
+					each->m_destroy(each + 1);
+					offset += each->m_size;
+				}
+				this->~function_bulk_block();
+				::operator delete(this);
+			}
+		}
+		/**	Construct a closure into the next entry.
+		 *	@detail Throws std::length_error if the entry does not fit.
+		 *	@param callable The callable from which to construct the closure.
+		 *	@return The closure.
+		 *	@tparam Callable The closure type.
+		 *	@tparam Arg The type of the given callable.
+		 */
+		template <typename Callable, typename Arg>
+		Callable* emplace(Arg&& callable)
+		{
+			constexpr std::size_t size = entry_size<Callable>();
+			if (size > m_capacity - m_used)
+			{
+				throw std::length_error{ "function_bulk_builder capacity exceeded" };
+			}
+			entry* const added = reinterpret_cast<entry*>(reinterpret_cast<unsigned char*>(this + 1) + m_used);
+			Callable* const result = new(added + 1) Callable{ std::forward<Arg>(callable) };
+			added->m_destroy = [](void* const closure) noexcept -> void
+			{
+				static_cast<Callable*>(closure)->~Callable();
+			};
+			added->m_size = size;
+			m_used += size;
+			return result;
+		}
+	};
+
+	/**	A reference to a closure within a function bulk block, sharing ownership of the block.
+	 *	@detail Two pointers, nothrow movable, so it is stored in-place by copyable_function.
+	 *	@tparam Callable The closure type.
+	 */
+	template <typename Callable>
+	class function_bulk_target final
+	{
+	public:
+		function_bulk_target(function_bulk_block& block, Callable& callable) noexcept
+			: m_block{ &block }
+			, m_callable{ &callable }
+		{
+			block.acquire();
+		}
+		function_bulk_target(const function_bulk_target& other) noexcept
+			: m_block{ other.m_block }
+			, m_callable{ other.m_callable }
+		{
+			m_block->acquire();
+		}
+		function_bulk_target(function_bulk_target&& other) noexcept
+			: m_block{ std::exchange(other.m_block, nullptr) }
+			, m_callable{ other.m_callable }
+		{ }
+		function_bulk_target& operator=(const function_bulk_target&) = delete;
+		~function_bulk_target()
+		{
+			if (m_block != nullptr)
+			{
+				m_block->release();
+			}
+		}
+
+		template <typename... CallArgs>
+		auto operator()(CallArgs&&... args) const -> decltype(std::declval<Callable&>()(std::forward<CallArgs>(args)...))
+		{
+			return (*m_callable)(std::forward<CallArgs>(args)...);
+		}
+
+	private:
+		function_bulk_block* m_block;
+		Callable* m_callable;
+	};
+} // namespace detail
+
+/**	Implements a builder that constructs many closures into one contiguous allocation.
+ *	@detail Reserve space for every closure first, then emplace them; the
+ *	first emplace allocates a single block of exactly the reserved size and
+ *	each closure is constructed into it once, never moved. Each resulting
+ *	copyable_function holds a two-pointer reference to its closure and a
+ *	shared count on the block, small enough to be stored in-place, so
+ *	building N functions costs one allocation rather than N. The block, and
+ *	every closure within it, is destroyed once the builder and all of the
+ *	functions referring to it are. Copies of a function share its closure,
+ *	rather than copying it, so closures that mutate their captures are seen
+ *	to by every copy. Reference counting is thread-safe; the builder is not.
+ *	@tparam Signature The function signature.
+ */
+template <typename Signature>
+class function_bulk_builder final
+{
+public:
+	using function_type = sh::copyable_function<Signature>;
+	using size_type = std::size_t;
+
+	function_bulk_builder() noexcept = default;
+	function_bulk_builder(const function_bulk_builder&) = delete;
+	function_bulk_builder& operator=(const function_bulk_builder&) = delete;
+	/**	Destructor, releasing the builder's reference to the block.
+	 */
+	~function_bulk_builder()
+	{
+		if (m_block != nullptr)
+		{
+			m_block->release();
+		}
+	}
+
+	/**	Reserve space for closures of a type. Only before the first emplace.
+	 *	@param count The number of closures.
+	 *	@tparam Callable The type of the callables that will be emplaced.
+	 */
+	template <typename Callable>
+	void reserve(const size_type count = 1) noexcept
+	{
+		assert(m_block == nullptr);
+		m_reserved += detail::function_bulk_block::entry_size<std::decay_t<Callable>>() * count;
+	}
+	/**	The number of bytes reserved for closures.
+	 *	@return The block's entry capacity.
+	 */
+	size_type reserved() const noexcept
+	{
+		return m_reserved;
+	}
+	/**	Construct a closure into the block and wrap a reference to it.
+	 *	@detail Allocates the block on first use. Throws std::length_error if
+	 *	the closure does not fit in the space reserved.
+	 *	@param callable An invocable to construct the closure from.
+	 *	@return A function referring to the closure.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable>
+	function_type emplace(Callable&& callable)
+	{
+		using callable_type = std::decay_t<Callable>;
+		using target_type = detail::function_bulk_target<callable_type>;
+		static_assert(detail::copyable_function_storage::store_inplace<target_type>(), "function_bulk_target must be stored in-place.");
+		if (m_block == nullptr)
+		{
+			m_block = detail::function_bulk_block::allocate(m_reserved);
+		}
+		callable_type* const closure = m_block->emplace<callable_type>(std::forward<Callable>(callable));
+		return function_type{ target_type{ *m_block, *closure } };
+	}
+
+private:
+	detail::function_bulk_block* m_block{ nullptr };
+	size_type m_reserved{ 0 };
+};
+
+/**	Construct functions from several callables with one allocation.
+ *	@param callables The invocables to wrap.
+ *	@return A function per callable, in order.
+ *	@tparam Signature The function signature.
+ *	@tparam Callables The types of the given invocable targets.
+ */
+template <typename Signature, typename... Callables>
+std::array<sh::copyable_function<Signature>, sizeof...(Callables)> make_functions_bulk(Callables&&... callables)
+{
+	function_bulk_builder<Signature> builder;
+	(builder.template reserve<Callables>(), ...);
+	// Braced initialisers are evaluated in order.
+	return std::array<sh::copyable_function<Signature>, sizeof...(Callables)>{ builder.emplace(std::forward<Callables>(callables))... };
+}
+/**	Construct many functions from a factory with one allocation.
+ *	@param count The number of functions.
+ *	@param factory An invocable that, given each index from zero, returns a callable to wrap.
+ *	@return The functions, in index order.
+ *	@tparam Signature The function signature.
+ *	@tparam Factory The type of the given factory.
+ */
+template <typename Signature, typename Factory>
+std::vector<sh::copyable_function<Signature>> make_functions_bulk_n(const std::size_t count, Factory&& factory)
+{
+	using callable_type = std::decay_t<std::invoke_result_t<Factory&, std::size_t>>;
+	function_bulk_builder<Signature> builder;
+	builder.template reserve<callable_type>(count);
+	std::vector<sh::copyable_function<Signature>> result;
+	result.reserve(count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		result.push_back(builder.emplace(factory(i)));
+	}
+	return result;
+}
+
+} // namespace sh
+
+#endif
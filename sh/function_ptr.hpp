@@ -179,6 +179,13 @@ namespace detail
 		{
 			return m_target != nullptr;
 		}
+		/**	The address of the target, identifying it among other function_ptr.
+		 *	@return The pointed-to callable object's or function's address, or null.
+		 */
+		const void* target_address() const noexcept
+		{
+			return m_target;
+		}
 		/**	Swap this with another function_ptr.
 		 *	@param other The function_ptr with which to swap contents.
 		 */
@@ -0,0 +1,402 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__FUNCTION_RECLAIMER_HPP
+#define INC_SH__FUNCTION_RECLAIMER_HPP
+
+/**	@file
+ *	This file declares a background reclaimer that destroys retired function
+ *	wrappers in batches, and a move_only_function that retires its target
+ *	rather than destroying it.
+ */
+
+#include "move_only_function.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+class function_reclaimer;
+
+namespace detail
+{
+	/**	A retired wrapper, relocated by its move constructor, and how to destroy it.
+	 */
+	struct function_reclaimer_record final
+	{
+		using dtor_type = void(*)(void* const) noexcept;
+
+		static constexpr std::size_t capacity = sizeof(void*) * 4;
+
+		dtor_type m_dtor;
+		alignas(std::max_align_t) std::byte m_storage[capacity];
+	};
+
+	/**	Destroy a wrapper stored in a record.
+	 *	@param storage The record's storage.
+	 *	@tparam Function The wrapper type.
+	 */
+	template <typename Function>
+	void function_reclaimer_destroy(void* const storage) noexcept
+	{
+		static_cast<Function*>(storage)->~Function();
+	}
+
+	/**	The calling thread's batch of retired wrappers, handed to its reclaimer when full or when the thread exits.
+	 */
+	struct function_reclaimer_batch final
+	{
+		function_reclaimer_batch() noexcept;
+		~function_reclaimer_batch();
+
+		void flush();
+
+		function_reclaimer* m_owner{ nullptr };
+		std::vector<function_reclaimer_record> m_records;
+	};
+
+	/**	The calling thread's batch while it is alive, else null.
+	 *	@detail Trivially destructible, so still readable during static
+	 *	destruction, after the main thread's batch has been destroyed.
+	 *	@return A reference to a thread_local pointer.
+	 */
+	inline function_reclaimer_batch*& function_reclaimer_live_batch() noexcept
+	{
+		thread_local function_reclaimer_batch* live = nullptr;
+		return live;
+	}
+	inline function_reclaimer_batch& function_reclaimer_local_batch() noexcept
+	{
+		thread_local function_reclaimer_batch instance;
+		return instance;
+	}
+} // namespace detail
+
+/**	Destroys retired function wrappers on a background thread.
+ *	@detail Retiring a wrapper move-constructs it into a record of the
+ *	calling thread's batch, which takes its heap block or relocates its
+ *	in-place bytes, so the caller pays for neither the target's destructor
+ *	nor freeing its memory. Full batches are handed to the reclaimer's
+ *	thread under a mutex, once per batch, and come back emptied for reuse.
+ *	@note Targets are destroyed on another thread, so must not depend on
+ *	the retiring thread, and may be destroyed in any order.
+ */
+class function_reclaimer final
+{
+public:
+	using size_type = std::size_t;
+	using record_type = detail::function_reclaimer_record;
+
+	/**	The number of wrappers per batch.
+	 */
+	static constexpr size_type batch_size = 64;
+
+	function_reclaimer(const function_reclaimer&) = delete;
+	function_reclaimer(function_reclaimer&&) = delete;
+	function_reclaimer& operator=(const function_reclaimer&) = delete;
+	function_reclaimer& operator=(function_reclaimer&&) = delete;
+
+	/**	Constructor, starting the reclaiming thread.
+	 */
+	function_reclaimer()
+		: m_thread{ [this]() { run(); } }
+	{ }
+	/**	Destructor.
+	 *	@detail Destroys every batch already handed over and joins the reclaiming thread.
+	 *	The calling thread's batch is flushed first; other threads' batches must already have been.
+	 */
+	~function_reclaimer()
+	{
+		// Neither construct nor touch a destroyed batch, as the main thread's is gone by the time static reclaimers are destroyed.
+		detail::function_reclaimer_batch* const local = detail::function_reclaimer_live_batch();
+		if (local != nullptr && local->m_owner == this)
+		{
+			local->flush();
+			local->m_owner = nullptr;
+		}
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	/**	The process-wide reclaimer, used by deferred_move_only_function.
+	 *	@return A reference to a static reclaimer.
+	 */
+	static function_reclaimer& instance()
+	{
+		static function_reclaimer instance;
+		return instance;
+	}
+
+	/**	Move a wrapper into the calling thread's batch for destruction on the reclaiming thread.
+	 *	@detail Only allocates when a batch is handed over and no emptied batch is available for reuse.
+	 *	If this throws, function is left untouched.
+	 *	@param function The wrapper, such as move_only_function.
+	 *	@tparam Function The wrapper type. Must be nothrow move constructible and fit a record.
+	 */
+	template <typename Function,
+		typename = std::enable_if_t<false == std::is_lvalue_reference_v<Function>>>
+	void retire(Function&& function)
+	{
+		using function_type = std::decay_t<Function>;
+		static_assert(sizeof(function_type) <= record_type::capacity, "Function too large for function_reclaimer records.");
+		static_assert(alignof(function_type) <= alignof(std::max_align_t), "Function alignment too large for function_reclaimer records.");
+		static_assert(std::is_nothrow_move_constructible_v<function_type>, "function_reclaimer requires nothrow move constructible functions.");
+		detail::function_reclaimer_batch& local = detail::function_reclaimer_local_batch();
+		if (local.m_owner != this)
+		{
+			local.flush();
+			local.m_owner = this;
+		}
+		if (local.m_records.size() == batch_size)
+		{
+			local.flush();
+		}
+		if (local.m_records.capacity() < batch_size)
+		{
+			local.m_records.reserve(batch_size);
+		}
+		// Within capacity, so records never relocate.
+		record_type& record = local.m_records.emplace_back();
+		new(&record.m_storage) function_type{ std::move(function) };
+		record.m_dtor = &detail::function_reclaimer_destroy<function_type>;
+	}
+	/**	Hand the calling thread's batch to the reclaiming thread, if not empty.
+	 */
+	void flush()
+	{
+		detail::function_reclaimer_batch& local = detail::function_reclaimer_local_batch();
+		if (local.m_owner == this)
+		{
+			local.flush();
+		}
+	}
+	/**	Flush the calling thread's batch and wait until every batch handed over so far is destroyed.
+	 */
+	void synchronize()
+	{
+		flush();
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		const std::uint64_t target = m_handed;
+		m_reclaimed_condition.wait(lock, [this, target]() { return m_reclaimed >= target; });
+	}
+
+private:
+	friend struct detail::function_reclaimer_batch;
+
+	/**	Take a full batch, replacing it with an emptied one.
+	 *	@param records The batch.
+	 */
+	void hand(std::vector<record_type>& records)
+	{
+		std::vector<record_type> replacement;
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			m_pending.reserve(m_pending.size() + 1);
+			if (false == m_spares.empty())
+			{
+				replacement = std::move(m_spares.back());
+				m_spares.pop_back();
+			}
+			m_pending.push_back(std::move(records));
+			++m_handed;
+		}
+		m_wake.notify_one();
+		records = std::move(replacement);
+	}
+	/**	The reclaiming thread's loop.
+	 */
+	void run()
+	{
+		std::vector<std::vector<record_type>> reclaiming;
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stop || false == m_pending.empty(); });
+			if (m_pending.empty())
+			{
+				return;
+			}
+			reclaiming.swap(m_pending);
+			lock.unlock();
+			for (std::vector<record_type>& records : reclaiming)
+			{
+				for (record_type& record : records)
+				{
+					record.m_dtor(&record.m_storage);
+				}
+				records.clear();
+			}
+			lock.lock();
+			m_reclaimed += reclaiming.size();
+			for (std::vector<record_type>& records : reclaiming)
+			{
+				if (m_spares.size() < spare_limit)
+				{
+					m_spares.push_back(std::move(records));
+				}
+			}
+			reclaiming.clear();
+			m_reclaimed_condition.notify_all();
+		}
+	}
+
+	/**	The number of emptied batches kept for reuse.
+	 */
+	static constexpr size_type spare_limit = 64;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_reclaimed_condition;
+	/**	Batches handed over and not yet destroyed.
+	 */
+	std::vector<std::vector<record_type>> m_pending;
+	/**	Emptied batches, retaining their capacity.
+	 */
+	std::vector<std::vector<record_type>> m_spares;
+	std::uint64_t m_handed{ 0 };
+	std::uint64_t m_reclaimed{ 0 };
+	bool m_stop{ false };
+	std::thread m_thread;
+};
+
+namespace detail
+{
+	inline function_reclaimer_batch::function_reclaimer_batch() noexcept
+	{
+		function_reclaimer_live_batch() = this;
+	}
+	inline function_reclaimer_batch::~function_reclaimer_batch()
+	{
+		function_reclaimer_live_batch() = nullptr;
+		flush();
+		m_owner = nullptr;
+	}
+	inline void function_reclaimer_batch::flush()
+	{
+		if (m_owner != nullptr && false == m_records.empty())
+		{
+			m_owner->hand(m_records);
+		}
+	}
+} // namespace detail
+
+/**	A move_only_function whose targets are destroyed by function_reclaimer::instance() rather than in place.
+ *	@detail Destruction and assignment retire the previous target. If
+ *	retiring fails to allocate, the target is destroyed in place instead.
+ *	@tparam Signature The function signature, as for move_only_function.
+ */
+template <typename Signature>
+class deferred_move_only_function final : public sh::move_only_function<Signature>
+{
+	using base_type = sh::move_only_function<Signature>;
+
+public:
+	using base_type::base_type;
+
+	deferred_move_only_function() noexcept = default;
+	deferred_move_only_function(deferred_move_only_function&&) noexcept = default;
+	/**	Destructor, retiring the target.
+	 */
+	~deferred_move_only_function()
+	{
+		retire_target();
+	}
+
+	/**	Move assigment, retiring the previous target.
+	 *	@param other The deferred_move_only_function to move into this.
+	 *	@return A reference to this.
+	 */
+	deferred_move_only_function& operator=(deferred_move_only_function&& other) noexcept
+	{
+		if (this != &other)
+		{
+			retire_target();
+			base_type::operator=(std::move(other));
+		}
+		return *this;
+	}
+	/**	Null assignment, retiring the previous target.
+	 *	@return A reference to this.
+	 */
+	deferred_move_only_function& operator=(const std::nullptr_t) noexcept
+	{
+		retire_target();
+		return *this;
+	}
+	/**	Assign a given callable, retiring the previous target.
+	 *	@param callable An invocable to wrap.
+	 *	@return A reference to this.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<false == std::is_same_v<std::decay_t<Callable>, deferred_move_only_function>
+			&& false == std::is_same_v<std::decay_t<Callable>, std::nullptr_t>>>
+	deferred_move_only_function& operator=(Callable&& callable)
+	{
+		retire_target();
+		base_type::operator=(std::forward<Callable>(callable));
+		return *this;
+	}
+
+private:
+	void retire_target() noexcept
+	{
+		if (static_cast<bool>(*this))
+		{
+			try
+			{
+				function_reclaimer::instance().retire(std::move(static_cast<base_type&>(*this)));
+			}
+			catch (...)
+			{
+				// Left untouched, to be destroyed in place.
+			}
+			base_type::operator=(nullptr);
+		}
+	}
+};
+
+} // namespace sh
+
+#endif
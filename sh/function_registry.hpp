@@ -0,0 +1,217 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__FUNCTION_REGISTRY_HPP
+#define INC_SH__FUNCTION_REGISTRY_HPP
+
+/**	@file
+ *	This file declares a table of stateless functions addressed by stable
+ *	identifiers, so that calls may be described across process boundaries.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace sh
+{
+
+/**	Implements a table of stateless functions addressed by stable identifiers.
+ *	@detail Unlike function_ptr, which holds addresses meaningful only within
+ *	one process, a registry maps identifiers chosen by the caller, or
+ *	derived from names by id_of, to functions taking nothing or one
+ *	trivially copyable argument passed as bytes. Processes that register the
+ *	same functions under the same identifiers can therefore describe calls
+ *	to each other, as shm_task_ring does. Functions are free function
+ *	pointers or empty callables such as captureless lambdas, copied into the
+ *	registry. Registration is expected up front; lookup is a binary search
+ *	over a sorted vector. Not thread-safe while registering.
+ */
+class function_registry final
+{
+public:
+	using id_type = std::uint32_t;
+	using size_type = std::size_t;
+
+	/**	Derive an identifier from a name, stable across processes and builds.
+	 *	@param name The name.
+	 *	@return The 32-bit FNV-1a hash of name.
+	 */
+	static constexpr id_type id_of(const std::string_view name) noexcept
+	{
+		id_type hash = 2166136261u;
+		for (const char each : name)
+		{
+			hash = (hash ^ static_cast<unsigned char>(each)) * 16777619u;
+		}
+		return hash;
+	}
+
+	/**	Register a function.
+	 *	@detail Throws std::invalid_argument if the identifier is already registered.
+	 *	@param id The identifier.
+	 *	@param callable A function pointer or empty callable, invocable with an Arg, or with nothing if Arg is void.
+	 *	@tparam Arg The trivially copyable argument type, or void.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Arg = void, typename Callable>
+	void add(const id_type id, const Callable callable)
+	{
+		static_assert(std::is_void_v<Arg> || std::is_trivially_copyable_v<Arg>, "function_registry requires a trivially copyable argument.");
+		static_assert(std::is_trivially_copyable_v<Callable> && sizeof(Callable) <= sizeof(void*)
+			&& (std::is_empty_v<Callable> || std::is_pointer_v<Callable>),
+			"function_registry requires a function pointer or empty callable.");
+		const auto position = std::lower_bound(m_entries.begin(), m_entries.end(), id, entry_before{});
+		if (position != m_entries.end() && position->m_id == id)
+		{
+			throw std::invalid_argument{ "function_registry identifier already registered" };
+		}
+		entry added{};
+		added.m_id = id;
+		if constexpr (std::is_void_v<Arg>)
+		{
+			static_assert(std::is_invocable_v<const Callable&>, "Callable must be invocable without arguments.");
+			added.m_size = 0;
+			added.m_invoke = [](const void* const target, const void* const) -> void
+			{
+				(*static_cast<const Callable*>(target))();
+			};
+		}
+		else
+		{
+			static_assert(std::is_invocable_v<const Callable&, const Arg&>, "Callable must be invocable with Arg.");
+			added.m_size = sizeof(Arg);
+			added.m_invoke = [](const void* const target, const void* const bytes) -> void
+			{
+				// Copy out, as bytes need not be aligned for Arg.
+				Arg arg;
+				std::memcpy(&arg, bytes, sizeof(Arg));
+				(*static_cast<const Callable*>(target))(static_cast<const Arg&>(arg));
+			};
+		}
+		std::memcpy(&added.m_target, &callable, sizeof(Callable));
+		m_entries.insert(position, added);
+	}
+	/**	Test if an identifier is registered.
+	 *	@param id The identifier.
+	 *	@return True if registered.
+	 */
+	bool contains(const id_type id) const noexcept
+	{
+		return find(id) != nullptr;
+	}
+	/**	The size of the argument a registered function takes.
+	 *	@detail Throws std::out_of_range if the identifier is not registered.
+	 *	@param id The identifier.
+	 *	@return The argument's size in bytes, or zero if it takes none.
+	 */
+	size_type argument_size(const id_type id) const
+	{
+		return checked_find(id).m_size;
+	}
+	/**	The number of registered functions.
+	 *	@return The function count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_entries.size();
+	}
+
+	/**	Call a registered function with an argument given as bytes.
+	 *	@detail Throws std::out_of_range if the identifier is not registered, or
+	 *	std::invalid_argument if size does not match its argument's size.
+	 *	@param id The identifier.
+	 *	@param bytes The argument's bytes, which need not be aligned.
+	 *	@param size The number of bytes.
+	 */
+	void invoke(const id_type id, const void* const bytes, const size_type size) const
+	{
+		const entry& found = checked_find(id);
+		if (size != found.m_size)
+		{
+			throw std::invalid_argument{ "function_registry argument size mismatch" };
+		}
+		found.m_invoke(&found.m_target, bytes);
+	}
+
+private:
+	/**	A registered function.
+	 */
+	struct entry final
+	{
+		using invoke_type = void(*)(const void*, const void*);
+
+		id_type m_id;
+		std::uint32_t m_size;
+		/**	Calls m_target with the argument in the given bytes.
+		 */
+		invoke_type m_invoke;
+		/**	A copy of the function pointer or empty callable.
+		 */
+		alignas(void*) unsigned char m_target[sizeof(void*)];
+	};
+	struct entry_before final
+	{
+		bool operator()(const entry& lhs, const id_type rhs) const noexcept
+		{
+			return lhs.m_id < rhs;
+		}
+	};
+
+	const entry* find(const id_type id) const noexcept
+	{
+		const auto position = std::lower_bound(m_entries.begin(), m_entries.end(), id, entry_before{});
+		return position != m_entries.end() && position->m_id == id ? &*position : nullptr;
+	}
+	const entry& checked_find(const id_type id) const
+	{
+		const entry* const found = find(id);
+		if (found == nullptr)
+		{
+			throw std::out_of_range{ "function_registry identifier not registered" };
+		}
+		return *found;
+	}
+
+	/**	Registered functions, sorted by identifier.
+	 */
+	std::vector<entry> m_entries;
+};
+
+} // namespace sh
+
+#endif
@@ -0,0 +1,503 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__FUTURE_HPP
+#define INC_SH__FUTURE_HPP
+
+/**	@file
+ *	This file declares a promise and future pair whose shared state embeds
+ *	the result and an in-place continuation, optionally recycled by a pool.
+ */
+
+#include "inplace_move_only_function.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+/**	Thrown by future::get when the promise was destroyed without a value.
+ */
+class broken_promise final : public std::logic_error
+{
+public:
+	broken_promise()
+		: std::logic_error{ "broken promise" }
+	{ }
+};
+
+template <typename T, std::size_t ContinuationCapacity = sizeof(void*) * 4>
+class future_pool;
+template <typename T, std::size_t ContinuationCapacity = sizeof(void*) * 4>
+class promise;
+template <typename T, std::size_t ContinuationCapacity = sizeof(void*) * 4>
+class future;
+
+namespace detail
+{
+	/**	The state shared by a promise and its future.
+	 *	@detail The promise sets the value flag after constructing the value
+	 *	and the future sets the continuation flag after constructing the
+	 *	continuation, each by a single atomic fetch_or. Whichever finds the
+	 *	other's flag already set calls the continuation.
+	 *	@tparam T The value type.
+	 *	@tparam ContinuationCapacity The number of in-place storage bytes for the continuation.
+	 */
+	template <typename T, std::size_t ContinuationCapacity>
+	class future_state final
+	{
+	public:
+		using continuation_type = sh::inplace_move_only_function<void(T&&), ContinuationCapacity>;
+		using pool_type = future_pool<T, ContinuationCapacity>;
+
+		static constexpr std::uint32_t value_flag = 1;
+		static constexpr std::uint32_t continuation_flag = 2;
+		static constexpr std::uint32_t broken_flag = 4;
+
+		explicit future_state(pool_type* const pool) noexcept
+			: m_pool{ pool }
+		{ }
+		future_state(const future_state&) = delete;
+		future_state& operator=(const future_state&) = delete;
+		~future_state()
+		{
+			reset();
+		}
+
+		T& value() noexcept
+		{
+			return *std::launder(reinterpret_cast<T*>(&m_value));
+		}
+		/**	Publish a flag, calling the continuation if this completes the pair.
+		 *	@param flag The flag to set.
+		 */
+		void publish(const std::uint32_t flag)
+		{
+			const std::uint32_t previous = m_flags.fetch_or(flag, std::memory_order_acq_rel);
+			if ((previous | flag) == (value_flag | continuation_flag))
+			{
+				m_continuation(std::move(value()));
+			}
+#if defined(__cpp_lib_atomic_wait)
+			if (flag != continuation_flag)
+			{
+				m_flags.notify_all();
+			}
+#endif
+		}
+		/**	Wait for the value or for the promise to break.
+		 *	@return The flags.
+		 */
+		std::uint32_t wait() const noexcept
+		{
+			std::uint32_t flags = m_flags.load(std::memory_order_acquire);
+			while ((flags & (value_flag | broken_flag)) == 0)
+			{
+#if defined(__cpp_lib_atomic_wait)
+				m_flags.wait(flags, std::memory_order_acquire);
+#else
+				std::this_thread::yield();
+#endif
+				flags = m_flags.load(std::memory_order_acquire);
+			}
+			return flags;
+		}
+		/**	Drop one of the two references, recycling or deleting this when none remain.
+		 */
+		void release() noexcept
+		{
+			if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				if (m_pool != nullptr)
+				{
+					reset();
+					m_pool->recycle(this);
+				}
+				else
+				{
+					delete this;
+				}
+			}
+		}
+
+		std::atomic<std::uint32_t> m_flags{ 0 };
+		std::atomic<std::uint32_t> m_references{ 2 };
+		continuation_type m_continuation;
+		alignas(T) unsigned char m_value[sizeof(T)];
+		/**	The pool to which this returns, or null if allocated alone.
+		 */
+		pool_type* const m_pool;
+
+	private:
+		/**	Destroy the value and continuation, ready for reuse.
+		 */
+		void reset() noexcept
+		{
+			if (m_flags.load(std::memory_order_relaxed) & value_flag)
+			{
+				value().~T();
+			}
+			m_continuation = nullptr;
+			m_flags.store(0, std::memory_order_relaxed);
+			m_references.store(2, std::memory_order_relaxed);
+		}
+	};
+} // namespace detail
+
+/**	Recycles the shared states of promise and future pairs.
+ *	@detail States are kept on a mutex-protected free list, so a pool-backed
+ *	promise only allocates when the list is empty. The pool must outlive
+ *	every promise and future created from it.
+ *	@tparam T The value type.
+ *	@tparam ContinuationCapacity The number of in-place storage bytes for each continuation.
+ */
+template <typename T, std::size_t ContinuationCapacity>
+class future_pool final
+{
+public:
+	using size_type = std::size_t;
+
+	future_pool(const future_pool&) = delete;
+	future_pool& operator=(const future_pool&) = delete;
+
+	/**	Constructor.
+	 *	@param capacity The number of states to allocate up front.
+	 */
+	explicit future_pool(const size_type capacity = 0)
+	{
+		m_free.reserve(capacity);
+		for (size_type i = 0; i < capacity; ++i)
+		{
+			m_free.push_back(new state_type{ this });
+		}
+	}
+	/**	Destructor.
+	 */
+	~future_pool()
+	{
+		for (state_type* const state : m_free)
+		{
+			delete state;
+		}
+	}
+
+private:
+	using state_type = detail::future_state<T, ContinuationCapacity>;
+	friend class promise<T, ContinuationCapacity>;
+	friend state_type;
+
+	state_type* allocate()
+	{
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			if (false == m_free.empty())
+			{
+				state_type* const state = m_free.back();
+				m_free.pop_back();
+				return state;
+			}
+		}
+		return new state_type{ this };
+	}
+	void recycle(state_type* const state) noexcept
+	{
+		const std::lock_guard<std::mutex> lock{ m_mutex };
+		try
+		{
+			m_free.push_back(state);
+		}
+		catch (...)
+		{
+			delete state;
+		}
+	}
+
+	std::mutex m_mutex;
+	std::vector<state_type*> m_free;
+};
+
+/**	The producing half of a single-value channel.
+ *	@tparam T The value type. Must not be void.
+ *	@tparam ContinuationCapacity The number of in-place storage bytes for the future's continuation.
+ */
+template <typename T, std::size_t ContinuationCapacity>
+class promise final
+{
+	static_assert(false == std::is_void_v<T>, "promise requires a value type.");
+
+public:
+	using future_type = future<T, ContinuationCapacity>;
+	using pool_type = future_pool<T, ContinuationCapacity>;
+
+	promise(const promise&) = delete;
+	promise& operator=(const promise&) = delete;
+
+	/**	Constructor, allocating the result, the continuation and both halves' bookkeeping together.
+	 */
+	promise()
+		: m_state{ new state_type{ nullptr } }
+	{ }
+	/**	Constructor taking the shared state from a pool.
+	 *	@param pool The pool.
+	 */
+	explicit promise(pool_type& pool)
+		: m_state{ pool.allocate() }
+	{ }
+	/**	Move constructor.
+	 *	@param other The promise to move into this.
+	 */
+	promise(promise&& other) noexcept
+		: m_state{ std::exchange(other.m_state, nullptr) }
+		, m_future_retrieved{ other.m_future_retrieved }
+	{ }
+	/**	Destructor.
+	 *	@detail Breaks the promise if no value was set.
+	 */
+	~promise()
+	{
+		abandon();
+	}
+	/**	Move assignment.
+	 *	@param other The promise to move into this.
+	 *	@return A reference to this.
+	 */
+	promise& operator=(promise&& other) noexcept
+	{
+		if (this != &other)
+		{
+			abandon();
+			m_state = std::exchange(other.m_state, nullptr);
+			m_future_retrieved = other.m_future_retrieved;
+		}
+		return *this;
+	}
+
+	/**	Retrieve the future. May be called only once.
+	 *	@return The future.
+	 */
+	future_type get_future() noexcept
+	{
+		assert(m_state != nullptr && false == m_future_retrieved);
+		m_future_retrieved = true;
+		return future_type{ m_state };
+	}
+	/**	Set the value, calling the future's continuation on this thread if already attached.
+	 *	@param args The arguments from which to construct the value.
+	 *	@tparam ValueArgs The types of args.
+	 */
+	template <typename... ValueArgs>
+	void set_value(ValueArgs&&... args)
+	{
+		assert(m_state != nullptr);
+		new(&m_state->m_value) T(std::forward<ValueArgs>(args)...);
+		state_type* const state = std::exchange(m_state, nullptr);
+		struct release_guard final
+		{
+			~release_guard()
+			{
+				m_state->release();
+			}
+			state_type* const m_state;
+		} guard{ state };
+		if (false == m_future_retrieved)
+		{
+			// Nothing can observe the value.
+			state->m_references.fetch_sub(1, std::memory_order_relaxed);
+		}
+		state->publish(state_type::value_flag);
+	}
+
+private:
+	using state_type = detail::future_state<T, ContinuationCapacity>;
+
+	void abandon() noexcept
+	{
+		if (m_state == nullptr)
+		{
+			return;
+		}
+		if (false == m_future_retrieved)
+		{
+			m_state->release();
+		}
+		else
+		{
+			m_state->m_flags.fetch_or(state_type::broken_flag, std::memory_order_acq_rel);
+#if defined(__cpp_lib_atomic_wait)
+			m_state->m_flags.notify_all();
+#endif
+		}
+		m_state->release();
+		m_state = nullptr;
+	}
+
+	state_type* m_state{ nullptr };
+	bool m_future_retrieved{ false };
+};
+
+/**	The consuming half of a single-value channel.
+ *	@detail The value is either taken by get or passed to a continuation
+ *	attached with then, which runs on whichever thread completes the pair:
+ *	the promise's thread if attached first, otherwise the attaching thread.
+ *	@tparam T The value type.
+ *	@tparam ContinuationCapacity The number of in-place storage bytes for the continuation.
+ */
+template <typename T, std::size_t ContinuationCapacity>
+class future final
+{
+public:
+	future(const future&) = delete;
+	future& operator=(const future&) = delete;
+
+	/**	Default constructor, for a future with no state.
+	 */
+	future() noexcept = default;
+	/**	Move constructor.
+	 *	@param other The future to move into this.
+	 */
+	future(future&& other) noexcept
+		: m_state{ std::exchange(other.m_state, nullptr) }
+	{ }
+	/**	Destructor.
+	 *	@detail Discards the value, if any, without waiting.
+	 */
+	~future()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->release();
+		}
+	}
+	/**	Move assignment.
+	 *	@param other The future to move into this.
+	 *	@return A reference to this.
+	 */
+	future& operator=(future&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_state != nullptr)
+			{
+				m_state->release();
+			}
+			m_state = std::exchange(other.m_state, nullptr);
+		}
+		return *this;
+	}
+
+	/**	Test if this still refers to a shared state.
+	 *	@return True if get or then may be called.
+	 */
+	bool valid() const noexcept
+	{
+		return m_state != nullptr;
+	}
+	/**	Test if the value has been set.
+	 *	@return True if get would not wait.
+	 */
+	bool is_ready() const noexcept
+	{
+		assert(m_state != nullptr);
+		return (m_state->m_flags.load(std::memory_order_acquire) & state_type::value_flag) != 0;
+	}
+	/**	Wait for the value and take it.
+	 *	@detail Waits with std::atomic::wait where available and otherwise by
+	 *	yielding, so prefer then where the wait may be long. Throws
+	 *	broken_promise if the promise was destroyed without a value.
+	 *	Afterwards, this is not valid.
+	 *	@return The value.
+	 */
+	T get()
+	{
+		assert(m_state != nullptr);
+		state_type* const state = std::exchange(m_state, nullptr);
+		struct release_guard final
+		{
+			~release_guard()
+			{
+				m_state->release();
+			}
+			state_type* const m_state;
+		} guard{ state };
+		if ((state->wait() & state_type::value_flag) == 0)
+		{
+			throw broken_promise{};
+		}
+		return std::move(state->value());
+	}
+	/**	Attach a continuation to be called with the value once set.
+	 *	@detail The continuation is stored in-place within the shared state.
+	 *	If the promise breaks, it is destroyed without being called.
+	 *	Afterwards, this is not valid.
+	 *	@param callable An invocable taking T&&.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable>
+	void then(Callable&& callable)
+	{
+		assert(m_state != nullptr);
+		state_type* const state = std::exchange(m_state, nullptr);
+		struct release_guard final
+		{
+			~release_guard()
+			{
+				m_state->release();
+			}
+			state_type* const m_state;
+		} guard{ state };
+		state->m_continuation = std::forward<Callable>(callable);
+		state->publish(state_type::continuation_flag);
+	}
+
+private:
+	using state_type = detail::future_state<T, ContinuationCapacity>;
+	friend class promise<T, ContinuationCapacity>;
+
+	explicit future(state_type* const state) noexcept
+		: m_state{ state }
+	{ }
+
+	state_type* m_state{ nullptr };
+};
+
+} // namespace sh
+
+#endif
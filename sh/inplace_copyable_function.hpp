@@ -194,6 +194,7 @@ namespace detail
 			static_assert(NoExcept == false || std::is_nothrow_invocable_r_v<result_type, Callable, Args...>, "inplace_copyable_function requires nothrow invocable.");
 			using callable_type = std::decay_t<Callable>;
 			static_assert(sizeof(callable_type) <= Capacity, "Callable too large for Capacity");
+			static_assert(alignof(callable_type) <= Alignment, "Callable too aligned for Alignment");
 			m_vtable = &callable_vtable<callable_type>();
 			new(&m_storage) callable_type{ std::forward<Callable>(callable) };
 		}
@@ -247,6 +248,7 @@ namespace detail
 			static_assert(NoExcept == false || std::is_nothrow_invocable_r_v<result_type, Callable, Args...>, "inplace_copyable_function requires nothrow invocable.");
 			using callable_type = std::decay_t<Callable>;
 			static_assert(sizeof(callable_type) <= Capacity, "Callable too large for Capacity");
+			static_assert(alignof(callable_type) <= Alignment, "Callable too aligned for Alignment");
 			m_vtable->m_dtor(&m_storage);
 			m_vtable = &callable_vtable<callable_type>();
 			new(&m_storage) callable_type{ std::forward<Callable>(callable) };
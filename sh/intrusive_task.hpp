@@ -0,0 +1,545 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__INTRUSIVE_TASK_HPP
+#define INC_SH__INTRUSIVE_TASK_HPP
+
+/**	@file
+ *	This file declares a task node holding its own link pointers beside an
+ *	in-place closure, and the lists, stack and queue that link such nodes
+ *	without allocating.
+ */
+
+#include "inplace_move_only_function.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace sh
+{
+
+/**	The link pointers of a node in the intrusive task containers.
+ *	@detail A node may be in at most one container at a time.
+ */
+class intrusive_task_hook
+{
+public:
+	intrusive_task_hook() noexcept = default;
+	intrusive_task_hook(const intrusive_task_hook&) = delete;
+	intrusive_task_hook& operator=(const intrusive_task_hook&) = delete;
+
+	/**	The next node. Atomic for the stack and queue; the lists access it relaxed.
+	 */
+	std::atomic<intrusive_task_hook*> m_next{ nullptr };
+	/**	The previous node, used only by intrusive_task_list.
+	 */
+	intrusive_task_hook* m_prev{ nullptr };
+};
+
+/**	Implements a task node: link pointers, a vtable pointer and an in-place closure in one object.
+ *	@detail Because a node is linked by its address, it is neither copyable
+ *	nor movable; allocate nodes from a pool, or on the stack, and reassign
+ *	their closures to reuse them. One allocation, or none, therefore covers
+ *	both the queue node and the callable.
+ *	@tparam Signature The function signature.
+ *	@tparam Capacity The number of in-place storage bytes.
+ */
+template <typename Signature, std::size_t Capacity = sizeof(void*) * 6>
+class intrusive_task final : public intrusive_task_hook
+{
+public:
+	using function_type = sh::inplace_move_only_function<Signature, Capacity>;
+	using result_type = typename function_type::result_type;
+
+	/**	Default constructor, with no closure.
+	 */
+	intrusive_task() noexcept = default;
+	/**	Constructor from a given callable.
+	 *	@param callable An invocable to wrap and call from operator().
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_constructible_v<function_type, Callable&&>
+			&& false == std::is_same_v<std::decay_t<Callable>, intrusive_task>>>
+	explicit intrusive_task(Callable&& callable)
+		: m_function{ std::forward<Callable>(callable) }
+	{ }
+
+	/**	Assign a given callable, destroying any previous closure.
+	 *	@param callable An invocable to wrap and call from operator().
+	 *	@return A reference to this.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_constructible_v<function_type, Callable&&>
+			&& false == std::is_same_v<std::decay_t<Callable>, intrusive_task>>>
+	intrusive_task& operator=(Callable&& callable) noexcept
+	{
+		m_function = std::forward<Callable>(callable);
+		return *this;
+	}
+	/**	Null assignment, destroying any closure.
+	 *	@return A reference to this.
+	 */
+	intrusive_task& operator=(const std::nullptr_t) noexcept
+	{
+		m_function = nullptr;
+		return *this;
+	}
+	/**	Invoke the closure.
+	 *	@param args The arguments to pass to the closure.
+	 *	@return The result of invoking the closure.
+	 *	@tparam OperatorArgs The arguments to forward to the closure.
+	 */
+	template <typename... OperatorArgs>
+	result_type operator()(OperatorArgs&&... args) const
+	{
+		return m_function(std::forward<OperatorArgs>(args)...);
+	}
+	/**	Test if this has a closure.
+	 *	@return True if callable via operator().
+	 */
+	explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(m_function);
+	}
+
+private:
+	function_type m_function;
+};
+
+/**	Implements a singly linked FIFO list of intrusive tasks.
+ *	@detail Not thread-safe. Does not own its nodes.
+ *	@tparam Task The intrusive_task type.
+ */
+template <typename Task>
+class intrusive_task_forward_list final
+{
+	static_assert(std::is_base_of_v<intrusive_task_hook, Task>, "Task must derive from intrusive_task_hook.");
+
+public:
+	using size_type = std::size_t;
+
+	intrusive_task_forward_list() noexcept = default;
+	intrusive_task_forward_list(const intrusive_task_forward_list&) = delete;
+	intrusive_task_forward_list& operator=(const intrusive_task_forward_list&) = delete;
+	/**	Move constructor.
+	 *	@param other The list whose nodes to take.
+	 */
+	intrusive_task_forward_list(intrusive_task_forward_list&& other) noexcept
+		: m_head{ std::exchange(other.m_head, nullptr) }
+		, m_tail{ std::exchange(other.m_tail, nullptr) }
+		, m_size{ std::exchange(other.m_size, 0) }
+	{ }
+
+	/**	Test if there are no nodes.
+	 *	@return True if empty.
+	 */
+	bool empty() const noexcept
+	{
+		return m_head == nullptr;
+	}
+	/**	The number of nodes.
+	 *	@return The node count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_size;
+	}
+	/**	The first node.
+	 *	@return The first node, or null if empty.
+	 */
+	Task* front() const noexcept
+	{
+		return static_cast<Task*>(m_head);
+	}
+	/**	Append an unlinked node.
+	 *	@param task The node.
+	 */
+	void push_back(Task& task) noexcept
+	{
+		task.m_next.store(nullptr, std::memory_order_relaxed);
+		if (m_tail == nullptr)
+		{
+			m_head = &task;
+		}
+		else
+		{
+			m_tail->m_next.store(&task, std::memory_order_relaxed);
+		}
+		m_tail = &task;
+		++m_size;
+	}
+	/**	Prepend an unlinked node.
+	 *	@param task The node.
+	 */
+	void push_front(Task& task) noexcept
+	{
+		task.m_next.store(m_head, std::memory_order_relaxed);
+		m_head = &task;
+		if (m_tail == nullptr)
+		{
+			m_tail = &task;
+		}
+		++m_size;
+	}
+	/**	Unlink the first node.
+	 *	@return The node, or null if empty.
+	 */
+	Task* pop_front() noexcept
+	{
+		intrusive_task_hook* const head = m_head;
+		if (head == nullptr)
+		{
+			return nullptr;
+		}
+		m_head = head->m_next.load(std::memory_order_relaxed);
+		if (m_head == nullptr)
+		{
+			m_tail = nullptr;
+		}
+		--m_size;
+		return static_cast<Task*>(head);
+	}
+	/**	Move all nodes of another list to the end of this in O(1).
+	 *	@param other The list to empty.
+	 */
+	void splice_back(intrusive_task_forward_list& other) noexcept
+	{
+		if (other.m_head == nullptr)
+		{
+			return;
+		}
+		if (m_tail == nullptr)
+		{
+			m_head = other.m_head;
+		}
+		else
+		{
+			m_tail->m_next.store(other.m_head, std::memory_order_relaxed);
+		}
+		m_tail = std::exchange(other.m_tail, nullptr);
+		other.m_head = nullptr;
+		m_size += std::exchange(other.m_size, 0);
+	}
+
+private:
+	intrusive_task_hook* m_head{ nullptr };
+	intrusive_task_hook* m_tail{ nullptr };
+	size_type m_size{ 0 };
+};
+
+/**	Implements a doubly linked list of intrusive tasks, with O(1) removal of any node.
+ *	@detail Not thread-safe. Does not own its nodes.
+ *	@tparam Task The intrusive_task type.
+ */
+template <typename Task>
+class intrusive_task_list final
+{
+	static_assert(std::is_base_of_v<intrusive_task_hook, Task>, "Task must derive from intrusive_task_hook.");
+
+public:
+	using size_type = std::size_t;
+
+	intrusive_task_list() noexcept = default;
+	intrusive_task_list(const intrusive_task_list&) = delete;
+	intrusive_task_list& operator=(const intrusive_task_list&) = delete;
+
+	/**	Test if there are no nodes.
+	 *	@return True if empty.
+	 */
+	bool empty() const noexcept
+	{
+		return m_head == nullptr;
+	}
+	/**	The number of nodes.
+	 *	@return The node count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_size;
+	}
+	/**	The first node.
+	 *	@return The first node, or null if empty.
+	 */
+	Task* front() const noexcept
+	{
+		return static_cast<Task*>(m_head);
+	}
+	/**	The last node.
+	 *	@return The last node, or null if empty.
+	 */
+	Task* back() const noexcept
+	{
+		return static_cast<Task*>(m_tail);
+	}
+	/**	Append an unlinked node.
+	 *	@param task The node.
+	 */
+	void push_back(Task& task) noexcept
+	{
+		task.m_prev = m_tail;
+		task.m_next.store(nullptr, std::memory_order_relaxed);
+		if (m_tail == nullptr)
+		{
+			m_head = &task;
+		}
+		else
+		{
+			m_tail->m_next.store(&task, std::memory_order_relaxed);
+		}
+		m_tail = &task;
+		++m_size;
+	}
+	/**	Prepend an unlinked node.
+	 *	@param task The node.
+	 */
+	void push_front(Task& task) noexcept
+	{
+		task.m_prev = nullptr;
+		task.m_next.store(m_head, std::memory_order_relaxed);
+		if (m_head == nullptr)
+		{
+			m_tail = &task;
+		}
+		else
+		{
+			m_head->m_prev = &task;
+		}
+		m_head = &task;
+		++m_size;
+	}
+	/**	Unlink the first node.
+	 *	@return The node, or null if empty.
+	 */
+	Task* pop_front() noexcept
+	{
+		Task* const head = front();
+		if (head != nullptr)
+		{
+			erase(*head);
+		}
+		return head;
+	}
+	/**	Unlink the last node.
+	 *	@return The node, or null if empty.
+	 */
+	Task* pop_back() noexcept
+	{
+		Task* const tail = back();
+		if (tail != nullptr)
+		{
+			erase(*tail);
+		}
+		return tail;
+	}
+	/**	Unlink a node of this list.
+	 *	@param task The node.
+	 */
+	void erase(Task& task) noexcept
+	{
+		assert(m_size != 0);
+		intrusive_task_hook* const next = task.m_next.load(std::memory_order_relaxed);
+		if (task.m_prev == nullptr)
+		{
+			assert(m_head == &task);
+			m_head = next;
+		}
+		else
+		{
+			task.m_prev->m_next.store(next, std::memory_order_relaxed);
+		}
+		if (next == nullptr)
+		{
+			assert(m_tail == &task);
+			m_tail = task.m_prev;
+		}
+		else
+		{
+			next->m_prev = task.m_prev;
+		}
+		task.m_prev = nullptr;
+		task.m_next.store(nullptr, std::memory_order_relaxed);
+		--m_size;
+	}
+
+private:
+	intrusive_task_hook* m_head{ nullptr };
+	intrusive_task_hook* m_tail{ nullptr };
+	size_type m_size{ 0 };
+};
+
+/**	Implements a lock-free Treiber stack of intrusive tasks.
+ *	@detail Any thread may push. Nodes are only removed all at once, by an
+ *	exchange, which avoids the ABA problem of popping single nodes without
+ *	tagged pointers. Does not own its nodes.
+ *	@tparam Task The intrusive_task type.
+ */
+template <typename Task>
+class intrusive_task_stack final
+{
+	static_assert(std::is_base_of_v<intrusive_task_hook, Task>, "Task must derive from intrusive_task_hook.");
+
+public:
+	intrusive_task_stack() noexcept = default;
+	intrusive_task_stack(const intrusive_task_stack&) = delete;
+	intrusive_task_stack& operator=(const intrusive_task_stack&) = delete;
+
+	/**	Test if there are no nodes.
+	 *	@return True if empty when checked.
+	 */
+	bool empty() const noexcept
+	{
+		return m_top.load(std::memory_order_relaxed) == nullptr;
+	}
+	/**	Push an unlinked node. Thread-safe.
+	 *	@param task The node.
+	 */
+	void push(Task& task) noexcept
+	{
+		intrusive_task_hook* top = m_top.load(std::memory_order_relaxed);
+		do
+		{
+			task.m_next.store(top, std::memory_order_relaxed);
+		} while (false == m_top.compare_exchange_weak(top, &task, std::memory_order_release, std::memory_order_relaxed));
+	}
+	/**	Unlink every node. Thread-safe.
+	 *	@return The nodes, oldest first.
+	 */
+	intrusive_task_forward_list<Task> pop_all() noexcept
+	{
+		intrusive_task_forward_list<Task> result;
+		intrusive_task_hook* top = m_top.exchange(nullptr, std::memory_order_acquire);
+		while (top != nullptr)
+		{
+			intrusive_task_hook* const next = top->m_next.load(std::memory_order_relaxed);
+			result.push_front(*static_cast<Task*>(top));
+			top = next;
+		}
+		return result;
+	}
+
+private:
+	std::atomic<intrusive_task_hook*> m_top{ nullptr };
+};
+
+/**	Implements a multiple-producer, single-consumer queue of intrusive tasks.
+ *	@detail The intrusive form of Vyukov's queue: a push is one exchange and
+ *	one store, wait-free, and the consumer pops without atomic
+ *	read-modify-write operations except to re-insert a hook-only stub when
+ *	taking the last node. Does not own its nodes.
+ *	@tparam Task The intrusive_task type.
+ */
+template <typename Task>
+class intrusive_task_queue final
+{
+	static_assert(std::is_base_of_v<intrusive_task_hook, Task>, "Task must derive from intrusive_task_hook.");
+
+public:
+	intrusive_task_queue() noexcept = default;
+	intrusive_task_queue(const intrusive_task_queue&) = delete;
+	intrusive_task_queue& operator=(const intrusive_task_queue&) = delete;
+
+	/**	Push an unlinked node. Thread-safe.
+	 *	@param task The node.
+	 */
+	void push(Task& task) noexcept
+	{
+		link(task);
+	}
+	/**	Consumer only. Test if there are no fully pushed nodes.
+	 *	@return True if empty when checked.
+	 */
+	bool empty() const noexcept
+	{
+		return m_head == &m_stub && m_stub.m_next.load(std::memory_order_acquire) == nullptr;
+	}
+	/**	Consumer only. Unlink the oldest node.
+	 *	@return The node, or null if none is fully pushed.
+	 */
+	Task* try_pop() noexcept
+	{
+		intrusive_task_hook* head = m_head;
+		intrusive_task_hook* next = head->m_next.load(std::memory_order_acquire);
+		if (head == &m_stub)
+		{
+			if (next == nullptr)
+			{
+				return nullptr;
+			}
+			m_head = next;
+			head = next;
+			next = next->m_next.load(std::memory_order_acquire);
+		}
+		if (next != nullptr)
+		{
+			m_head = next;
+			return static_cast<Task*>(head);
+		}
+		if (head != m_tail.load(std::memory_order_acquire))
+		{
+			// A push is between its exchange and its link.
+			return nullptr;
+		}
+		// Re-insert the stub so the last node can be unlinked.
+		link(m_stub);
+		next = head->m_next.load(std::memory_order_acquire);
+		if (next != nullptr)
+		{
+			m_head = next;
+			return static_cast<Task*>(head);
+		}
+		return nullptr;
+	}
+
+private:
+	void link(intrusive_task_hook& hook) noexcept
+	{
+		hook.m_next.store(nullptr, std::memory_order_relaxed);
+		intrusive_task_hook* const previous = m_tail.exchange(&hook, std::memory_order_acq_rel);
+		previous->m_next.store(&hook, std::memory_order_release);
+	}
+
+	/**	The most recently pushed node, possibly the stub.
+	 */
+	std::atomic<intrusive_task_hook*> m_tail{ &m_stub };
+	/**	Consumer only. The oldest node, possibly the stub.
+	 */
+	intrusive_task_hook* m_head{ &m_stub };
+	intrusive_task_hook m_stub;
+};
+
+} // namespace sh
+
+#endif
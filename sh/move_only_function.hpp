@@ -68,7 +68,7 @@ namespace detail
 		constexpr static std::size_t alignment = alignof(void*);
 
 		/**	Return true if the provided type can be stored in-place.
-		 *	@detail If the type is too large, it must be stored in externally
+		 *	@detail If the type is too large or over-aligned, it must be stored in externally
 		 *	allocated memory. If the type is not nothrow move constructible,
 		 *	move_only_function cannot assume that it's safe to move and remain
 		 *	itself nothrow movable, hence it will likewise require storaging in
@@ -77,7 +77,7 @@ namespace detail
 		template <typename Callable>
 		constexpr static bool store_inplace()
 		{
-			return sizeof(Callable) <= capacity && std::is_nothrow_move_constructible_v<Callable>;
+			return sizeof(Callable) <= capacity && alignof(Callable) <= alignment && std::is_nothrow_move_constructible_v<Callable>;
 		}
 
 		alignas(alignment) std::byte m_inplace[capacity];
@@ -0,0 +1,340 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__MPMC_FUNCTION_QUEUE_HPP
+#define INC_SH__MPMC_FUNCTION_QUEUE_HPP
+
+/**	@file
+ *	This file declares a bounded, lock-free, multi-producer, multi-consumer
+ *	queue of callables stored in-place within its slots.
+ */
+
+#include "inplace_move_only_function.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Assumed size of a cache line, used to keep producer and consumer positions apart.
+	 */
+	constexpr std::size_t mpmc_function_queue_cache_line_size = 64;
+
+	/**	Round a slot count up to a power of two no smaller than two.
+	 *	@param count The requested number of slots.
+	 *	@return The number of slots to allocate.
+	 */
+	constexpr std::size_t mpmc_function_queue_slot_count(const std::size_t count) noexcept
+	{
+		std::size_t result = 2;
+		while (result < count)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+} // namespace detail
+
+/**	Implements a bounded, lock-free, multi-producer, multi-consumer FIFO queue of callables.
+ *	@detail Each slot embeds the storage of an inplace_move_only_function.
+ *	Pushing constructs the wrapper directly in its slot and invoking calls and
+ *	destroys it there, so neither allocates nor moves the callable. Slots are
+ *	claimed using per-slot sequence numbers as described by Dmitry Vyukov.
+ *	@tparam Signature The function signature.
+ *	@tparam SlotCapacity The number of in-place storage bytes per slot.
+ *	@tparam Alignment The alignment of the in-place storage in bytes.
+ */
+template <typename Signature, std::size_t SlotCapacity, std::size_t Alignment = alignof(void*)>
+class mpmc_function_queue final
+{
+public:
+	using function_type = sh::inplace_move_only_function<Signature, SlotCapacity, Alignment>;
+	using size_type = std::size_t;
+
+	mpmc_function_queue(const mpmc_function_queue&) = delete;
+	mpmc_function_queue(mpmc_function_queue&&) = delete;
+	mpmc_function_queue& operator=(const mpmc_function_queue&) = delete;
+	mpmc_function_queue& operator=(mpmc_function_queue&&) = delete;
+
+	/**	Constructor.
+	 *	@param capacity The minimum number of queued callables. Rounded up to a power of two.
+	 */
+	explicit mpmc_function_queue(const size_type capacity)
+		: m_mask{ detail::mpmc_function_queue_slot_count(capacity) - 1 }
+		, m_slots{ std::make_unique<slot[]>(m_mask + 1) }
+	{
+		for (size_type i = 0; i <= m_mask; ++i)
+		{
+			m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	/**	Destructor.
+	 *	@detail Destroys any callables remaining in the queue without calling them.
+	 */
+	~mpmc_function_queue()
+	{
+		size_type position;
+		while (slot* const claimed = claim_pop(position))
+		{
+			claimed->function().~function_type();
+			release_pop(*claimed, position);
+		}
+	}
+
+	/**	The number of callables the queue can hold.
+	 *	@return The slot count.
+	 */
+	size_type capacity() const noexcept
+	{
+		return m_mask + 1;
+	}
+	/**	Test if the queue appears empty.
+	 *	@detail Only a snapshot when other threads are pushing or popping.
+	 *	@return True if no callables appear queued.
+	 */
+	bool empty() const noexcept
+	{
+		return m_push_position.load(std::memory_order_relaxed) == m_pop_position.load(std::memory_order_relaxed);
+	}
+
+	/**	Construct a callable at the back of the queue unless it is full.
+	 *	@detail If constructing the callable throws, its slot is published as
+	 *	null, which consumers skip, and the exception propagates.
+	 *	@param callable An invocable to wrap in the claimed slot.
+	 *	@return True if pushed or false if the queue was full.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable>
+	bool try_push(Callable&& callable)
+	{
+		size_type position;
+		slot* const claimed = claim_push(position);
+		if (claimed == nullptr)
+		{
+			return false;
+		}
+		try
+		{
+			new(&claimed->m_storage) function_type{ std::forward<Callable>(callable) };
+		}
+		catch (...)
+		{
+			new(&claimed->m_storage) function_type{ nullptr };
+			release_push(*claimed, position);
+			throw;
+		}
+		release_push(*claimed, position);
+		return true;
+	}
+	/**	Move the callable at the front of the queue into result unless the queue is empty.
+	 *	@param result The wrapper into which to move the popped callable.
+	 *	@return True if popped or false if the queue was empty.
+	 */
+	bool try_pop(function_type& result) noexcept
+	{
+		size_type position;
+		while (slot* const claimed = claim_pop(position))
+		{
+			function_type& function = claimed->function();
+			const bool valid = function != nullptr;
+			if (valid)
+			{
+				result = std::move(function);
+			}
+			function.~function_type();
+			release_pop(*claimed, position);
+			if (valid)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	/**	Call and then destroy the callable at the front of the queue, in-place, unless the queue is empty.
+	 *	@detail Any result of the call is discarded. The slot is not reused until the call returns.
+	 *	@param args The arguments to pass to the callable.
+	 *	@return True if a callable was called or false if the queue was empty.
+	 *	@tparam OperatorArgs The arguments to forward to the callable.
+	 */
+	template <typename... OperatorArgs>
+	bool try_invoke(OperatorArgs&&... args)
+	{
+		size_type position;
+		while (slot* const claimed = claim_pop(position))
+		{
+			const pop_guard guard{ *this, *claimed, position };
+			function_type& function = claimed->function();
+			if (function != nullptr)
+			{
+				function(std::forward<OperatorArgs>(args)...);
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	/**	A queue element holding its sequence number and wrapper storage.
+	 */
+	struct alignas(detail::mpmc_function_queue_cache_line_size) slot final
+	{
+		/**	The wrapper constructed between a push and pop.
+		 *	@return A reference to the wrapper.
+		 */
+		function_type& function() noexcept
+		{
+			return *std::launder(reinterpret_cast<function_type*>(&m_storage));
+		}
+
+		/**	Equal to the push position while free and one past the pop position while occupied.
+		 */
+		std::atomic<size_type> m_sequence;
+		/**	Uninitialized storage for a function_type.
+		 */
+		alignas(function_type) std::byte m_storage[sizeof(function_type)];
+	};
+
+	/**	Destroys a popped wrapper and releases its slot, even if calling throws.
+	 */
+	struct pop_guard final
+	{
+		~pop_guard()
+		{
+			m_claimed.function().~function_type();
+			m_queue.release_pop(m_claimed, m_position);
+		}
+
+		mpmc_function_queue& m_queue;
+		slot& m_claimed;
+		const size_type m_position;
+	};
+
+	/**	Claim the slot at the push position.
+	 *	@param position Set to the claimed position.
+	 *	@return The claimed slot or null if the queue is full.
+	 */
+	slot* claim_push(size_type& position) noexcept
+	{
+		position = m_push_position.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot& candidate = m_slots[position & m_mask];
+			const size_type sequence = candidate.m_sequence.load(std::memory_order_acquire);
+			const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+			if (difference == 0)
+			{
+				if (m_push_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					return &candidate;
+				}
+			}
+			else if (difference < 0)
+			{
+				return nullptr;
+			}
+			else
+			{
+				position = m_push_position.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	/**	Publish a slot claimed by claim_push to consumers.
+	 *	@param claimed The claimed slot.
+	 *	@param position The claimed position.
+	 */
+	static void release_push(slot& claimed, const size_type position) noexcept
+	{
+		claimed.m_sequence.store(position + 1, std::memory_order_release);
+	}
+	/**	Claim the slot at the pop position.
+	 *	@param position Set to the claimed position.
+	 *	@return The claimed slot or null if the queue is empty.
+	 */
+	slot* claim_pop(size_type& position) noexcept
+	{
+		position = m_pop_position.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot& candidate = m_slots[position & m_mask];
+			const size_type sequence = candidate.m_sequence.load(std::memory_order_acquire);
+			const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+			if (difference == 0)
+			{
+				if (m_pop_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					return &candidate;
+				}
+			}
+			else if (difference < 0)
+			{
+				return nullptr;
+			}
+			else
+			{
+				position = m_pop_position.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	/**	Return a slot claimed by claim_pop to producers.
+	 *	@param claimed The claimed slot, whose wrapper has been destroyed.
+	 *	@param position The claimed position.
+	 */
+	void release_pop(slot& claimed, const size_type position) noexcept
+	{
+		claimed.m_sequence.store(position + m_mask + 1, std::memory_order_release);
+	}
+
+	/**	One less than the power of two slot count.
+	 */
+	const size_type m_mask;
+	/**	The ring of slots.
+	 */
+	const std::unique_ptr<slot[]> m_slots;
+	/**	The next position to push to.
+	 */
+	alignas(detail::mpmc_function_queue_cache_line_size) std::atomic<size_type> m_push_position{ 0 };
+	/**	The next position to pop from.
+	 */
+	alignas(detail::mpmc_function_queue_cache_line_size) std::atomic<size_type> m_pop_position{ 0 };
+};
+
+} // namespace sh
+
+#endif
@@ -0,0 +1,348 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__PARALLEL_FOR_HPP
+#define INC_SH__PARALLEL_FOR_HPP
+
+/**	@file
+ *	This file declares fork-join loops over index ranges whose bodies are
+ *	passed as function_ref, scheduled upon a thread_pool or similar executor.
+ */
+
+#include "function_ref.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace sh
+{
+
+/**	How parallel_for and parallel_reduce divide a range among participating threads.
+ */
+enum class parallel_partition
+{
+	/**	Each participant takes one contiguous block of the range, split into grain-sized chunks.
+	 *	@detail Lowest overhead when iterations cost the same and threads are otherwise idle.
+	 */
+	static_blocks,
+	/**	Participants repeatedly claim chunks from a shared position, starting
+	 *	large and shrinking towards the grain as the range is consumed.
+	 *	@detail Balances uneven iterations and busy threads.
+	 */
+	adaptive,
+};
+
+namespace detail
+{
+	/**	Scheduling state shared by all participants of a parallel loop, living on the calling thread's stack.
+	 */
+	class parallel_for_schedule
+	{
+	public:
+		parallel_for_schedule(const std::size_t first, const std::size_t last, const std::size_t grain, const std::size_t participants, const parallel_partition partition) noexcept
+			: m_first{ first }
+			, m_last{ last }
+			, m_grain{ grain }
+			, m_participants{ participants }
+			, m_partition{ partition }
+			, m_next{ first }
+			, m_pending{ participants - 1 }
+		{ }
+		parallel_for_schedule(const parallel_for_schedule&) = delete;
+		parallel_for_schedule& operator=(const parallel_for_schedule&) = delete;
+
+		/**	Call chunk with each [begin, end) sub-range assigned to a participant.
+		 *	@param index The participant's index, where zero is the calling thread.
+		 *	@param chunk Called with the bounds of each sub-range.
+		 *	@tparam Chunk The type of chunk.
+		 */
+		template <typename Chunk>
+		void for_each_chunk(const std::size_t index, Chunk&& chunk) noexcept
+		{
+			if (m_partition == parallel_partition::static_blocks)
+			{
+				const std::size_t count = m_last - m_first;
+				const std::size_t block_first = m_first + count / m_participants * index + std::min(index, count % m_participants);
+				const std::size_t block_last = block_first + count / m_participants + (index < count % m_participants ? 1 : 0);
+				for (std::size_t begin = block_first; begin < block_last; begin += m_grain)
+				{
+					chunk(begin, std::min(begin + m_grain, block_last));
+				}
+				return;
+			}
+			std::size_t begin = m_next.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				if (begin >= m_last)
+				{
+					return;
+				}
+				const std::size_t size = std::max(m_grain, (m_last - begin) / (m_participants * 2));
+				const std::size_t end = m_last - begin > size ? begin + size : m_last;
+				if (m_next.compare_exchange_weak(begin, end, std::memory_order_relaxed))
+				{
+					chunk(begin, end);
+					begin = m_next.load(std::memory_order_relaxed);
+				}
+			}
+		}
+		/**	Signal that a helper participant has finished touching this.
+		 */
+		void finish_helper() noexcept
+		{
+			m_pending.fetch_sub(1, std::memory_order_release);
+		}
+		/**	Wait for all helpers to finish, executing other pending tasks meanwhile.
+		 *	@param executor The executor upon which helpers were submitted.
+		 *	@tparam Executor The executor type.
+		 */
+		template <typename Executor>
+		void join(Executor& executor) noexcept
+		{
+			while (m_pending.load(std::memory_order_acquire) != 0)
+			{
+				if (false == executor.try_run_one())
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+	private:
+		const std::size_t m_first;
+		const std::size_t m_last;
+		const std::size_t m_grain;
+		const std::size_t m_participants;
+		const parallel_partition m_partition;
+		/**	The next unclaimed index when adaptive.
+		 */
+		std::atomic<std::size_t> m_next;
+		/**	The number of helpers yet to finish.
+		 */
+		std::atomic<std::size_t> m_pending;
+	};
+
+	/**	The number of threads that should participate in a loop.
+	 *	@param first The first index.
+	 *	@param last One past the last index.
+	 *	@param grain The minimum chunk size.
+	 *	@param thread_count The executor's worker count.
+	 *	@return The number of participants, including the calling thread.
+	 */
+	constexpr std::size_t parallel_for_participants(const std::size_t first, const std::size_t last, const std::size_t grain, const std::size_t thread_count) noexcept
+	{
+		const std::size_t chunks = (last - first + grain - 1) / grain;
+		return std::min(chunks, thread_count + 1);
+	}
+
+	/**	The function_ref type of a parallel_reduce body, kept out of template argument deduction.
+	 *	@tparam T The result type.
+	 */
+	template <typename T>
+	struct parallel_reduce_body final
+	{
+		using type = sh::function_ref<T(std::size_t, std::size_t, T)>;
+	};
+	/**	The function_ref type of a parallel_reduce combination, kept out of template argument deduction.
+	 *	@tparam T The result type.
+	 */
+	template <typename T>
+	struct parallel_reduce_combine final
+	{
+		using type = sh::function_ref<T(T, T)>;
+	};
+
+	/**	Run a parallel loop, submitting one helper task per additional participant.
+	 *	@detail A participant whose helper the executor fails to submit runs on
+	 *	the calling thread instead, so every participant has run before this returns.
+	 *	@param executor The executor upon which to submit helpers.
+	 *	@param schedule The loop's schedule.
+	 *	@param participants The number of participants.
+	 *	@param participate Called with each participant's index.
+	 *	@tparam Executor The executor type.
+	 *	@tparam Participate The type of participate.
+	 */
+	template <typename Executor, typename Participate>
+	void parallel_for_run(Executor& executor, parallel_for_schedule& schedule, const std::size_t participants, Participate& participate) noexcept
+	{
+		for (std::size_t index = 1; index < participants; ++index)
+		{
+			try
+			{
+				// Captures two words, so fits any task storage without allocating.
+				executor.submit([&participate, index]()
+				{
+					participate(index);
+				});
+			}
+			catch (...)
+			{
+				participate(index);
+			}
+		}
+		participate(0);
+		schedule.join(executor);
+	}
+} // namespace detail
+
+/**	The executor used by parallel_for and parallel_reduce when none is given.
+ *	@return A reference to a static thread_pool with one thread per hardware thread.
+ */
+inline thread_pool<>& default_parallel_executor()
+{
+	static thread_pool<> instance;
+	return instance;
+}
+
+/**	Call body with sub-ranges that together cover [first, last) exactly once, in parallel.
+ *	@detail The calling thread participates and, while waiting for the other
+ *	participants, executes other pending tasks, so this may be nested within
+ *	bodies or tasks on the same executor. Nothing is allocated and body is
+ *	only reached through the single function_ref call per chunk. Body must
+ *	not throw.
+ *	@param executor The executor. Requires thread_count(), submit(callable) and try_run_one().
+ *	@param first The first index.
+ *	@param last One past the last index.
+ *	@param grain The minimum number of indices per call to body, which must be non-zero.
+ *	@param body Called with the [begin, end) bounds of each sub-range.
+ *	@param partition How to divide the range among threads.
+ *	@tparam Executor The executor type, such as thread_pool.
+ */
+template <typename Executor>
+void parallel_for(Executor& executor, const std::size_t first, const std::size_t last, const std::size_t grain,
+	const sh::function_ref<void(std::size_t, std::size_t)> body, const parallel_partition partition = parallel_partition::adaptive)
+{
+	assert(grain > 0);
+	if (first >= last)
+	{
+		return;
+	}
+	const std::size_t participants = detail::parallel_for_participants(first, last, grain, executor.thread_count());
+	if (participants <= 1)
+	{
+		body(first, last);
+		return;
+	}
+	detail::parallel_for_schedule schedule{ first, last, grain, participants, partition };
+	auto participate = [&schedule, &body](const std::size_t index) noexcept
+	{
+		schedule.for_each_chunk(index, body);
+		if (index != 0)
+		{
+			schedule.finish_helper();
+		}
+	};
+	detail::parallel_for_run(executor, schedule, participants, participate);
+}
+/**	Call body with sub-ranges that together cover [first, last) exactly once, in parallel on default_parallel_executor.
+ *	@see parallel_for
+ */
+inline void parallel_for(const std::size_t first, const std::size_t last, const std::size_t grain,
+	const sh::function_ref<void(std::size_t, std::size_t)> body, const parallel_partition partition = parallel_partition::adaptive)
+{
+	parallel_for(default_parallel_executor(), first, last, grain, body, partition);
+}
+
+/**	Reduce [first, last) in parallel.
+ *	@detail Each participant folds its sub-ranges into its own partial result,
+ *	starting from identity, by calling body with the sub-range's bounds and
+ *	the partial result so far. Partial results are then folded together with
+ *	combine in an unspecified order, so combine must be associative and
+ *	commutative. Nothing is allocated. Neither body nor combine may throw.
+ *	@param executor The executor. Requires thread_count(), submit(callable) and try_run_one().
+ *	@param first The first index.
+ *	@param last One past the last index.
+ *	@param grain The minimum number of indices per call to body, which must be non-zero.
+ *	@param identity The initial value of each partial result.
+ *	@param body Returns the partial result after folding in the [begin, end) sub-range.
+ *	@param combine Returns the combination of two partial results.
+ *	@param partition How to divide the range among threads.
+ *	@return The reduction.
+ *	@tparam Executor The executor type, such as thread_pool.
+ *	@tparam T The result type.
+ */
+template <typename Executor, typename T>
+T parallel_reduce(Executor& executor, const std::size_t first, const std::size_t last, const std::size_t grain, T identity,
+	const typename detail::parallel_reduce_body<T>::type body, const typename detail::parallel_reduce_combine<T>::type combine,
+	const parallel_partition partition = parallel_partition::adaptive)
+{
+	assert(grain > 0);
+	if (first >= last)
+	{
+		return identity;
+	}
+	const std::size_t participants = detail::parallel_for_participants(first, last, grain, executor.thread_count());
+	if (participants <= 1)
+	{
+		return body(first, last, std::move(identity));
+	}
+	detail::parallel_for_schedule schedule{ first, last, grain, participants, partition };
+	std::mutex mutex;
+	T result = identity;
+	auto participate = [&schedule, &body, &combine, &mutex, &result, &identity](const std::size_t index) noexcept
+	{
+		T partial = identity;
+		schedule.for_each_chunk(index, [&body, &partial](const std::size_t begin, const std::size_t end)
+		{
+			partial = body(begin, end, std::move(partial));
+		});
+		{
+			const std::lock_guard<std::mutex> lock{ mutex };
+			result = combine(std::move(result), std::move(partial));
+		}
+		if (index != 0)
+		{
+			schedule.finish_helper();
+		}
+	};
+	detail::parallel_for_run(executor, schedule, participants, participate);
+	return result;
+}
+/**	Reduce [first, last) in parallel on default_parallel_executor.
+ *	@see parallel_reduce
+ */
+template <typename T>
+T parallel_reduce(const std::size_t first, const std::size_t last, const std::size_t grain, T identity,
+	const typename detail::parallel_reduce_body<T>::type body, const typename detail::parallel_reduce_combine<T>::type combine,
+	const parallel_partition partition = parallel_partition::adaptive)
+{
+	return parallel_reduce(default_parallel_executor(), first, last, grain, std::move(identity), body, combine, partition);
+}
+
+} // namespace sh
+
+#endif
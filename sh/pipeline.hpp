@@ -0,0 +1,547 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__PIPELINE_HPP
+#define INC_SH__PIPELINE_HPP
+
+/**	@file
+ *	This file declares a bounded, multi-stage pipeline that passes batches of
+ *	items between stages wrapped in move_only_function.
+ */
+
+#include "move_only_function.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<span>)
+#	include <span>
+#endif
+
+namespace sh
+{
+
+#if defined(__cpp_lib_span)
+/**	A view of a contiguous batch of pipeline items.
+ *	@tparam T The item type.
+ */
+template <typename T>
+using pipeline_span = std::span<T>;
+#else
+/**	A view of a contiguous batch of pipeline items, standing in for std::span prior to C++20.
+ *	@tparam T The item type.
+ */
+template <typename T>
+class pipeline_span final
+{
+public:
+	using element_type = T;
+	using size_type = std::size_t;
+	using iterator = T*;
+
+	constexpr pipeline_span() noexcept = default;
+	constexpr pipeline_span(T* const data, const size_type size) noexcept
+		: m_data{ data }
+		, m_size{ size }
+	{ }
+
+	constexpr T* data() const noexcept
+	{
+		return m_data;
+	}
+	constexpr size_type size() const noexcept
+	{
+		return m_size;
+	}
+	constexpr bool empty() const noexcept
+	{
+		return m_size == 0;
+	}
+	constexpr T& operator[](const size_type index) const noexcept
+	{
+		assert(index < m_size);
+		return m_data[index];
+	}
+	constexpr iterator begin() const noexcept
+	{
+		return m_data;
+	}
+	constexpr iterator end() const noexcept
+	{
+		return m_data + m_size;
+	}
+
+private:
+	T* m_data{ nullptr };
+	size_type m_size{ 0 };
+};
+#endif
+
+/**	How a pipeline stage's threads take batches.
+ */
+enum class pipeline_mode
+{
+	/**	One thread processes batches in the order they were pushed.
+	 */
+	serial,
+	/**	Several threads process batches concurrently. The stage's function must be safe to call concurrently.
+	 */
+	parallel,
+};
+
+/**	A snapshot of a pipeline stage's counters.
+ */
+struct pipeline_statistics final
+{
+	/**	The number of items processed.
+	 */
+	std::uint64_t items{ 0 };
+	/**	The number of batches processed.
+	 */
+	std::uint64_t batches{ 0 };
+	/**	Total time spent within the stage's function, summed across its threads.
+	 */
+	std::chrono::nanoseconds busy{ 0 };
+	/**	The number of batches waiting for the stage.
+	 */
+	std::size_t queue_depth{ 0 };
+	/**	The largest number of batches that have waited for the stage at once.
+	 */
+	std::size_t max_queue_depth{ 0 };
+
+	/**	Items processed per second of busy time.
+	 *	@return The throughput, or zero if nothing was processed.
+	 */
+	double items_per_second() const noexcept
+	{
+		return busy.count() > 0 ? static_cast<double>(items) * 1e9 / static_cast<double>(busy.count()) : 0.0;
+	}
+};
+
+namespace detail
+{
+	/**	A batch of items and its position in the pipeline's input order.
+	 *	@tparam T The item type.
+	 */
+	template <typename T>
+	struct pipeline_batch final
+	{
+		std::vector<T> m_items;
+		std::uint64_t m_sequence{ 0 };
+	};
+
+	/**	A bounded queue of batches that releases them in sequence order.
+	 *	@detail Batch n occupies slot n modulo the capacity, so a batch pushed
+	 *	ahead of its predecessors waits for space rather than overtaking them.
+	 *	This restores input order after a parallel stage.
+	 *	@tparam T The item type.
+	 */
+	template <typename T>
+	class pipeline_queue final
+	{
+	public:
+		explicit pipeline_queue(const std::size_t capacity)
+			: m_slots(capacity, nullptr)
+		{ }
+		pipeline_queue(const pipeline_queue&) = delete;
+		pipeline_queue& operator=(const pipeline_queue&) = delete;
+
+		/**	Insert a batch, waiting while too far ahead of the next batch to pop.
+		 *	@param batch The batch.
+		 */
+		void push(pipeline_batch<T>* const batch)
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_not_full.wait(lock, [this, batch]() { return batch->m_sequence < m_head + m_slots.size(); });
+			m_slots[batch->m_sequence % m_slots.size()] = batch;
+			++m_depth;
+			if (m_depth > m_max_depth)
+			{
+				m_max_depth = m_depth;
+			}
+			if (batch->m_sequence == m_head)
+			{
+				m_not_empty.notify_all();
+			}
+		}
+		/**	Remove the next batch in sequence, waiting until it arrives.
+		 *	@return The batch or null once the sequence given to close is reached.
+		 */
+		pipeline_batch<T>* pop()
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_not_empty.wait(lock, [this]() { return m_head == m_end || m_slots[m_head % m_slots.size()] != nullptr; });
+			if (m_head == m_end)
+			{
+				return nullptr;
+			}
+			pipeline_batch<T>* const batch = std::exchange(m_slots[m_head % m_slots.size()], nullptr);
+			++m_head;
+			--m_depth;
+			m_not_full.notify_all();
+			if (m_slots[m_head % m_slots.size()] != nullptr || m_head == m_end)
+			{
+				m_not_empty.notify_one();
+			}
+			return batch;
+		}
+		/**	Signal that no batch with sequence at or beyond end will be pushed.
+		 *	@param end The number of batches pushed in total.
+		 */
+		void close(const std::uint64_t end)
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			m_end = end;
+			m_not_empty.notify_all();
+		}
+		/**	The current and maximum number of waiting batches.
+		 *	@param depth Set to the current depth.
+		 *	@param max_depth Set to the maximum depth.
+		 */
+		void depth(std::size_t& depth, std::size_t& max_depth) const
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			depth = m_depth;
+			max_depth = m_max_depth;
+		}
+
+	private:
+		mutable std::mutex m_mutex;
+		std::condition_variable m_not_empty;
+		std::condition_variable m_not_full;
+		std::vector<pipeline_batch<T>*> m_slots;
+		std::uint64_t m_head{ 0 };
+		std::uint64_t m_end{ std::numeric_limits<std::uint64_t>::max() };
+		std::size_t m_depth{ 0 };
+		std::size_t m_max_depth{ 0 };
+	};
+
+	/**	A bounded stack of empty batches, limiting the number of batches in flight.
+	 *	@tparam T The item type.
+	 */
+	template <typename T>
+	class pipeline_pool final
+	{
+	public:
+		pipeline_pool() = default;
+		pipeline_pool(const pipeline_pool&) = delete;
+		pipeline_pool& operator=(const pipeline_pool&) = delete;
+
+		void push(pipeline_batch<T>* const batch)
+		{
+			{
+				const std::lock_guard<std::mutex> lock{ m_mutex };
+				m_batches.push_back(batch);
+			}
+			m_available.notify_one();
+		}
+		pipeline_batch<T>* pop()
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_available.wait(lock, [this]() { return false == m_batches.empty(); });
+			pipeline_batch<T>* const batch = m_batches.back();
+			m_batches.pop_back();
+			return batch;
+		}
+		void reserve(const std::size_t count)
+		{
+			m_batches.reserve(count);
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_available;
+		std::vector<pipeline_batch<T>*> m_batches;
+	};
+} // namespace detail
+
+/**	Implements a bounded pipeline of stages, each running on its own threads.
+ *	@detail Items pushed by a single producer thread are gathered into
+ *	batches, and each stage is called once per batch, so synchronization
+ *	between stages is amortized over the batch size. Queues between stages
+ *	hold a bounded number of batches, and the producer waits for a batch to
+ *	be recycled by the last stage once all are in flight, providing
+ *	backpressure. Batches leave every stage in the order they were pushed.
+ *	Stage functions must not throw.
+ *	@tparam T The item type, which each stage may modify in place.
+ */
+template <typename T>
+class pipeline final
+{
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using span_type = pipeline_span<T>;
+	using batch_function = sh::move_only_function<void(span_type)>;
+
+	pipeline(const pipeline&) = delete;
+	pipeline(pipeline&&) = delete;
+	pipeline& operator=(const pipeline&) = delete;
+	pipeline& operator=(pipeline&&) = delete;
+
+	/**	Constructor.
+	 *	@param batch_size The number of items per batch.
+	 *	@param queue_capacity The number of batches each stage's queue may hold.
+	 */
+	explicit pipeline(const size_type batch_size = 64, const size_type queue_capacity = 4)
+		: m_batch_size{ batch_size }
+		, m_queue_capacity{ queue_capacity }
+	{
+		assert(batch_size > 0 && queue_capacity > 0);
+	}
+	/**	Destructor.
+	 *	@detail Closes the pipeline if started and not yet closed.
+	 */
+	~pipeline()
+	{
+		close();
+	}
+
+	/**	Append a stage. Must be called before start.
+	 *	@param callable Called with each batch as a pipeline_span, or with each item by reference.
+	 *	@param mode Whether the stage processes one batch at a time, in order, or several concurrently.
+	 *	@param thread_count The number of threads for a parallel stage. Ignored if serial.
+	 *	@return A reference to this.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable>
+	pipeline& add_stage(Callable&& callable, const pipeline_mode mode = pipeline_mode::serial, const size_type thread_count = 1)
+	{
+		assert(m_threads.empty());
+		using callable_type = std::decay_t<Callable>;
+		std::unique_ptr<stage> added;
+		if constexpr (std::is_invocable_v<callable_type&, span_type>)
+		{
+			added = std::make_unique<stage>(batch_function{ std::forward<Callable>(callable) });
+		}
+		else
+		{
+			static_assert(std::is_invocable_v<callable_type&, T&>, "Stage must be invocable with a pipeline_span or an item.");
+			added = std::make_unique<stage>(batch_function{ [item_function = callable_type{ std::forward<Callable>(callable) }](const span_type batch) mutable
+			{
+				for (T& item : batch)
+				{
+					item_function(item);
+				}
+			} });
+		}
+		added->m_thread_count = mode == pipeline_mode::parallel ? std::max<size_type>(1, thread_count) : 1;
+		m_stages.push_back(std::move(added));
+		return *this;
+	}
+	/**	The number of stages.
+	 *	@return The stage count.
+	 */
+	size_type stage_count() const noexcept
+	{
+		return m_stages.size();
+	}
+
+	/**	Allocate batches and start every stage's threads.
+	 */
+	void start()
+	{
+		assert(m_threads.empty() && false == m_stages.empty());
+		size_type thread_total = 0;
+		for (const std::unique_ptr<stage>& each : m_stages)
+		{
+			each->m_queue = std::make_unique<detail::pipeline_queue<T>>(m_queue_capacity);
+			thread_total += each->m_thread_count;
+		}
+		const size_type batch_count = m_queue_capacity * m_stages.size() + thread_total + 1;
+		m_batches.reserve(batch_count);
+		m_free.reserve(batch_count);
+		for (size_type i = 0; i < batch_count; ++i)
+		{
+			m_batches.push_back(std::make_unique<detail::pipeline_batch<T>>());
+			m_batches.back()->m_items.reserve(m_batch_size);
+			m_free.push(m_batches.back().get());
+		}
+		for (size_type i = 0; i < m_stages.size(); ++i)
+		{
+			m_stages[i]->m_running.store(m_stages[i]->m_thread_count, std::memory_order_relaxed);
+			for (size_type t = 0; t < m_stages[i]->m_thread_count; ++t)
+			{
+				m_threads.emplace_back([this, i]() { run(i); });
+			}
+		}
+	}
+	/**	Producer only. Append an item, handing off the current batch once full.
+	 *	@detail Waits while every batch is in flight.
+	 *	@param item The item.
+	 *	@tparam Item The type of the given item.
+	 */
+	template <typename Item>
+	void push(Item&& item)
+	{
+		assert(false == m_threads.empty() && false == m_closed);
+		if (m_current == nullptr)
+		{
+			m_current = m_free.pop();
+		}
+		m_current->m_items.push_back(std::forward<Item>(item));
+		if (m_current->m_items.size() == m_batch_size)
+		{
+			flush();
+		}
+	}
+	/**	Producer only. Hand off the current batch even if not full.
+	 */
+	void flush()
+	{
+		if (m_current != nullptr)
+		{
+			m_current->m_sequence = m_sequence++;
+			m_stages.front()->m_queue->push(std::exchange(m_current, nullptr));
+		}
+	}
+	/**	Producer only. Flush, wait for every stage to finish all batches and join its threads.
+	 */
+	void close()
+	{
+		if (m_threads.empty() || m_closed)
+		{
+			return;
+		}
+		flush();
+		m_closed = true;
+		m_stages.front()->m_queue->close(m_sequence);
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	/**	A snapshot of a stage's counters.
+	 *	@param index The stage's index, in order of addition.
+	 *	@return The stage's statistics.
+	 */
+	pipeline_statistics statistics(const size_type index) const
+	{
+		const stage& each = *m_stages[index];
+		pipeline_statistics result;
+		result.items = each.m_items.load(std::memory_order_relaxed);
+		result.batches = each.m_batch_count.load(std::memory_order_relaxed);
+		result.busy = std::chrono::nanoseconds{ each.m_busy.load(std::memory_order_relaxed) };
+		if (each.m_queue != nullptr)
+		{
+			each.m_queue->depth(result.queue_depth, result.max_queue_depth);
+		}
+		return result;
+	}
+
+private:
+	/**	A stage's function, input queue and counters.
+	 */
+	struct stage final
+	{
+		explicit stage(batch_function&& function)
+			: m_function{ std::move(function) }
+		{ }
+
+		batch_function m_function;
+		size_type m_thread_count{ 1 };
+		std::unique_ptr<detail::pipeline_queue<T>> m_queue;
+		/**	The number of this stage's threads yet to exit.
+		 */
+		std::atomic<size_type> m_running{ 0 };
+		std::atomic<std::uint64_t> m_items{ 0 };
+		std::atomic<std::uint64_t> m_batch_count{ 0 };
+		std::atomic<std::int64_t> m_busy{ 0 };
+	};
+
+	/**	The main loop of a stage thread.
+	 *	@param index The stage's index.
+	 */
+	void run(const size_type index)
+	{
+		stage& current = *m_stages[index];
+		stage* const next = index + 1 < m_stages.size() ? m_stages[index + 1].get() : nullptr;
+		while (detail::pipeline_batch<T>* const batch = current.m_queue->pop())
+		{
+			const auto start = std::chrono::steady_clock::now();
+			current.m_function(span_type{ batch->m_items.data(), batch->m_items.size() });
+			const auto busy = std::chrono::steady_clock::now() - start;
+			current.m_busy.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(), std::memory_order_relaxed);
+			current.m_items.fetch_add(batch->m_items.size(), std::memory_order_relaxed);
+			current.m_batch_count.fetch_add(1, std::memory_order_relaxed);
+			if (next != nullptr)
+			{
+				next->m_queue->push(batch);
+			}
+			else
+			{
+				batch->m_items.clear();
+				m_free.push(batch);
+			}
+		}
+		if (current.m_running.fetch_sub(1, std::memory_order_acq_rel) == 1 && next != nullptr)
+		{
+			next->m_queue->close(m_sequence);
+		}
+	}
+
+	const size_type m_batch_size;
+	const size_type m_queue_capacity;
+	std::vector<std::unique_ptr<stage>> m_stages;
+	/**	Owns every batch.
+	 */
+	std::vector<std::unique_ptr<detail::pipeline_batch<T>>> m_batches;
+	/**	Batches not in flight.
+	 */
+	detail::pipeline_pool<T> m_free;
+	std::vector<std::thread> m_threads;
+	/**	Producer only. The batch being filled.
+	 */
+	detail::pipeline_batch<T>* m_current{ nullptr };
+	/**	Producer only. The sequence number of the next batch. Read by stage threads only after close.
+	 */
+	std::uint64_t m_sequence{ 0 };
+	/**	Producer only. True once closed.
+	 */
+	bool m_closed{ false };
+};
+
+} // namespace sh
+
+#endif
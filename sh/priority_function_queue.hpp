@@ -0,0 +1,395 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__PRIORITY_FUNCTION_QUEUE_HPP
+#define INC_SH__PRIORITY_FUNCTION_QUEUE_HPP
+
+/**	@file
+ *	This file declares a priority queue of functions whose closures stay
+ *	in-place in a slab while only compact keys are ordered.
+ */
+
+#include "inplace_move_only_function.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Find the most significant set bit.
+	 *	@param value A non-zero value.
+	 *	@return The index of its most significant set bit.
+	 */
+	inline unsigned priority_highest_bit(const std::uint64_t value) noexcept
+	{
+		assert(value != 0);
+#if defined(_MSC_VER)
+		unsigned long index = 0;
+		_BitScanReverse64(&index, value);
+		return static_cast<unsigned>(index);
+#else
+		return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+	}
+} // namespace detail
+
+/**	Implements a priority queue of functions, stored in-place, that calls higher priorities first and equal priorities in the order pushed.
+ *	@detail Closures are constructed once into nodes of fixed-size chunks
+ *	that never move and are recycled through a free list; only the node
+ *	indices are ordered. With no buckets, a binary heap orders 16-byte
+ *	(priority, sequence, index) entries, so sifting never moves a closure.
+ *	With buckets, each priority below Buckets has a FIFO list linked through
+ *	the nodes and a two-level bitmap of non-empty lists finds the highest in
+ *	two bit scans, so pushing and popping are O(1). Once warmed, neither
+ *	mode allocates. Not thread-safe.
+ *	@tparam Signature The function signature.
+ *	@tparam Capacity The number of in-place storage bytes per closure.
+ *	@tparam Buckets Zero to order by heap, or the number of distinct priorities, at most 4096, to order by bucket.
+ */
+template <typename Signature, std::size_t Capacity = sizeof(void*) * 6, std::size_t Buckets = 0>
+class priority_function_queue final
+{
+	static_assert(Buckets <= 4096, "priority_function_queue supports at most 4096 buckets.");
+
+public:
+	using function_type = sh::inplace_move_only_function<Signature, Capacity>;
+	using priority_type = std::uint32_t;
+	using size_type = std::size_t;
+
+	priority_function_queue(const priority_function_queue&) = delete;
+	priority_function_queue(priority_function_queue&&) = delete;
+	priority_function_queue& operator=(const priority_function_queue&) = delete;
+	priority_function_queue& operator=(priority_function_queue&&) = delete;
+
+	/**	Constructor.
+	 *	@param capacity The number of functions for which to reserve space.
+	 */
+	explicit priority_function_queue(const size_type capacity = 0)
+	{
+		m_heads.fill(npos);
+		m_tails.fill(npos);
+		reserve(capacity);
+	}
+	/**	Destructor.
+	 *	@detail Destroys pending functions without calling them.
+	 */
+	~priority_function_queue() = default;
+
+	/**	Reserve space so that pushing up to the given number of functions does not allocate.
+	 *	@param capacity The number of functions.
+	 */
+	void reserve(const size_type capacity)
+	{
+		while (m_chunks.size() * chunk_size < capacity)
+		{
+			add_chunk();
+		}
+		if constexpr (Buckets == 0)
+		{
+			m_heap.reserve(capacity);
+		}
+	}
+	/**	The number of pending functions.
+	 *	@return The pending function count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_size;
+	}
+	/**	Test if there are no pending functions.
+	 *	@return True if nothing is pending.
+	 */
+	bool empty() const noexcept
+	{
+		return m_size == 0;
+	}
+	/**	The priority of the function that would be popped next.
+	 *	@detail Requires that this is not empty.
+	 *	@return The highest pending priority.
+	 */
+	priority_type top_priority() const noexcept
+	{
+		assert(false == empty());
+		if constexpr (Buckets == 0)
+		{
+			return m_heap.front().m_priority;
+		}
+		else
+		{
+			return highest_bucket();
+		}
+	}
+
+	/**	Push a function.
+	 *	@detail With buckets, throws std::out_of_range if the priority is not
+	 *	less than Buckets, leaving the queue unchanged; a clamped priority
+	 *	would silently reorder it.
+	 *	@param priority The priority, less than Buckets if non-zero.
+	 *	@param callable An invocable to wrap.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_constructible_v<function_type, Callable&&>>>
+	void push(const priority_type priority, Callable&& callable)
+	{
+		if constexpr (Buckets != 0)
+		{
+			if (priority >= Buckets)
+			{
+				throw std::out_of_range{ "priority_function_queue priority exceeds its buckets" };
+			}
+		}
+		if (m_free == npos)
+		{
+			add_chunk();
+		}
+		if constexpr (Buckets == 0)
+		{
+			m_heap.reserve(m_size + 1);
+		}
+		const std::uint32_t index = m_free;
+		node& pushed = at(index);
+		pushed.m_function = std::forward<Callable>(callable);
+		m_free = pushed.m_next;
+		pushed.m_next = npos;
+		if constexpr (Buckets == 0)
+		{
+			m_heap.push_back(heap_entry{ priority, index, m_sequence++ });
+			std::push_heap(m_heap.begin(), m_heap.end(), heap_after{});
+		}
+		else
+		{
+			if (m_heads[priority] == npos)
+			{
+				m_heads[priority] = index;
+				m_words[priority >> 6] |= std::uint64_t{ 1 } << (priority & 63);
+				m_summary |= std::uint64_t{ 1 } << (priority >> 6);
+			}
+			else
+			{
+				at(m_tails[priority]).m_next = index;
+			}
+			m_tails[priority] = index;
+		}
+		++m_size;
+	}
+	/**	Move the highest priority function out.
+	 *	@param destination The function to which to move it.
+	 *	@return True if a function was popped, or false if empty.
+	 */
+	bool try_pop(function_type& destination) noexcept
+	{
+		if (empty())
+		{
+			return false;
+		}
+		const std::uint32_t index = pop_index();
+		destination = std::move(at(index).m_function);
+		release(index);
+		return true;
+	}
+	/**	Call, then destroy, the highest priority function in-place.
+	 *	@detail The function may push others. It is removed before being
+	 *	called and destroyed even if it throws.
+	 *	@param args The arguments to pass to it.
+	 *	@return True if a function was called, or false if empty.
+	 *	@tparam OperatorArgs The types of the given arguments.
+	 */
+	template <typename... OperatorArgs>
+	bool run_one(OperatorArgs&&... args)
+	{
+		if (empty())
+		{
+			return false;
+		}
+		struct release_guard final
+		{
+			~release_guard()
+			{
+				m_queue.release(m_index);
+			}
+
+			priority_function_queue& m_queue;
+			const std::uint32_t m_index;
+		} guard{ *this, pop_index() };
+		at(guard.m_index).m_function(std::forward<OperatorArgs>(args)...);
+		return true;
+	}
+	/**	Destroy all pending functions without calling them.
+	 */
+	void clear() noexcept
+	{
+		while (false == empty())
+		{
+			release(pop_index());
+		}
+	}
+
+private:
+	static constexpr std::uint32_t npos = ~std::uint32_t{ 0 };
+	static constexpr unsigned chunk_bits = 10;
+	static constexpr std::size_t chunk_size = std::size_t{ 1 } << chunk_bits;
+	static constexpr std::size_t word_count = (Buckets + 63) / 64;
+
+	/**	A closure and the next node of its bucket or of the free list.
+	 */
+	struct node final
+	{
+		function_type m_function;
+		std::uint32_t m_next{ npos };
+	};
+	/**	A heap-ordered reference to a node.
+	 */
+	struct heap_entry final
+	{
+		priority_type m_priority;
+		std::uint32_t m_index;
+		std::uint64_t m_sequence;
+	};
+	/**	Orders heap entries so that the front is the highest priority, and the earliest among equals.
+	 */
+	struct heap_after final
+	{
+		bool operator()(const heap_entry& lhs, const heap_entry& rhs) const noexcept
+		{
+			return lhs.m_priority != rhs.m_priority ? lhs.m_priority < rhs.m_priority : lhs.m_sequence > rhs.m_sequence;
+		}
+	};
+
+	node& at(const std::uint32_t index) noexcept
+	{
+		return m_chunks[index >> chunk_bits][index & (chunk_size - 1)];
+	}
+	/**	Allocate another chunk of nodes and push them onto the free list.
+	 */
+	void add_chunk()
+	{
+		assert(m_chunks.size() < (npos >> chunk_bits));
+		m_chunks.push_back(std::make_unique<node[]>(chunk_size));
+		const std::uint32_t first = static_cast<std::uint32_t>((m_chunks.size() - 1) * chunk_size);
+		for (std::uint32_t i = static_cast<std::uint32_t>(chunk_size); i-- > 0; )
+		{
+			at(first + i).m_next = m_free;
+			m_free = first + i;
+		}
+	}
+	/**	The highest non-empty bucket.
+	 *	@return Its priority.
+	 */
+	priority_type highest_bucket() const noexcept
+	{
+		const unsigned word = detail::priority_highest_bit(m_summary);
+		return static_cast<priority_type>((word << 6) | detail::priority_highest_bit(m_words[word]));
+	}
+	/**	Remove the highest priority node from the ordering.
+	 *	@detail Requires that this is not empty.
+	 *	@return The node's index.
+	 */
+	std::uint32_t pop_index() noexcept
+	{
+		assert(false == empty());
+		--m_size;
+		if constexpr (Buckets == 0)
+		{
+			std::pop_heap(m_heap.begin(), m_heap.end(), heap_after{});
+			const std::uint32_t index = m_heap.back().m_index;
+			m_heap.pop_back();
+			return index;
+		}
+		else
+		{
+			const priority_type priority = highest_bucket();
+			const std::uint32_t index = m_heads[priority];
+			m_heads[priority] = at(index).m_next;
+			if (m_heads[priority] == npos)
+			{
+				m_tails[priority] = npos;
+				m_words[priority >> 6] &= ~(std::uint64_t{ 1 } << (priority & 63));
+				if (m_words[priority >> 6] == 0)
+				{
+					m_summary &= ~(std::uint64_t{ 1 } << (priority >> 6));
+				}
+			}
+			return index;
+		}
+	}
+	/**	Destroy a node's closure and return it to the free list.
+	 *	@param index The node's index, already removed from the ordering.
+	 */
+	void release(const std::uint32_t index) noexcept
+	{
+		node& released = at(index);
+		released.m_function = nullptr;
+		released.m_next = m_free;
+		m_free = index;
+	}
+
+	/**	Fixed-size arrays of nodes, addressed by index.
+	 */
+	std::vector<std::unique_ptr<node[]>> m_chunks;
+	/**	The head of the free list, linked through m_next.
+	 */
+	std::uint32_t m_free{ npos };
+	size_type m_size{ 0 };
+	/**	The heap of pending nodes, if ordering by heap.
+	 */
+	std::vector<heap_entry> m_heap;
+	/**	The order in which the next function was pushed, if ordering by heap.
+	 */
+	std::uint64_t m_sequence{ 0 };
+	/**	The first and last node of each bucket, if ordering by bucket.
+	 */
+	std::array<std::uint32_t, Buckets> m_heads;
+	std::array<std::uint32_t, Buckets> m_tails;
+	/**	A bit per non-empty bucket, and a bit per non-zero word of those.
+	 */
+	std::array<std::uint64_t, word_count> m_words{};
+	std::uint64_t m_summary{ 0 };
+};
+
+} // namespace sh
+
+#endif
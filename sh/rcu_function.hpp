@@ -0,0 +1,527 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__RCU_FUNCTION_HPP
+#define INC_SH__RCU_FUNCTION_HPP
+
+/**	@file
+ *	This file declares an owning function wrapper that may be atomically
+ *	replaced while other threads call it, reclaiming replaced callables via
+ *	epoch-based reclamation.
+ */
+
+#include "copyable_function.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Assumed size of a cache line, used to keep reader records from sharing lines.
+	 */
+	constexpr std::size_t rcu_function_cache_line_size = 64;
+
+	/**	Per-thread reader record observed by rcu_function writers.
+	 */
+	struct alignas(rcu_function_cache_line_size) rcu_function_reader final
+	{
+		/**	The domain epoch observed upon entering the outermost read-side section, or zero if quiescent.
+		 */
+		std::atomic<std::uint64_t> m_epoch{ 0 };
+		/**	True while owned by a thread.
+		 */
+		std::atomic<bool> m_in_use{ false };
+		/**	Read-side section nesting depth. Only accessed by the owning thread.
+		 */
+		std::uint32_t m_depth{ 0 };
+		/**	The next record in the domain's list. Immutable once published.
+		 */
+		rcu_function_reader* m_next{ nullptr };
+	};
+
+	/**	The epoch and set of reader records shared by all rcu_function objects.
+	 */
+	class rcu_function_domain final
+	{
+	public:
+		rcu_function_domain(const rcu_function_domain&) = delete;
+		rcu_function_domain(rcu_function_domain&&) = delete;
+		rcu_function_domain& operator=(const rcu_function_domain&) = delete;
+		rcu_function_domain& operator=(rcu_function_domain&&) = delete;
+
+		/**	Destructor.
+		 *	@detail Frees all reader records, which must no longer be in use.
+		 */
+		~rcu_function_domain()
+		{
+			rcu_function_reader* reader = m_readers.load(std::memory_order_acquire);
+			while (reader != nullptr)
+			{
+				delete std::exchange(reader, reader->m_next);
+			}
+		}
+
+		/**	The process-wide domain.
+		 *	@return A reference to a static domain.
+		 */
+		static rcu_function_domain& instance() noexcept
+		{
+			static rcu_function_domain instance;
+			return instance;
+		}
+
+		/**	Claim a reader record for the calling thread, reusing one released by an exited thread if possible.
+		 *	@return A reference to a reader record owned by the caller until passed to release_reader.
+		 */
+		rcu_function_reader& acquire_reader()
+		{
+			for (rcu_function_reader* reader = m_readers.load(std::memory_order_acquire); reader != nullptr; reader = reader->m_next)
+			{
+				bool in_use = false;
+				if (reader->m_in_use.load(std::memory_order_relaxed) == false
+					&& reader->m_in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+				{
+					return *reader;
+				}
+			}
+			rcu_function_reader* const reader = new rcu_function_reader{};
+			reader->m_in_use.store(true, std::memory_order_relaxed);
+			reader->m_next = m_readers.load(std::memory_order_relaxed);
+			while (false == m_readers.compare_exchange_weak(reader->m_next, reader, std::memory_order_release, std::memory_order_relaxed))
+			{ }
+			return *reader;
+		}
+		/**	Return a reader record claimed by acquire_reader.
+		 *	@param reader The record, which must be outside of any read-side section.
+		 */
+		void release_reader(rcu_function_reader& reader) noexcept
+		{
+			assert(reader.m_depth == 0);
+			reader.m_epoch.store(0, std::memory_order_release);
+			reader.m_in_use.store(false, std::memory_order_release);
+		}
+
+		/**	Enter a read-side section on the given reader.
+		 *	@detail Only the outermost section publishes an epoch. The fence
+		 *	orders that publication before the caller's subsequent load of the
+		 *	protected pointer, pairing with the fence in min_active_epoch.
+		 *	@param reader The calling thread's reader record.
+		 */
+		void enter(rcu_function_reader& reader) noexcept
+		{
+			if (reader.m_depth++ == 0)
+			{
+				reader.m_epoch.store(m_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+		/**	Leave a read-side section on the given reader.
+		 *	@param reader The calling thread's reader record.
+		 */
+		void leave(rcu_function_reader& reader) noexcept
+		{
+			assert(reader.m_depth > 0);
+			if (--reader.m_depth == 0)
+			{
+				reader.m_epoch.store(0, std::memory_order_release);
+			}
+		}
+
+		/**	Advance the domain epoch, to be called after unpublishing a pointer.
+		 *	@return The epoch with which to tag the unpublished pointer.
+		 */
+		std::uint64_t advance() noexcept
+		{
+			return m_epoch.fetch_add(1, std::memory_order_seq_cst);
+		}
+		/**	Find the oldest epoch still observed by any reader.
+		 *	@detail Anything tagged by advance with a value below the result is
+		 *	no longer reachable by any reader.
+		 *	@return The minimum non-zero reader epoch or the maximum std::uint64_t value if all are quiescent.
+		 */
+		std::uint64_t min_active_epoch() const noexcept
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::uint64_t result = std::numeric_limits<std::uint64_t>::max();
+			for (const rcu_function_reader* reader = m_readers.load(std::memory_order_acquire); reader != nullptr; reader = reader->m_next)
+			{
+				const std::uint64_t epoch = reader->m_epoch.load(std::memory_order_acquire);
+				if (epoch != 0 && epoch < result)
+				{
+					result = epoch;
+				}
+			}
+			return result;
+		}
+
+	private:
+		rcu_function_domain() noexcept = default;
+
+		/**	The current epoch. Starts at one as a reader epoch of zero means quiescent.
+		 */
+		std::atomic<std::uint64_t> m_epoch{ 1 };
+		/**	A push-only list of reader records.
+		 */
+		std::atomic<rcu_function_reader*> m_readers{ nullptr };
+	};
+
+	/**	Owns a thread's reader record for the lifetime of that thread.
+	 */
+	struct rcu_function_reader_handle final
+	{
+		rcu_function_reader_handle()
+			: m_reader{ rcu_function_domain::instance().acquire_reader() }
+		{ }
+		~rcu_function_reader_handle()
+		{
+			rcu_function_domain::instance().release_reader(m_reader);
+		}
+		rcu_function_reader_handle(const rcu_function_reader_handle&) = delete;
+		rcu_function_reader_handle& operator=(const rcu_function_reader_handle&) = delete;
+
+		rcu_function_reader& m_reader;
+	};
+
+	/**	The calling thread's reader record, claimed on first use.
+	 *	@return A reference to the calling thread's reader record.
+	 */
+	inline rcu_function_reader& rcu_function_local_reader()
+	{
+		thread_local rcu_function_reader_handle handle;
+		return handle.m_reader;
+	}
+
+	/**	Scoped read-side section.
+	 */
+	class rcu_function_read_guard final
+	{
+	public:
+		rcu_function_read_guard()
+			: m_reader{ rcu_function_local_reader() }
+		{
+			rcu_function_domain::instance().enter(m_reader);
+		}
+		~rcu_function_read_guard()
+		{
+			rcu_function_domain::instance().leave(m_reader);
+		}
+		rcu_function_read_guard(const rcu_function_read_guard&) = delete;
+		rcu_function_read_guard& operator=(const rcu_function_read_guard&) = delete;
+
+	private:
+		rcu_function_reader& m_reader;
+	};
+
+	/**	Implements a nullable, owning wrapper of an invocable that may be replaced while being called.
+	 *	@note Required as MSVC does not support deduction of function signature noexcept in template specialization.
+	 *	@tparam NoExcept True if this wraps a nothrow invocable and false otherwise.
+	 *	@tparam ResultType The result of invoking this.
+	 *	@tparam Args The arguments necessary to invoking this.
+	 */
+	template <bool NoExcept, typename ResultType, typename... Args>
+	class rcu_function
+	{
+	public:
+		using result_type = ResultType;
+		using function_type = detail::copyable_function<NoExcept, ResultType, Args...>;
+
+		rcu_function(const rcu_function&) = delete;
+		rcu_function(rcu_function&&) = delete;
+		rcu_function& operator=(const rcu_function&) = delete;
+		rcu_function& operator=(rcu_function&&) = delete;
+
+		/**	Default constructor.
+		 *	@detail calling results in undefined behavior.
+		 */
+		rcu_function() noexcept
+			: m_current{ nullptr }
+		{ }
+		/**	Null constructor.
+		 *	@detail calling results in undefined behavior.
+		 */
+		rcu_function(const std::nullptr_t) noexcept
+			: m_current{ nullptr }
+		{ }
+		/**	Constructor from a given callable.
+		 *	@param callable An invocable to wrap and call from operator().
+		 *	@tparam Callable The type of the given invocable target.
+		 */
+		template <typename Callable,
+			typename = std::enable_if_t<
+				std::is_invocable_r_v<result_type, Callable, Args...>
+				&& false == std::is_base_of_v<rcu_function, std::decay_t<Callable>>
+			>
+		>
+		rcu_function(Callable&& callable)
+			: m_current{ new node{ std::forward<Callable>(callable) } }
+		{ }
+		/**	Destructor.
+		 *	@detail No thread may be calling this during destruction.
+		 */
+		~rcu_function()
+		{
+			delete m_current.load(std::memory_order_acquire);
+			delete_nodes(m_retired);
+		}
+
+		/**	Publish a given callable as the wrapped invocable.
+		 *	@detail Calls already in progress continue with the previous
+		 *	invocable, which is destroyed by a later store or reclaim once
+		 *	those calls have returned.
+		 *	@param callable An invocable to wrap and call from operator().
+		 *	@return A reference to this.
+		 *	@tparam Callable The type of the given invocable target.
+		 */
+		template <typename Callable,
+			typename = std::enable_if_t<
+				std::is_invocable_r_v<result_type, Callable, Args...>
+				&& false == std::is_base_of_v<rcu_function, std::decay_t<Callable>>
+			>
+		>
+		rcu_function& operator=(Callable&& callable)
+		{
+			store(std::forward<Callable>(callable));
+			return *this;
+		}
+		/**	Null assignment.
+		 *	@detail Afterwards, calling results in undefined behavior.
+		 */
+		rcu_function& operator=(const std::nullptr_t)
+		{
+			store(nullptr);
+			return *this;
+		}
+		/**	Publish a given callable as the wrapped invocable.
+		 *	@see operator=
+		 *	@param callable An invocable to wrap and call from operator().
+		 *	@tparam Callable The type of the given invocable target.
+		 */
+		template <typename Callable,
+			typename = std::enable_if_t<
+				std::is_invocable_r_v<result_type, Callable, Args...>
+				&& false == std::is_base_of_v<rcu_function, std::decay_t<Callable>>
+			>
+		>
+		void store(Callable&& callable)
+		{
+			publish(new node{ std::forward<Callable>(callable) });
+		}
+		/**	Publish null as the wrapped invocable.
+		 *	@detail Afterwards, calling results in undefined behavior.
+		 */
+		void store(const std::nullptr_t)
+		{
+			publish(nullptr);
+		}
+
+		/**	Invoke the wrapped callable without locking.
+		 *	@detail If this rcu_function is null, undefined behavior will result.
+		 *	The invocable called remains alive until this returns, even if
+		 *	concurrently replaced.
+		 *	@param args The arguments to pass to the wrapped callable.
+		 *	@tparam OperatorArgs The arguments to forward to the wrapped callable.
+		 *	@return The result of invoking the wrapped callable with args.
+		 */
+		template <typename... OperatorArgs>
+		ResultType operator()(OperatorArgs&&... args) const noexcept(NoExcept)
+		{
+			const detail::rcu_function_read_guard guard;
+			const node* const current = m_current.load(std::memory_order_acquire);
+			assert(current != nullptr);
+			return current->m_function(std::forward<OperatorArgs>(args)...);
+		}
+		/**	Test if this is callable.
+		 *	@return True if this is non-null and callable via operator().
+		 */
+		explicit operator bool() const noexcept
+		{
+			return m_current.load(std::memory_order_acquire) != nullptr;
+		}
+		/**	Test if this is null.
+		 *	@detail True if this is null and calling operator() will result in undefined behavior.
+		 */
+		bool operator==(std::nullptr_t) const noexcept
+		{
+			return m_current.load(std::memory_order_acquire) == nullptr;
+		}
+		/**	Test if this is non-null.
+		 *	@return True if this is non-null and callable via operator().
+		 */
+		bool operator!=(std::nullptr_t) const noexcept
+		{
+			return m_current.load(std::memory_order_acquire) != nullptr;
+		}
+
+		/**	Destroy replaced invocables that no call can still be using.
+		 *	@return True if no replaced invocables remain.
+		 */
+		bool reclaim()
+		{
+			node* reclaimed = nullptr;
+			bool done;
+			{
+				const std::lock_guard<std::mutex> lock{ m_mutex };
+				const std::uint64_t min_active = detail::rcu_function_domain::instance().min_active_epoch();
+				node** link = &m_retired;
+				while (*link != nullptr)
+				{
+					node* const retired = *link;
+					if (retired->m_epoch < min_active)
+					{
+						*link = retired->m_next;
+						retired->m_next = reclaimed;
+						reclaimed = retired;
+					}
+					else
+					{
+						link = &retired->m_next;
+					}
+				}
+				done = m_retired == nullptr;
+			}
+			delete_nodes(reclaimed);
+			return done;
+		}
+		/**	Block until every replaced invocable has been destroyed.
+		 *	@detail Must not be called from within a call to any rcu_function, as it would wait upon itself.
+		 */
+		void synchronize()
+		{
+			while (false == reclaim())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+	private:
+		/**	A published invocable and its retirement bookkeeping.
+		 */
+		struct node final
+		{
+			template <typename Callable>
+			explicit node(Callable&& callable)
+				: m_function{ std::forward<Callable>(callable) }
+			{ }
+
+			/**	The wrapped invocable.
+			 */
+			function_type m_function;
+			/**	The next retired node.
+			 */
+			node* m_next{ nullptr };
+			/**	The domain epoch at which this was unpublished.
+			 */
+			std::uint64_t m_epoch{ 0 };
+		};
+
+		/**	Replace the current node, retiring the previous one.
+		 *	@param replacement The node to publish, or null.
+		 */
+		void publish(node* const replacement)
+		{
+			node* const previous = m_current.exchange(replacement, std::memory_order_seq_cst);
+			if (previous != nullptr)
+			{
+				const std::lock_guard<std::mutex> lock{ m_mutex };
+				previous->m_epoch = detail::rcu_function_domain::instance().advance();
+				previous->m_next = m_retired;
+				m_retired = previous;
+			}
+			reclaim();
+		}
+
+		/**	Delete a list of nodes.
+		 *	@param list The head of the list.
+		 */
+		static void delete_nodes(node* list) noexcept
+		{
+			while (list != nullptr)
+			{
+				delete std::exchange(list, list->m_next);
+			}
+		}
+
+		/**	The published invocable, if any.
+		 */
+		std::atomic<node*> m_current;
+		/**	Serializes writers' access to m_retired.
+		 */
+		std::mutex m_mutex;
+		/**	Unpublished nodes that may still be in use by readers.
+		 */
+		node* m_retired{ nullptr };
+	};
+
+} // namespace detail
+
+/**	Implements a nullable, owning wrapper of an invocable that may be replaced while being called.
+ *	@tparam Signature The function signature.
+ */
+template <typename Signature>
+class rcu_function;
+
+/**	Implements a nullable, owning wrapper of an invocable that may be replaced while being called.
+ *	@tparam ResultType The result of calling this.
+ *	@tparam Args The arguments necessary to call this.
+ */
+template <typename ResultType, typename... Args>
+class rcu_function <ResultType(Args...)> : public detail::rcu_function<false, ResultType, Args...>
+{
+public:
+	using detail::rcu_function<false, ResultType, Args...>::rcu_function;
+	using detail::rcu_function<false, ResultType, Args...>::operator=;
+};
+
+/**	Implements a nullable, owning wrapper of a nothrow invocable that may be replaced while being called.
+ *	@tparam ResultType The result of calling this.
+ *	@tparam Args The arguments necessary to call this.
+ */
+template <typename ResultType, typename... Args>
+class rcu_function <ResultType(Args...) noexcept> : public detail::rcu_function<true, ResultType, Args...>
+{
+public:
+	using detail::rcu_function<true, ResultType, Args...>::rcu_function;
+	using detail::rcu_function<true, ResultType, Args...>::operator=;
+};
+
+} // namespace sh
+
+#endif
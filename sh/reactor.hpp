@@ -0,0 +1,437 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__REACTOR_HPP
+#define INC_SH__REACTOR_HPP
+
+/**	@file
+ *	This file declares a Linux epoll reactor that dispatches readiness to
+ *	callbacks stored in-place, with cross-thread posting of closures.
+ */
+
+#if defined(__linux__)
+
+#include "inplace_move_only_function.hpp"
+#include "mpmc_function_queue.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace sh
+{
+
+/**	Implements a single-threaded epoll event loop.
+ *	@detail Each registered file descriptor owns a slot holding its callback
+ *	in-place. The slot's index and generation are stored in the epoll event's
+ *	data, so dispatch finds the callback without a lookup and ignores events
+ *	for registrations removed earlier in the same batch. Slots live in
+ *	fixed-size chunks that never move and are recycled through a free list.
+ *	Other threads may post closures, which are queued in-place in a bounded
+ *	lock-free queue and signalled through an eventfd, writing it only when
+ *	no wakeup is already pending. Only post and stop are thread-safe; every
+ *	other member must be called from the thread running the loop.
+ *	@tparam CallbackCapacity The number of in-place storage bytes per callback and per posted closure.
+ */
+template <std::size_t CallbackCapacity = sizeof(void*) * 6>
+class reactor final
+{
+public:
+	using callback_type = sh::inplace_move_only_function<void(std::uint32_t), CallbackCapacity>;
+	using task_type = sh::inplace_move_only_function<void(), CallbackCapacity>;
+	using size_type = std::size_t;
+
+	/**	Identifies a registered file descriptor. Becomes stale once removed.
+	 */
+	struct handle final
+	{
+		std::uint32_t m_index{ 0 };
+		/**	Zero for a handle that never identified a registration.
+		 */
+		std::uint32_t m_generation{ 0 };
+
+		constexpr bool operator==(const handle& other) const noexcept
+		{
+			return m_index == other.m_index && m_generation == other.m_generation;
+		}
+		constexpr bool operator!=(const handle& other) const noexcept
+		{
+			return false == (*this == other);
+		}
+	};
+
+	reactor(const reactor&) = delete;
+	reactor(reactor&&) = delete;
+	reactor& operator=(const reactor&) = delete;
+	reactor& operator=(reactor&&) = delete;
+
+	/**	Constructor.
+	 *	@detail Throws std::system_error if the epoll or eventfd descriptors cannot be created.
+	 *	@param post_capacity The number of posted closures that may be queued at once.
+	 *	@param batch_size The maximum number of events taken per epoll_wait.
+	 */
+	explicit reactor(const size_type post_capacity = 1024, const size_type batch_size = 256)
+		: m_events(batch_size > 0 ? batch_size : 1)
+		, m_posted{ post_capacity }
+	{
+		m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		if (m_epoll < 0)
+		{
+			throw std::system_error{ errno, std::generic_category(), "epoll_create1" };
+		}
+		m_wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (m_wakeup < 0)
+		{
+			const int error = errno;
+			::close(m_epoll);
+			throw std::system_error{ error, std::generic_category(), "eventfd" };
+		}
+		::epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u64 = wakeup_data;
+		if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event) != 0)
+		{
+			const int error = errno;
+			::close(m_wakeup);
+			::close(m_epoll);
+			throw std::system_error{ error, std::generic_category(), "epoll_ctl" };
+		}
+	}
+	/**	Destructor.
+	 *	@detail Destroys registered callbacks and queued closures without
+	 *	calling them. Registered descriptors are not closed.
+	 */
+	~reactor()
+	{
+		::close(m_wakeup);
+		::close(m_epoll);
+	}
+
+	/**	Register a file descriptor.
+	 *	@detail Throws std::system_error if epoll_ctl fails.
+	 *	@param fd The file descriptor, which must remain open until removed.
+	 *	@param events The epoll event mask, such as EPOLLIN | EPOLLET.
+	 *	@param callable An invocable to wrap and call with the ready event mask.
+	 *	@return A handle for modifying or removing the registration.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_invocable_v<std::decay_t<Callable>&, std::uint32_t>>>
+	handle add(const int fd, const std::uint32_t events, Callable&& callable)
+	{
+		if (m_free == npos)
+		{
+			add_chunk();
+		}
+		const std::uint32_t index = m_free;
+		slot& added = at(index);
+		::epoll_event event{};
+		event.events = events;
+		event.data.u64 = data(index, added.m_generation);
+		if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+		{
+			throw std::system_error{ errno, std::generic_category(), "epoll_ctl" };
+		}
+		m_free = added.m_next;
+		added.m_callback = std::forward<Callable>(callable);
+		added.m_fd = fd;
+		++m_size;
+		return handle{ index, added.m_generation };
+	}
+	/**	Change the events of interest for a registration.
+	 *	@param registration The registration's handle.
+	 *	@param events The epoll event mask.
+	 *	@return True if modified, or false if the handle is stale or epoll_ctl fails.
+	 */
+	bool modify(const handle registration, const std::uint32_t events) noexcept
+	{
+		if (false == valid(registration))
+		{
+			return false;
+		}
+		::epoll_event event{};
+		event.events = events;
+		event.data.u64 = data(registration.m_index, registration.m_generation);
+		return ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, at(registration.m_index).m_fd, &event) == 0;
+	}
+	/**	Unregister a file descriptor and destroy its callback.
+	 *	@detail A callback may remove its own registration, in which case it is destroyed once it returns.
+	 *	@param registration The registration's handle.
+	 *	@return True if removed, or false if the handle is stale.
+	 */
+	bool remove(const handle registration) noexcept
+	{
+		if (false == valid(registration))
+		{
+			return false;
+		}
+		slot& removed = at(registration.m_index);
+		// Fails harmlessly if the descriptor was already closed, which also unregisters it.
+		::epoll_ctl(m_epoll, EPOLL_CTL_DEL, removed.m_fd, nullptr);
+		removed.m_fd = -1;
+		if (++removed.m_generation == 0)
+		{
+			removed.m_generation = 1;
+		}
+		--m_size;
+		if (registration.m_index != m_dispatching)
+		{
+			release(registration.m_index);
+		}
+		return true;
+	}
+	/**	The number of registered file descriptors.
+	 *	@return The registration count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_size;
+	}
+
+	/**	Thread-safe. Queue a closure to be called on the loop's thread.
+	 *	@param callable An invocable to wrap and call once.
+	 *	@return True if queued, or false if the queue is full.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_invocable_v<std::decay_t<Callable>&>>>
+	bool post(Callable&& callable)
+	{
+		if (false == m_posted.try_push(std::forward<Callable>(callable)))
+		{
+			return false;
+		}
+		wake();
+		return true;
+	}
+	/**	Thread-safe. Make run return once its current batch completes.
+	 */
+	void stop() noexcept
+	{
+		m_stop.store(true, std::memory_order_release);
+		m_wake_pending.store(true, std::memory_order_release);
+		signal();
+	}
+
+	/**	Wait for and dispatch one batch of events, then call any posted closures.
+	 *	@detail Callbacks may add, modify and remove registrations, including
+	 *	their own, and post closures. Exceptions thrown by callbacks propagate
+	 *	and discard the rest of the batch.
+	 *	@param timeout_ms The longest time to wait in milliseconds, zero not to wait, or -1 to wait indefinitely.
+	 *	@return The number of callbacks and closures called.
+	 */
+	size_type run_once(const int timeout_ms = -1)
+	{
+		assert(m_dispatching == npos);
+		const int count = ::epoll_wait(m_epoll, m_events.data(), static_cast<int>(m_events.size()), timeout_ms);
+		size_type called = 0;
+		bool woken = false;
+		for (int i = 0; i < count; ++i)
+		{
+			const std::uint64_t event_data = m_events[i].data.u64;
+			if (event_data == wakeup_data)
+			{
+				woken = true;
+				continue;
+			}
+			const std::uint32_t index = static_cast<std::uint32_t>(event_data);
+			if (at(index).m_generation != static_cast<std::uint32_t>(event_data >> 32))
+			{
+				// Removed earlier in this batch.
+				continue;
+			}
+			m_dispatching = index;
+			struct finish_guard final
+			{
+				~finish_guard()
+				{
+					m_reactor.m_dispatching = npos;
+					if (m_reactor.at(m_index).m_generation != m_generation)
+					{
+						m_reactor.release(m_index);
+					}
+				}
+
+				reactor& m_reactor;
+				const std::uint32_t m_index;
+				const std::uint32_t m_generation;
+			} guard{ *this, index, at(index).m_generation };
+			at(index).m_callback(std::uint32_t{ m_events[i].events });
+			++called;
+		}
+		if (woken)
+		{
+			std::uint64_t value;
+			while (::read(m_wakeup, &value, sizeof(value)) < 0 && errno == EINTR)
+			{ }
+			// Pairs with the exchange in wake, so closures pushed before a skipped signal are seen below.
+			m_wake_pending.exchange(false, std::memory_order_acq_rel);
+		}
+		// Bounded so that closures posting closures cannot starve the descriptors.
+		for (size_type i = 0; i < m_posted.capacity(); ++i)
+		{
+			if (false == m_posted.try_invoke())
+			{
+				return called;
+			}
+			++called;
+		}
+		wake();
+		return called;
+	}
+	/**	Dispatch batches until stop is called.
+	 *	@return The number of callbacks and closures called.
+	 */
+	size_type run()
+	{
+		size_type called = 0;
+		while (false == m_stop.exchange(false, std::memory_order_acq_rel))
+		{
+			called += run_once(-1);
+		}
+		return called;
+	}
+
+private:
+	static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+	/**	The epoll data identifying the eventfd, which no slot can produce as its generation is never zero.
+	 */
+	static constexpr std::uint64_t wakeup_data = 0;
+	static constexpr unsigned chunk_bits = 8;
+	static constexpr std::size_t chunk_size = std::size_t{ 1 } << chunk_bits;
+
+	/**	A registration's callback and descriptor.
+	 */
+	struct slot final
+	{
+		callback_type m_callback;
+		int m_fd{ -1 };
+		/**	The next free slot while free.
+		 */
+		std::uint32_t m_next{ npos };
+		std::uint32_t m_generation{ 1 };
+	};
+
+	static constexpr std::uint64_t data(const std::uint32_t index, const std::uint32_t generation) noexcept
+	{
+		return (std::uint64_t{ generation } << 32) | index;
+	}
+	slot& at(const std::uint32_t index) noexcept
+	{
+		return m_chunks[index >> chunk_bits][index & (chunk_size - 1)];
+	}
+	const slot& at(const std::uint32_t index) const noexcept
+	{
+		return m_chunks[index >> chunk_bits][index & (chunk_size - 1)];
+	}
+	bool valid(const handle registration) const noexcept
+	{
+		return registration.m_generation != 0 && registration.m_index < m_chunks.size() * chunk_size
+			&& at(registration.m_index).m_generation == registration.m_generation && at(registration.m_index).m_fd >= 0;
+	}
+	/**	Allocate another chunk of slots and push them onto the free list.
+	 */
+	void add_chunk()
+	{
+		m_chunks.push_back(std::make_unique<slot[]>(chunk_size));
+		const std::uint32_t first = static_cast<std::uint32_t>((m_chunks.size() - 1) * chunk_size);
+		for (std::uint32_t i = static_cast<std::uint32_t>(chunk_size); i-- > 0; )
+		{
+			at(first + i).m_next = m_free;
+			m_free = first + i;
+		}
+	}
+	/**	Destroy a removed slot's callback and return it to the free list.
+	 */
+	void release(const std::uint32_t index) noexcept
+	{
+		slot& released = at(index);
+		released.m_callback = nullptr;
+		released.m_next = m_free;
+		m_free = index;
+	}
+	/**	Signal the eventfd unless a wakeup is already pending.
+	 */
+	void wake() noexcept
+	{
+		if (false == m_wake_pending.exchange(true, std::memory_order_acq_rel))
+		{
+			signal();
+		}
+	}
+	void signal() noexcept
+	{
+		const std::uint64_t value = 1;
+		while (::write(m_wakeup, &value, sizeof(value)) < 0 && errno == EINTR)
+		{ }
+	}
+
+	int m_epoll{ -1 };
+	int m_wakeup{ -1 };
+	/**	Fixed-size arrays of slots, addressed by index.
+	 */
+	std::vector<std::unique_ptr<slot[]>> m_chunks;
+	/**	The head of the free list, linked through m_next.
+	 */
+	std::uint32_t m_free{ npos };
+	/**	The slot whose callback is running, if any.
+	 */
+	std::uint32_t m_dispatching{ npos };
+	size_type m_size{ 0 };
+	/**	The buffer filled by epoll_wait.
+	 */
+	std::vector<::epoll_event> m_events;
+	/**	Closures posted from any thread.
+	 */
+	sh::mpmc_function_queue<void(), CallbackCapacity> m_posted;
+	/**	True once the eventfd has been signalled and not yet drained.
+	 */
+	std::atomic<bool> m_wake_pending{ false };
+	std::atomic<bool> m_stop{ false };
+};
+
+} // namespace sh
+
+#endif
+
+#endif
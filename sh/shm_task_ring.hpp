@@ -0,0 +1,620 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__SHM_TASK_RING_HPP
+#define INC_SH__SHM_TASK_RING_HPP
+
+/**	@file
+ *	This file declares a ring of calls to registered functions, held in
+ *	shared memory so that producers and a consumer may be separate processes.
+ */
+
+#if defined(__linux__)
+
+#include "function_registry.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sh
+{
+
+/**	The producer protocol of a shm_task_ring.
+ */
+enum class shm_task_ring_producers : std::uint32_t
+{
+	/**	One producer at a time, which claims slots with plain stores.
+	 */
+	single = 1,
+	/**	Any number of producers, which claim slots by compare-and-swap.
+	 */
+	multiple = 2
+};
+
+namespace detail
+{
+	static_assert(std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free,
+		"shm_task_ring requires address-free lock-free atomics.");
+
+	/**	Assumed size of a cache line, used to keep producer and consumer state apart.
+	 */
+	constexpr std::size_t shm_task_ring_cache_line_size = 64;
+
+	/**	The layout at the start of a shm_task_ring mapping, followed by its slots.
+	 */
+	struct shm_task_ring_header final
+	{
+		static constexpr std::uint32_t magic = 0x52545348u;
+
+		std::uint32_t m_magic;
+		shm_task_ring_producers m_producers;
+		std::uint32_t m_slot_count;
+		std::uint32_t m_slot_size;
+		/**	Set once no more records will be pushed.
+		 */
+		std::atomic<std::uint32_t> m_closed;
+		/**	Set while the consumer may be blocked on m_signal.
+		 */
+		std::atomic<std::uint32_t> m_waiting;
+		/**	The futex word, bumped to wake the consumer.
+		 */
+		std::atomic<std::uint32_t> m_signal;
+		/**	The position of the next slot to claim.
+		 */
+		alignas(shm_task_ring_cache_line_size) std::atomic<std::uint64_t> m_tail;
+		/**	The position of the next slot to consume, only accessed by the consumer.
+		 */
+		alignas(shm_task_ring_cache_line_size) std::uint64_t m_head;
+	};
+
+	/**	The layout at the start of each slot, followed by the argument's bytes.
+	 */
+	struct shm_task_ring_record final
+	{
+		/**	Equal to the slot's position when free, or one past it once published.
+		 */
+		std::atomic<std::uint64_t> m_sequence;
+		function_registry::id_type m_id;
+		std::uint32_t m_size;
+	};
+
+	/**	Wait on a futex word shared between processes.
+	 *	@param word The word.
+	 *	@param expected The value at which to block.
+	 *	@param timeout The relative timeout, or null to wait indefinitely.
+	 */
+	inline void shm_task_ring_futex_wait(std::atomic<std::uint32_t>& word, const std::uint32_t expected, const timespec* const timeout) noexcept
+	{
+		// Not FUTEX_PRIVATE_FLAG, as waiters and wakers may be in different processes.
+		::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+	}
+	/**	Wake waiters on a futex word shared between processes.
+	 *	@param word The word.
+	 */
+	inline void shm_task_ring_futex_wake(std::atomic<std::uint32_t>& word) noexcept
+	{
+		::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+	}
+} // namespace detail
+
+/**	Implements a bounded ring of calls to registered functions in shared memory.
+ *	@detail Each record is a function_registry identifier and the bytes of a
+ *	trivially copyable argument, written once by the producer into a
+ *	fixed-size slot of a MAP_SHARED mapping and dispatched by the consumer
+ *	straight from that slot. Slots carry sequence numbers, so producers claim
+ *	them by advancing a shared tail, with a plain store if single or a
+ *	compare-and-swap if multiple, and publish them with a release store that
+ *	the consumer acquires. A consumer with nothing to do blocks on a
+ *	process-shared futex; producers only wake it after seeing its waiting
+ *	flag. One consumer, in any of the attached processes, may pop at a time.
+ *	The mapping is created from a memfd, inherited across fork or passed as a
+ *	descriptor, or from a named POSIX shared memory object.
+ *	@tparam Producers Whether one or many producers may push concurrently.
+ */
+template <shm_task_ring_producers Producers = shm_task_ring_producers::multiple>
+class shm_task_ring final
+{
+public:
+	using id_type = function_registry::id_type;
+	using size_type = std::size_t;
+
+	shm_task_ring(const shm_task_ring&) = delete;
+	shm_task_ring& operator=(const shm_task_ring&) = delete;
+
+	/**	Move constructor.
+	 *	@param other The ring from which to take the mapping.
+	 */
+	shm_task_ring(shm_task_ring&& other) noexcept
+		: m_fd{ std::exchange(other.m_fd, -1) }
+		, m_header{ std::exchange(other.m_header, nullptr) }
+		, m_mapping_size{ std::exchange(other.m_mapping_size, 0) }
+		, m_slot_count{ other.m_slot_count }
+		, m_slot_size{ other.m_slot_size }
+	{ }
+	/**	Destructor.
+	 *	@detail Unmaps and closes the descriptor. The shared memory persists
+	 *	while other processes map it and, if named, until unlinked.
+	 */
+	~shm_task_ring()
+	{
+		if (m_header != nullptr)
+		{
+			::munmap(m_header, m_mapping_size);
+		}
+		if (m_fd != -1)
+		{
+			::close(m_fd);
+		}
+	}
+
+	/**	Create a ring in an anonymous memfd.
+	 *	@detail Throws std::system_error if the memory cannot be created or mapped.
+	 *	@param slot_count The number of records the ring can hold, rounded up to a power of two.
+	 *	@param argument_capacity The largest argument in bytes.
+	 *	@return The ring.
+	 */
+	static shm_task_ring create(const size_type slot_count, const size_type argument_capacity = 64)
+	{
+		const int fd = static_cast<int>(::syscall(SYS_memfd_create, "sh_shm_task_ring", MFD_CLOEXEC));
+		if (fd == -1)
+		{
+			throw std::system_error{ errno, std::generic_category(), "memfd_create" };
+		}
+		return shm_task_ring{ fd, slot_count, argument_capacity };
+	}
+	/**	Create a ring in a new named POSIX shared memory object.
+	 *	@detail Throws std::system_error if the name exists or the memory cannot be created or mapped.
+	 *	@param name The object's name, starting with a slash.
+	 *	@param slot_count The number of records the ring can hold, rounded up to a power of two.
+	 *	@param argument_capacity The largest argument in bytes.
+	 *	@return The ring.
+	 */
+	static shm_task_ring create(const char* const name, const size_type slot_count, const size_type argument_capacity = 64)
+	{
+		const int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd == -1)
+		{
+			throw std::system_error{ errno, std::generic_category(), "shm_open" };
+		}
+		try
+		{
+			return shm_task_ring{ fd, slot_count, argument_capacity };
+		}
+		catch (...)
+		{
+			::shm_unlink(name);
+			throw;
+		}
+	}
+	/**	Attach to a ring created by another shm_task_ring.
+	 *	@detail Throws std::system_error if the descriptor cannot be mapped,
+	 *	or std::invalid_argument if it does not hold a ring of this protocol.
+	 *	@param fd A descriptor of the ring's memory, which is duplicated.
+	 *	@return The ring.
+	 */
+	static shm_task_ring attach(const int fd)
+	{
+		const int duplicate = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		if (duplicate == -1)
+		{
+			throw std::system_error{ errno, std::generic_category(), "fcntl" };
+		}
+		return shm_task_ring{ duplicate };
+	}
+	/**	Attach to a ring in a named POSIX shared memory object.
+	 *	@detail Throws as attach(fd) does, or std::system_error if the name does not exist.
+	 *	@param name The object's name.
+	 *	@return The ring.
+	 */
+	static shm_task_ring attach(const char* const name)
+	{
+		const int fd = ::shm_open(name, O_RDWR | O_CLOEXEC, 0);
+		if (fd == -1)
+		{
+			throw std::system_error{ errno, std::generic_category(), "shm_open" };
+		}
+		return shm_task_ring{ fd };
+	}
+	/**	Remove a named POSIX shared memory object, which persists until no longer mapped.
+	 *	@param name The object's name.
+	 */
+	static void unlink(const char* const name) noexcept
+	{
+		::shm_unlink(name);
+	}
+
+	/**	The descriptor of the ring's memory, to pass to attach in another process.
+	 *	@return The descriptor.
+	 */
+	int fd() const noexcept
+	{
+		return m_fd;
+	}
+	/**	The number of records the ring can hold.
+	 *	@return The slot count.
+	 */
+	size_type capacity() const noexcept
+	{
+		return m_slot_count;
+	}
+	/**	The largest argument a record can hold.
+	 *	@return The argument capacity in bytes.
+	 */
+	size_type argument_capacity() const noexcept
+	{
+		return m_slot_size - sizeof(detail::shm_task_ring_record);
+	}
+
+	/**	Try to push a call of a function that takes no argument.
+	 *	@param id The function's identifier.
+	 *	@return True if pushed, or false if full.
+	 */
+	bool try_push(const id_type id) noexcept
+	{
+		return try_push_bytes(id, nullptr, 0);
+	}
+	/**	Try to push a call of a function with an argument.
+	 *	@param id The function's identifier.
+	 *	@param arg The argument, copied into the record.
+	 *	@return True if pushed, or false if full or the argument exceeds argument_capacity().
+	 *	@tparam Arg The trivially copyable argument type.
+	 */
+	template <typename Arg>
+	bool try_push(const id_type id, const Arg& arg) noexcept
+	{
+		static_assert(std::is_trivially_copyable_v<Arg>, "shm_task_ring requires a trivially copyable argument.");
+		return try_push_bytes(id, &arg, sizeof(Arg));
+	}
+	/**	Try to push a call with an argument given as bytes.
+	 *	@param id The function's identifier.
+	 *	@param bytes The argument's bytes.
+	 *	@param size The number of bytes.
+	 *	@return True if pushed, or false if full or size exceeds argument_capacity().
+	 */
+	bool try_push_bytes(const id_type id, const void* const bytes, const size_type size) noexcept
+	{
+		if (size > argument_capacity())
+		{
+			return false;
+		}
+		detail::shm_task_ring_header& header = *m_header;
+		const std::uint64_t mask = m_slot_count - 1;
+		std::uint64_t position = header.m_tail.load(std::memory_order_relaxed);
+		detail::shm_task_ring_record* claimed;
+		for (;;)
+		{
+			claimed = &record(position & mask);
+			const std::uint64_t sequence = claimed->m_sequence.load(std::memory_order_acquire);
+			if (sequence == position)
+			{
+				if constexpr (Producers == shm_task_ring_producers::single)
+				{
+					header.m_tail.store(position + 1, std::memory_order_relaxed);
+					break;
+				}
+				else if (header.m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (sequence < position)
+			{
+				// The consumer has yet to free the slot from the previous lap.
+				return false;
+			}
+			else
+			{
+				position = header.m_tail.load(std::memory_order_relaxed);
+			}
+		}
+		claimed->m_id = id;
+		claimed->m_size = static_cast<std::uint32_t>(size);
+		if (size != 0)
+		{
+			std::memcpy(reinterpret_cast<unsigned char*>(claimed + 1), bytes, size);
+		}
+		claimed->m_sequence.store(position + 1, std::memory_order_release);
+		// Pairs with the fence in wait, so either the consumer sees this record or this sees it waiting.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (header.m_waiting.load(std::memory_order_relaxed) != 0)
+		{
+			header.m_signal.fetch_add(1, std::memory_order_relaxed);
+			detail::shm_task_ring_futex_wake(header.m_signal);
+		}
+		return true;
+	}
+	/**	Push a call, yielding while full.
+	 *	@detail Throws std::length_error if the argument exceeds argument_capacity(),
+	 *	rather than yielding forever.
+	 *	@param id The function's identifier.
+	 *	@param args Nothing, or the argument.
+	 *	@tparam Args Nothing, or the trivially copyable argument type.
+	 */
+	template <typename... Args>
+	void push(const id_type id, const Args&... args)
+	{
+		static_assert(sizeof...(Args) <= 1, "shm_task_ring calls take at most one argument.");
+		if ((size_type{ 0 } + ... + sizeof(Args)) > argument_capacity())
+		{
+			throw std::length_error{ "shm_task_ring argument exceeds the argument capacity" };
+		}
+		while (false == try_push(id, args...))
+		{
+			std::this_thread::yield();
+		}
+	}
+	/**	Mark that no more calls will be pushed, and wake the consumer.
+	 */
+	void close() noexcept
+	{
+		detail::shm_task_ring_header& header = *m_header;
+		header.m_closed.store(1, std::memory_order_seq_cst);
+		header.m_signal.fetch_add(1, std::memory_order_seq_cst);
+		detail::shm_task_ring_futex_wake(header.m_signal);
+	}
+	/**	Test if close was called.
+	 *	@return True if closed.
+	 */
+	bool closed() const noexcept
+	{
+		return m_header->m_closed.load(std::memory_order_acquire) != 0;
+	}
+
+	/**	Test if a record is ready to pop. Consumer only.
+	 *	@return True if a record is ready.
+	 */
+	bool ready() const noexcept
+	{
+		const detail::shm_task_ring_header& header = *m_header;
+		return record(header.m_head & (m_slot_count - 1)).m_sequence.load(std::memory_order_acquire) == header.m_head + 1;
+	}
+	/**	Call the next record's function in-place from its slot, then free the slot. Consumer only.
+	 *	@detail Throws std::length_error if the record claims an argument larger
+	 *	than its slot, else as function_registry::invoke does, or whatever the
+	 *	function throws; the record is consumed regardless.
+	 *	@param registry The registry of the functions the producers name.
+	 *	@return True if a record was popped, or false if empty.
+	 */
+	bool try_pop(const function_registry& registry)
+	{
+		if (false == ready())
+		{
+			return false;
+		}
+		detail::shm_task_ring_header& header = *m_header;
+		struct release_guard final
+		{
+			~release_guard()
+			{
+				m_record.m_sequence.store(m_position + m_slot_count, std::memory_order_release);
+			}
+
+			detail::shm_task_ring_record& m_record;
+			const std::uint64_t m_position;
+			const std::uint64_t m_slot_count;
+		} guard{ record(header.m_head & (m_slot_count - 1)), header.m_head++, m_slot_count };
+		// Read once, as a faulty or hostile producer may rewrite it, and bound it so invoke stays inside the slot.
+		const size_type size = guard.m_record.m_size;
+		if (size > argument_capacity())
+		{
+			throw std::length_error{ "shm_task_ring record exceeds the argument capacity" };
+		}
+		registry.invoke(guard.m_record.m_id, &guard.m_record + 1, size);
+		return true;
+	}
+	/**	Pop and call records until empty or a limit is reached. Consumer only.
+	 *	@param registry The registry of the functions the producers name.
+	 *	@param max The maximum number of records to pop.
+	 *	@return The number of records popped.
+	 */
+	size_type drain(const function_registry& registry, const size_type max = ~size_type{ 0 })
+	{
+		size_type popped = 0;
+		while (popped < max && try_pop(registry))
+		{
+			++popped;
+		}
+		return popped;
+	}
+	/**	Block until a record is ready or the ring is closed. Consumer only.
+	 *	@param timeout_milliseconds The longest to wait, or negative to wait indefinitely.
+	 *	@return True if a record is ready, or false if closed and empty or timed out.
+	 */
+	bool wait(const int timeout_milliseconds = -1) noexcept
+	{
+		detail::shm_task_ring_header& header = *m_header;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{ timeout_milliseconds };
+		for (;;)
+		{
+			if (ready())
+			{
+				return true;
+			}
+			if (closed())
+			{
+				return false;
+			}
+			timespec remaining{};
+			if (timeout_milliseconds >= 0)
+			{
+				// A wakeup may be for a later slot while the next is still being written, so wait out the whole timeout.
+				const auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+				if (left <= 0)
+				{
+					return false;
+				}
+				remaining.tv_sec = static_cast<std::time_t>(left / 1000000000);
+				remaining.tv_nsec = static_cast<long>(left % 1000000000);
+			}
+			header.m_waiting.store(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const std::uint32_t signal = header.m_signal.load(std::memory_order_relaxed);
+			if (false == ready() && false == closed())
+			{
+				detail::shm_task_ring_futex_wait(header.m_signal, signal, timeout_milliseconds < 0 ? nullptr : &remaining);
+			}
+			header.m_waiting.store(0, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	/**	Create a ring in an empty descriptor, taking ownership of it.
+	 *	@param fd The descriptor.
+	 *	@param slot_count The requested slot count.
+	 *	@param argument_capacity The largest argument in bytes.
+	 */
+	shm_task_ring(const int fd, const size_type slot_count, const size_type argument_capacity)
+		: m_fd{ fd }
+	{
+		size_type slots = 1;
+		while (slots < slot_count)
+		{
+			slots <<= 1;
+		}
+		const size_type slot_size = (sizeof(detail::shm_task_ring_record) + argument_capacity
+			+ alignof(detail::shm_task_ring_record) - 1) & ~(alignof(detail::shm_task_ring_record) - 1);
+		if (slots > (size_type{ 1 } << 31) || slot_size > ~std::uint32_t{ 0 })
+		{
+			::close(m_fd);
+			throw std::invalid_argument{ "shm_task_ring too large" };
+		}
+		map(sizeof(detail::shm_task_ring_header) + slots * slot_size, true);
+		detail::shm_task_ring_header& header = *new(m_header) detail::shm_task_ring_header{};
+		header.m_producers = Producers;
+		m_slot_count = static_cast<std::uint32_t>(slots);
+		m_slot_size = static_cast<std::uint32_t>(slot_size);
+		header.m_slot_count = m_slot_count;
+		header.m_slot_size = m_slot_size;
+		for (std::uint32_t i = 0; i < slots; ++i)
+		{
+			new(&record(i)) detail::shm_task_ring_record{};
+			record(i).m_sequence.store(i, std::memory_order_relaxed);
+		}
+		// Written last, so an attacher that sees the magic sees an initialised ring.
+		std::atomic_thread_fence(std::memory_order_release);
+		header.m_magic = detail::shm_task_ring_header::magic;
+	}
+	/**	Attach to an existing ring, taking ownership of the descriptor.
+	 *	@param fd The descriptor.
+	 */
+	explicit shm_task_ring(const int fd)
+		: m_fd{ fd }
+	{
+		struct stat status{};
+		if (::fstat(m_fd, &status) == -1)
+		{
+			const int error = errno;
+			::close(m_fd);
+			throw std::system_error{ error, std::generic_category(), "fstat" };
+		}
+		const size_type size = static_cast<size_type>(status.st_size);
+		if (size < sizeof(detail::shm_task_ring_header))
+		{
+			::close(m_fd);
+			throw std::invalid_argument{ "shm_task_ring memory too small" };
+		}
+		map(size, false);
+		const detail::shm_task_ring_header& header = *m_header;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// The geometry comes from another process, so copy it once, then check it before indexing slots with it.
+		m_slot_count = header.m_slot_count;
+		m_slot_size = header.m_slot_size;
+		if (header.m_magic != detail::shm_task_ring_header::magic || header.m_producers != Producers
+			|| m_slot_count == 0 || (m_slot_count & (m_slot_count - 1)) != 0
+			|| m_slot_size < sizeof(detail::shm_task_ring_record)
+			|| m_slot_size % alignof(detail::shm_task_ring_record) != 0
+			|| sizeof(detail::shm_task_ring_header) + size_type{ m_slot_count } * m_slot_size > size)
+		{
+			::munmap(m_header, m_mapping_size);
+			::close(m_fd);
+			throw std::invalid_argument{ "shm_task_ring memory does not hold a ring of this protocol" };
+		}
+	}
+
+	/**	Size and map the descriptor, closing it on failure.
+	 *	@param size The mapping size.
+	 *	@param resize True to set the size of the descriptor's memory first.
+	 */
+	void map(const size_type size, const bool resize)
+	{
+		if (resize && ::ftruncate(m_fd, static_cast<off_t>(size)) == -1)
+		{
+			const int error = errno;
+			::close(m_fd);
+			throw std::system_error{ error, std::generic_category(), "ftruncate" };
+		}
+		void* const address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (address == MAP_FAILED)
+		{
+			const int error = errno;
+			::close(m_fd);
+			throw std::system_error{ error, std::generic_category(), "mmap" };
+		}
+		m_header = static_cast<detail::shm_task_ring_header*>(address);
+		m_mapping_size = size;
+	}
+	detail::shm_task_ring_record& record(const std::uint64_t index) const noexcept
+	{
+		return *reinterpret_cast<detail::shm_task_ring_record*>(reinterpret_cast<unsigned char*>(m_header + 1) + index * m_slot_size);
+	}
+
+	int m_fd{ -1 };
+	detail::shm_task_ring_header* m_header{ nullptr };
+	size_type m_mapping_size{ 0 };
+	/**	The slot geometry, validated once and kept privately so peers cannot change it under this process.
+	 */
+	std::uint32_t m_slot_count{ 0 };
+	std::uint32_t m_slot_size{ 0 };
+};
+
+} // namespace sh
+
+#endif
+
+#endif
@@ -0,0 +1,500 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__SPSC_FUNCTION_RING_HPP
+#define INC_SH__SPSC_FUNCTION_RING_HPP
+
+/**	@file
+ *	This file declares a wait-free, single-producer, single-consumer ring of
+ *	variable-size callables stored in-line within its buffer.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Assumed size of a cache line, used to keep producer and consumer state apart.
+	 */
+	constexpr std::size_t spsc_function_ring_cache_line_size = 64;
+
+	/**	The alignment of every record within a spsc_function_ring, and the maximum alignment of its callables.
+	 */
+	constexpr std::size_t spsc_function_ring_record_alignment = alignof(std::max_align_t);
+
+	/**	Round a byte count up to a multiple of a power of two.
+	 *	@param size The byte count.
+	 *	@param alignment The power of two.
+	 *	@return The rounded byte count.
+	 */
+	constexpr std::size_t spsc_function_ring_align(const std::size_t size, const std::size_t alignment) noexcept
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	/**	Round a buffer size up to a power of two large enough to hold a few records.
+	 *	@param size The requested number of bytes.
+	 *	@return The number of bytes to allocate.
+	 */
+	constexpr std::size_t spsc_function_ring_buffer_size(const std::size_t size) noexcept
+	{
+		std::size_t result = spsc_function_ring_cache_line_size;
+		while (result < size)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	/**	Type wrapper for spsc_function_ring_vtable constructor.
+	 *	@tparam Callable The callable type.
+	 */
+	template <typename Callable>
+	struct spsc_function_ring_callable final
+	{
+		/**	The callable type.
+		 */
+		using type = Callable;
+	};
+
+	/**	Table of functions to operate on a callable stored in a spsc_function_ring record.
+	 *	@detail Records are never relocated, so no move is needed.
+	 *	@tparam NoExcept True if the callable is nothrow.
+	 *	@tparam ResultType The result of calling.
+	 *	@tparam Args The arguments passed on call.
+	 */
+	template <bool NoExcept, typename ResultType, typename... Args>
+	struct spsc_function_ring_vtable final
+	{
+		using call_type = ResultType(*)(void* const, Args...) noexcept(NoExcept);
+		using dtor_type = void(*)(void* const) noexcept;
+
+		/**	Calls the given storage.
+		 */
+		const call_type m_call;
+		/**	Destructs the given storage.
+		 */
+		const dtor_type m_dtor;
+
+		/**	Construct a vtable for a record with the given callable.
+		 *	@tparam Callable The callable type.
+		 */
+		template <typename Callable>
+		explicit spsc_function_ring_vtable(const spsc_function_ring_callable<Callable>&) noexcept
+			: m_call{ [](void* const storage, Args... args) noexcept(NoExcept) -> ResultType
+			{
+				return std::invoke(*static_cast<Callable*>(storage), std::forward<Args>(args)...);
+			} }
+			, m_dtor{ [](void* const storage) noexcept -> void
+			{
+				static_cast<Callable*>(storage)->~Callable();
+			} }
+		{ }
+
+		spsc_function_ring_vtable(const spsc_function_ring_vtable&) = delete;
+		spsc_function_ring_vtable(spsc_function_ring_vtable&&) = delete;
+		spsc_function_ring_vtable& operator=(const spsc_function_ring_vtable&) = delete;
+		spsc_function_ring_vtable& operator=(spsc_function_ring_vtable&&) = delete;
+	};
+
+	/**	Implements a wait-free, single-producer, single-consumer ring of variable-size callables.
+	 *	@note Required as MSVC does not support deduction of function signature noexcept in template specialization.
+	 *	@tparam NoExcept True if this holds nothrow invocables and false otherwise.
+	 *	@tparam ResultType The result of invoking each callable. Discarded.
+	 *	@tparam Args The arguments necessary to invoke each callable.
+	 */
+	template <bool NoExcept, typename ResultType, typename... Args>
+	class spsc_function_ring
+	{
+	public:
+		using size_type = std::size_t;
+
+		spsc_function_ring(const spsc_function_ring&) = delete;
+		spsc_function_ring(spsc_function_ring&&) = delete;
+		spsc_function_ring& operator=(const spsc_function_ring&) = delete;
+		spsc_function_ring& operator=(spsc_function_ring&&) = delete;
+
+		/**	Constructor.
+		 *	@param size The minimum number of buffer bytes. Rounded up to a power of two.
+		 */
+		explicit spsc_function_ring(const size_type size)
+			: m_mask{ detail::spsc_function_ring_buffer_size(size) - 1 }
+			, m_buffer{ std::make_unique<block[]>((m_mask + 1) / sizeof(block)) }
+		{ }
+		/**	Destructor.
+		 *	@detail Destroys any written callables, published or not, without calling them.
+		 */
+		~spsc_function_ring()
+		{
+			for (size_type position = m_consumer.m_read; position != m_producer.m_write; )
+			{
+				header& record = record_at(position);
+				if (record.m_vtable != nullptr)
+				{
+					record.m_vtable->m_dtor(record.storage());
+				}
+				position += record.m_size;
+			}
+		}
+
+		/**	The number of bytes in the buffer.
+		 *	@return The buffer size.
+		 */
+		size_type size() const noexcept
+		{
+			return m_mask + 1;
+		}
+		/**	The number of buffer bytes a record holding the given callable type occupies.
+		 *	@detail Any record no larger than half the buffer can always be written once the consumer catches up.
+		 *	@return The record size in bytes.
+		 *	@tparam Callable The callable type.
+		 */
+		template <typename Callable>
+		static constexpr size_type record_size() noexcept
+		{
+			return detail::spsc_function_ring_align(sizeof(header) + sizeof(std::decay_t<Callable>), detail::spsc_function_ring_record_alignment);
+		}
+
+		/**	Producer only. Write a callable into the ring and publish it, along with any earlier unpublished writes.
+		 *	@param callable An invocable to construct within the ring.
+		 *	@return True if written or false if there is insufficient space.
+		 *	@tparam Callable The type of the given invocable target.
+		 */
+		template <typename Callable,
+			typename = std::enable_if_t<std::is_invocable_r_v<ResultType, Callable, Args...>>>
+		bool try_push(Callable&& callable)
+		{
+			if (try_write(std::forward<Callable>(callable)))
+			{
+				publish();
+				return true;
+			}
+			return false;
+		}
+		/**	Producer only. Write a callable into the ring without making it visible to the consumer.
+		 *	@detail Several writes followed by a single publish amortize the
+		 *	cost of synchronizing with the consumer. Throws std::length_error if
+		 *	the callable's record is larger than half the buffer, as it might
+		 *	otherwise never fit.
+		 *	@param callable An invocable to construct within the ring.
+		 *	@return True if written or false if there is insufficient space.
+		 *	@tparam Callable The type of the given invocable target.
+		 */
+		template <typename Callable,
+			typename = std::enable_if_t<std::is_invocable_r_v<ResultType, Callable, Args...>>>
+		bool try_write(Callable&& callable)
+		{
+			static_assert(NoExcept == false || std::is_nothrow_invocable_r_v<ResultType, Callable, Args...>, "spsc_function_ring requires nothrow invocable.");
+			using callable_type = std::decay_t<Callable>;
+			static_assert(alignof(callable_type) <= detail::spsc_function_ring_record_alignment, "Callable alignment too large for spsc_function_ring.");
+			constexpr size_type callable_size = record_size<callable_type>();
+			if (callable_size > size() / 2)
+			{
+				throw std::length_error{ "Callable too large for spsc_function_ring" };
+			}
+
+			size_type position = m_producer.m_write;
+			const size_type to_end = size() - (position & m_mask);
+			const size_type required = callable_size <= to_end ? callable_size : to_end + callable_size;
+			if (size() - (position - m_producer.m_read_cache) < required)
+			{
+				m_producer.m_read_cache = m_read.load(std::memory_order_acquire);
+				if (size() - (position - m_producer.m_read_cache) < required)
+				{
+					return false;
+				}
+			}
+			if (callable_size > to_end)
+			{
+				// Too little space remains before the end of the buffer, so mark it as skipped and wrap around.
+				new(&record_at(position)) header{ nullptr, to_end };
+				position += to_end;
+				m_producer.m_write = position;
+			}
+			header* const record = new(&record_at(position)) header{ &callable_vtable<callable_type>(), callable_size };
+			new(record->storage()) callable_type{ std::forward<Callable>(callable) };
+			m_producer.m_write = position + callable_size;
+			return true;
+		}
+		/**	Producer only. Make all written callables visible to the consumer.
+		 */
+		void publish() noexcept
+		{
+			m_write.store(m_producer.m_write, std::memory_order_release);
+		}
+
+		/**	Consumer only. Call and then destroy the oldest published callable, if any.
+		 *	@param args The arguments to pass to the callable.
+		 *	@return True if a callable was called or false if none were published.
+		 *	@tparam OperatorArgs The arguments to forward to the callable.
+		 */
+		template <typename... OperatorArgs>
+		bool try_invoke(OperatorArgs&&... args) noexcept(NoExcept)
+		{
+			header* const record = front();
+			if (record == nullptr)
+			{
+				return false;
+			}
+			const consume_guard guard{ *this, *record };
+			record->m_vtable->m_call(record->storage(), std::forward<OperatorArgs>(args)...);
+			return true;
+		}
+		/**	Consumer only. Call and then destroy up to count of the oldest published callables.
+		 *	@detail Buffer space is returned to the producer once, after the
+		 *	last call. Each callable receives a copy of, or reference to, args,
+		 *	as lvalues, so signatures taking rvalue references or move-only
+		 *	values must use try_invoke instead.
+		 *	@param count The maximum number of callables to call.
+		 *	@param args The arguments to pass to each callable.
+		 *	@return The number of callables called.
+		 */
+		size_type invoke_batch(const size_type count, Args... args) noexcept(NoExcept)
+		{
+			static_assert((std::is_constructible_v<Args, std::remove_reference_t<Args>&> && ...),
+				"invoke_batch passes each argument to every callable as an lvalue; use try_invoke for rvalue reference or move-only arguments.");
+			const release_guard guard{ *this };
+			size_type result = 0;
+			for (; result < count; ++result)
+			{
+				header* const record = front();
+				if (record == nullptr)
+				{
+					break;
+				}
+				const destroy_guard destroy{ *this, *record };
+				record->m_vtable->m_call(record->storage(), args...);
+			}
+			return result;
+		}
+
+	private:
+		using vtable_type = detail::spsc_function_ring_vtable<NoExcept, ResultType, Args...>;
+
+		/**	Precedes every record, which is padded to spsc_function_ring_record_alignment.
+		 */
+		struct alignas(detail::spsc_function_ring_record_alignment) header final
+		{
+			/**	The callable's vtable or null if this marks the remainder of the buffer as skipped.
+			 */
+			const vtable_type* m_vtable;
+			/**	The size of this record, including this header, in bytes.
+			 */
+			size_type m_size;
+
+			/**	Storage for the callable, immediately after this header.
+			 *	@return A pointer to the callable's storage.
+			 */
+			void* storage() noexcept
+			{
+				return this + 1;
+			}
+		};
+
+		/**	Unit of buffer allocation.
+		 */
+		struct alignas(detail::spsc_function_ring_cache_line_size) block final
+		{
+			std::byte m_bytes[detail::spsc_function_ring_cache_line_size];
+		};
+
+		/**	Destroys a called record and advances the consumer past it, even if calling throws.
+		 */
+		struct destroy_guard final
+		{
+			~destroy_guard()
+			{
+				m_ring.consume(m_record);
+			}
+
+			spsc_function_ring& m_ring;
+			header& m_record;
+		};
+		/**	Returns consumed space to the producer, even if calling throws.
+		 */
+		struct release_guard final
+		{
+			~release_guard()
+			{
+				m_ring.m_read.store(m_ring.m_consumer.m_read, std::memory_order_release);
+			}
+
+			spsc_function_ring& m_ring;
+		};
+		/**	Consumes a single record and returns its space to the producer, even if calling throws.
+		 */
+		struct consume_guard final
+		{
+			~consume_guard()
+			{
+				m_ring.consume(m_record);
+				m_ring.m_read.store(m_ring.m_consumer.m_read, std::memory_order_release);
+			}
+
+			spsc_function_ring& m_ring;
+			header& m_record;
+		};
+
+		/**	A vtable that operates upon storage containing the given callable type.
+		 *	@return A reference to a static vtable for the given callable type.
+		 *	@tparam Callable The callable type.
+		 */
+		template <typename Callable>
+		static const vtable_type& callable_vtable() noexcept
+		{
+			static const vtable_type instance{ detail::spsc_function_ring_callable<Callable>{} };
+			return instance;
+		}
+
+		/**	The record at a given position.
+		 *	@param position A byte position, which is reduced modulo the buffer size.
+		 *	@return A reference to the record header at that position.
+		 */
+		header& record_at(const size_type position) const noexcept
+		{
+			return *std::launder(reinterpret_cast<header*>(reinterpret_cast<std::byte*>(m_buffer.get()) + (position & m_mask)));
+		}
+		/**	Consumer only. Find the oldest published callable, skipping any wrap markers.
+		 *	@return The record or null if none are published.
+		 */
+		header* front() noexcept
+		{
+			for (;;)
+			{
+				if (m_consumer.m_read == m_consumer.m_write_cache)
+				{
+					m_consumer.m_write_cache = m_write.load(std::memory_order_acquire);
+					if (m_consumer.m_read == m_consumer.m_write_cache)
+					{
+						return nullptr;
+					}
+				}
+				header& record = record_at(m_consumer.m_read);
+				if (record.m_vtable != nullptr)
+				{
+					return &record;
+				}
+				m_consumer.m_read += record.m_size;
+			}
+		}
+		/**	Consumer only. Destroy a record's callable and advance past it without returning its space to the producer.
+		 *	@param record The record returned by front.
+		 */
+		void consume(header& record) noexcept
+		{
+			record.m_vtable->m_dtor(record.storage());
+			m_consumer.m_read += record.m_size;
+		}
+
+		/**	One less than the power of two buffer size.
+		 */
+		const size_type m_mask;
+		/**	The byte ring.
+		 */
+		const std::unique_ptr<block[]> m_buffer;
+		/**	The producer's published write position.
+		 */
+		alignas(detail::spsc_function_ring_cache_line_size) std::atomic<size_type> m_write{ 0 };
+		/**	The consumer's published read position.
+		 */
+		alignas(detail::spsc_function_ring_cache_line_size) std::atomic<size_type> m_read{ 0 };
+		/**	State only accessed by the producer.
+		 */
+		struct alignas(detail::spsc_function_ring_cache_line_size)
+		{
+			/**	The position after the last written record, which may be ahead of m_write.
+			 */
+			size_type m_write{ 0 };
+			/**	The last value loaded from m_read.
+			 */
+			size_type m_read_cache{ 0 };
+		} m_producer;
+		/**	State only accessed by the consumer.
+		 */
+		struct alignas(detail::spsc_function_ring_cache_line_size)
+		{
+			/**	The position of the next record to consume, which may be ahead of m_read.
+			 */
+			size_type m_read{ 0 };
+			/**	The last value loaded from m_write.
+			 */
+			size_type m_write_cache{ 0 };
+		} m_consumer;
+	};
+
+} // namespace detail
+
+/**	Implements a wait-free, single-producer, single-consumer ring of variable-size callables.
+ *	@detail Each callable is constructed in-line within the ring, following
+ *	a header holding its vtable pointer and padded size, and is called and
+ *	destroyed there. A callable that does not fit before the end of the ring
+ *	is preceded by a marker so the consumer skips to the start.
+ *	@tparam Signature The function signature.
+ */
+template <typename Signature>
+class spsc_function_ring;
+
+/**	Implements a wait-free, single-producer, single-consumer ring of variable-size callables.
+ *	@tparam ResultType The result of calling each callable. Discarded.
+ *	@tparam Args The arguments necessary to call each callable.
+ */
+template <typename ResultType, typename... Args>
+class spsc_function_ring <ResultType(Args...)> : public detail::spsc_function_ring<false, ResultType, Args...>
+{
+public:
+	using detail::spsc_function_ring<false, ResultType, Args...>::spsc_function_ring;
+};
+
+/**	Implements a wait-free, single-producer, single-consumer ring of variable-size nothrow callables.
+ *	@tparam ResultType The result of calling each callable. Discarded.
+ *	@tparam Args The arguments necessary to call each callable.
+ */
+template <typename ResultType, typename... Args>
+class spsc_function_ring <ResultType(Args...) noexcept> : public detail::spsc_function_ring<true, ResultType, Args...>
+{
+public:
+	using detail::spsc_function_ring<true, ResultType, Args...>::spsc_function_ring;
+};
+
+} // namespace sh
+
+#endif
@@ -0,0 +1,358 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__TASK_GRAPH_HPP
+#define INC_SH__TASK_GRAPH_HPP
+
+/**	@file
+ *	This file declares a reusable graph of dependent tasks, stored in-place,
+ *	executed upon a thread_pool or similar executor.
+ */
+
+#include "inplace_move_only_function.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+/**	Implements a reusable directed acyclic graph of tasks.
+ *	@detail Task bodies are stored in-place in a contiguous node arena and
+ *	edges are flattened into a single successor array per run of changes.
+ *	Running the graph resets an atomic predecessor counter per node and
+ *	submits each root to an executor; a finished task decrements its
+ *	successors' counters, submitting all but the last that becomes ready and
+ *	continuing with that one directly. Running again, or clearing and
+ *	rebuilding a graph no larger than before, does not allocate.
+ *	@tparam TaskCapacity The number of in-place storage bytes per task.
+ */
+template <std::size_t TaskCapacity = sizeof(void*) * 6>
+class task_graph final
+{
+public:
+	using task_type = sh::inplace_move_only_function<void(), TaskCapacity>;
+	using size_type = std::size_t;
+	using node_id = std::uint32_t;
+
+	task_graph(const task_graph&) = delete;
+	task_graph(task_graph&&) = delete;
+	task_graph& operator=(const task_graph&) = delete;
+	task_graph& operator=(task_graph&&) = delete;
+
+	/**	Constructor.
+	 *	@param node_capacity The number of nodes for which to reserve space.
+	 *	@param edge_capacity The number of edges for which to reserve space.
+	 */
+	explicit task_graph(const size_type node_capacity = 0, const size_type edge_capacity = 0)
+	{
+		reserve(node_capacity, edge_capacity);
+	}
+
+	/**	Reserve space for nodes and edges.
+	 *	@param node_capacity The number of nodes for which to reserve space.
+	 *	@param edge_capacity The number of edges for which to reserve space.
+	 */
+	void reserve(const size_type node_capacity, const size_type edge_capacity)
+	{
+		m_nodes.reserve(node_capacity);
+		m_edges.reserve(edge_capacity);
+		m_successors.reserve(edge_capacity);
+		if (node_capacity > m_pending_capacity)
+		{
+			m_pending = std::make_unique<std::atomic<std::uint32_t>[]>(node_capacity);
+			m_pending_capacity = node_capacity;
+		}
+	}
+	/**	The number of nodes.
+	 *	@return The node count.
+	 */
+	size_type size() const noexcept
+	{
+		return m_nodes.size();
+	}
+	/**	Test if there are no nodes.
+	 *	@return True if the graph has no nodes.
+	 */
+	bool empty() const noexcept
+	{
+		return m_nodes.empty();
+	}
+	/**	Remove all nodes and edges, retaining their storage.
+	 */
+	void clear() noexcept
+	{
+		m_nodes.clear();
+		m_edges.clear();
+		m_dirty = true;
+	}
+
+	/**	Add a task.
+	 *	@param callable An invocable to wrap and call once per run, after all of its predecessors.
+	 *	@return The new node's identifier.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_invocable_v<std::decay_t<Callable>&>>>
+	node_id emplace(Callable&& callable)
+	{
+		m_nodes.emplace_back(std::forward<Callable>(callable));
+		m_dirty = true;
+		return static_cast<node_id>(m_nodes.size() - 1);
+	}
+	/**	Require that one task finish before another starts.
+	 *	@param before The predecessor's identifier.
+	 *	@param after The successor's identifier.
+	 */
+	void precede(const node_id before, const node_id after)
+	{
+		assert(before < m_nodes.size() && after < m_nodes.size() && before != after);
+		m_edges.emplace_back(before, after);
+		m_dirty = true;
+	}
+
+	/**	Execute every task once, respecting dependencies, and wait for all to finish.
+	 *	@detail The calling thread executes other pending tasks while
+	 *	waiting. Tasks must not throw and must not modify the graph. If the
+	 *	executor throws from submit, such as when it cannot allocate or its
+	 *	queue is full, the ready task runs on the submitting thread instead.
+	 *	@param executor The executor. Requires submit(callable) and try_run_one().
+	 *	@tparam Executor The executor type, such as thread_pool.
+	 */
+	template <typename Executor>
+	void run(Executor& executor)
+	{
+		if (m_nodes.empty())
+		{
+			return;
+		}
+		if (m_dirty)
+		{
+			build();
+		}
+		const size_type count = m_nodes.size();
+		for (size_type i = 0; i < count; ++i)
+		{
+			m_pending[i].store(m_nodes[i].m_predecessors, std::memory_order_relaxed);
+		}
+		m_remaining.store(count, std::memory_order_relaxed);
+		for (size_type i = 0; i < count; ++i)
+		{
+			if (m_nodes[i].m_predecessors == 0)
+			{
+				submit(executor, static_cast<node_id>(i));
+			}
+		}
+		while (m_remaining.load(std::memory_order_acquire) != 0)
+		{
+			if (false == executor.try_run_one())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+private:
+	/**	A task and the range of its successors within m_successors.
+	 */
+	struct node final
+	{
+		template <typename Callable>
+		explicit node(Callable&& callable)
+			: m_task{ std::forward<Callable>(callable) }
+		{ }
+
+		/**	The task body.
+		 */
+		task_type m_task;
+		/**	The number of edges into this node.
+		 */
+		std::uint32_t m_predecessors{ 0 };
+		/**	The index of the first successor.
+		 */
+		std::uint32_t m_successors_begin{ 0 };
+		/**	One past the index of the last successor.
+		 */
+		std::uint32_t m_successors_end{ 0 };
+	};
+
+	/**	Flatten m_edges into per-node successor ranges and size the counters.
+	 */
+	void build()
+	{
+		const size_type count = m_nodes.size();
+		reserve(count, m_edges.size());
+		for (node& each : m_nodes)
+		{
+			each.m_predecessors = 0;
+			each.m_successors_begin = 0;
+			each.m_successors_end = 0;
+		}
+		for (const std::pair<node_id, node_id>& edge : m_edges)
+		{
+			++m_nodes[edge.first].m_successors_end;
+			++m_nodes[edge.second].m_predecessors;
+		}
+		std::uint32_t offset = 0;
+		for (node& each : m_nodes)
+		{
+			each.m_successors_begin = offset;
+			offset += each.m_successors_end;
+			each.m_successors_end = each.m_successors_begin;
+		}
+		m_successors.resize(m_edges.size());
+		for (const std::pair<node_id, node_id>& edge : m_edges)
+		{
+			m_successors[m_nodes[edge.first].m_successors_end++] = edge.second;
+		}
+		assert(acyclic());
+		m_dirty = false;
+	}
+	/**	Test that the graph has no cycles, which would otherwise leave run waiting forever.
+	 *	@return True if every node can be reached in dependency order.
+	 */
+	bool acyclic() const
+	{
+		std::vector<std::uint32_t> pending;
+		std::vector<node_id> ready;
+		for (size_type i = 0; i < m_nodes.size(); ++i)
+		{
+			pending.push_back(m_nodes[i].m_predecessors);
+			if (pending.back() == 0)
+			{
+				ready.push_back(static_cast<node_id>(i));
+			}
+		}
+		size_type visited = 0;
+		while (false == ready.empty())
+		{
+			const node& current = m_nodes[ready.back()];
+			ready.pop_back();
+			++visited;
+			for (std::uint32_t i = current.m_successors_begin; i < current.m_successors_end; ++i)
+			{
+				if (--pending[m_successors[i]] == 0)
+				{
+					ready.push_back(m_successors[i]);
+				}
+			}
+		}
+		return visited == m_nodes.size();
+	}
+	/**	Submit a ready node to the executor, or execute it now if the executor throws.
+	 *	@param executor The executor.
+	 *	@param id The ready node.
+	 *	@tparam Executor The executor type.
+	 */
+	template <typename Executor>
+	void submit(Executor& executor, const node_id id) noexcept
+	{
+		try
+		{
+			executor.submit([this, &executor, id]()
+			{
+				execute(executor, id);
+			});
+		}
+		catch (...)
+		{
+			execute(executor, id);
+		}
+	}
+	/**	Execute a ready node, then any successor that it alone makes ready, and so on.
+	 *	@param executor The executor upon which to submit other ready successors.
+	 *	@param id The ready node.
+	 *	@tparam Executor The executor type.
+	 */
+	template <typename Executor>
+	void execute(Executor& executor, node_id id) noexcept
+	{
+		for (;;)
+		{
+			const node& current = m_nodes[id];
+			current.m_task();
+			bool has_next = false;
+			node_id next = 0;
+			for (std::uint32_t i = current.m_successors_begin; i < current.m_successors_end; ++i)
+			{
+				const node_id successor = m_successors[i];
+				if (m_pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					if (has_next)
+					{
+						submit(executor, next);
+					}
+					next = successor;
+					has_next = true;
+				}
+			}
+			m_remaining.fetch_sub(1, std::memory_order_release);
+			if (false == has_next)
+			{
+				return;
+			}
+			id = next;
+		}
+	}
+
+	/**	The node arena.
+	 */
+	std::vector<node> m_nodes;
+	/**	Edges as added, flattened into m_successors by build.
+	 */
+	std::vector<std::pair<node_id, node_id>> m_edges;
+	/**	Successor identifiers, grouped by predecessor.
+	 */
+	std::vector<node_id> m_successors;
+	/**	Per-node count of predecessors yet to finish in the current run.
+	 */
+	std::unique_ptr<std::atomic<std::uint32_t>[]> m_pending;
+	/**	The length of m_pending.
+	 */
+	size_type m_pending_capacity{ 0 };
+	/**	The number of tasks yet to finish in the current run.
+	 */
+	std::atomic<size_type> m_remaining{ 0 };
+	/**	True if nodes or edges changed since the last build.
+	 */
+	bool m_dirty{ true };
+};
+
+} // namespace sh
+
+#endif
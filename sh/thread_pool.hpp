@@ -0,0 +1,665 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__THREAD_POOL_HPP
+#define INC_SH__THREAD_POOL_HPP
+
+/**	@file
+ *	This file declares a work-stealing thread pool whose tasks are stored
+ *	in-place within inplace_move_only_function objects.
+ */
+
+#include "inplace_move_only_function.hpp"
+#include "mpmc_function_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#	include <climits>
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#else
+#	include <condition_variable>
+#	include <mutex>
+#endif
+
+namespace sh
+{
+
+namespace detail
+{
+	/**	Assumed size of a cache line, used to keep per-worker state apart.
+	 */
+	constexpr std::size_t thread_pool_cache_line_size = 64;
+
+	/**	Lets idle threads sleep until work may be available without missing a notification.
+	 *	@detail A waiter calls prepare_wait, re-checks for work and then calls
+	 *	either wait or cancel_wait. A notifier publishes work before calling
+	 *	notify_one or notify_all. On Linux, sleeping threads block in futex
+	 *	on m_epoch; elsewhere, on a condition variable.
+	 */
+	class thread_pool_event_count final
+	{
+	public:
+		thread_pool_event_count() noexcept = default;
+		thread_pool_event_count(const thread_pool_event_count&) = delete;
+		thread_pool_event_count& operator=(const thread_pool_event_count&) = delete;
+
+		/**	Announce an intent to wait.
+		 *	@return A key to pass to wait.
+		 */
+		std::uint32_t prepare_wait() noexcept
+		{
+			m_waiters.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return m_epoch.load(std::memory_order_seq_cst);
+		}
+		/**	Withdraw an intent to wait announced by prepare_wait.
+		 */
+		void cancel_wait() noexcept
+		{
+			m_waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+		/**	Sleep unless notified since prepare_wait returned key.
+		 *	@param key The result of prepare_wait.
+		 */
+		void wait(const std::uint32_t key) noexcept
+		{
+#if defined(__linux__)
+			while (m_epoch.load(std::memory_order_acquire) == key)
+			{
+				::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+			}
+#else
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_condition.wait(lock, [this, key]() { return m_epoch.load(std::memory_order_acquire) != key; });
+#endif
+			m_waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+		/**	Wake one waiting thread, if any.
+		 */
+		void notify_one() noexcept
+		{
+			notify(1);
+		}
+		/**	Wake all waiting threads.
+		 */
+		void notify_all() noexcept
+		{
+			notify(INT_MAX);
+		}
+
+	private:
+		/**	Advance the epoch and wake up to count waiters, unless there are none.
+		 *	@param count The maximum number of threads to wake.
+		 */
+		void notify(const int count) noexcept
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (m_waiters.load(std::memory_order_seq_cst) == 0)
+			{
+				return;
+			}
+#if defined(__linux__)
+			m_epoch.fetch_add(1, std::memory_order_release);
+			::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+			{
+				const std::lock_guard<std::mutex> lock{ m_mutex };
+				m_epoch.fetch_add(1, std::memory_order_release);
+			}
+			if (count == 1)
+			{
+				m_condition.notify_one();
+			}
+			else
+			{
+				m_condition.notify_all();
+			}
+#endif
+		}
+
+		/**	Incremented by each notification that may wake a waiter.
+		 */
+		std::atomic<std::uint32_t> m_epoch{ 0 };
+		/**	The number of threads between prepare_wait and wait or cancel_wait.
+		 */
+		std::atomic<std::uint32_t> m_waiters{ 0 };
+#if !defined(__linux__)
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+#endif
+	};
+
+	/**	A bounded Chase-Lev work-stealing deque of pointers.
+	 *	@detail The owning thread pushes and pops at the bottom while other
+	 *	threads steal from the top. Follows the C11 formulation by Lê, Pop,
+	 *	Cohen and Zappa Nardelli.
+	 *	@tparam T The pointed-to element type.
+	 */
+	template <typename T>
+	class thread_pool_deque final
+	{
+	public:
+		thread_pool_deque(const thread_pool_deque&) = delete;
+		thread_pool_deque& operator=(const thread_pool_deque&) = delete;
+
+		/**	Constructor.
+		 *	@param capacity The power of two number of elements.
+		 */
+		explicit thread_pool_deque(const std::size_t capacity)
+			: m_mask{ static_cast<std::int64_t>(capacity) - 1 }
+			, m_elements{ std::make_unique<std::atomic<T*>[]>(capacity) }
+		{
+			assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+		}
+
+		/**	Owner only. Push an element at the bottom.
+		 *	@param element The element to push.
+		 *	@return True if pushed or false if full.
+		 */
+		bool push(T* const element) noexcept
+		{
+			const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+			const std::int64_t top = m_top.load(std::memory_order_acquire);
+			if (bottom - top > m_mask)
+			{
+				return false;
+			}
+			m_elements[bottom & m_mask].store(element, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+		/**	Owner only. Pop the most recently pushed element.
+		 *	@return The element or null if empty or lost to a thief.
+		 */
+		T* pop() noexcept
+		{
+			const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+			m_bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t top = m_top.load(std::memory_order_relaxed);
+			if (top > bottom)
+			{
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			T* element = m_elements[bottom & m_mask].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last element, so race any thieves for it.
+				if (false == m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					element = nullptr;
+				}
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return element;
+		}
+		/**	Any thread. Steal the least recently pushed element.
+		 *	@return The element or null if empty or lost to another thread.
+		 */
+		T* steal() noexcept
+		{
+			std::int64_t top = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+			if (top >= bottom)
+			{
+				return nullptr;
+			}
+			T* const element = m_elements[top & m_mask].load(std::memory_order_relaxed);
+			if (false == m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return element;
+		}
+		/**	Any thread. Test if the deque appears empty.
+		 *	@return True if no elements appear present.
+		 */
+		bool empty() const noexcept
+		{
+			return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+		}
+
+	private:
+		/**	One less than the power of two capacity.
+		 */
+		const std::int64_t m_mask;
+		/**	The ring of elements.
+		 */
+		const std::unique_ptr<std::atomic<T*>[]> m_elements;
+		/**	The next position to steal from.
+		 */
+		alignas(thread_pool_cache_line_size) std::atomic<std::int64_t> m_top{ 0 };
+		/**	The next position to push to.
+		 */
+		alignas(thread_pool_cache_line_size) std::atomic<std::int64_t> m_bottom{ 0 };
+	};
+} // namespace detail
+
+/**	Implements a work-stealing pool of threads executing tasks stored in-place.
+ *	@detail Each worker owns a Chase-Lev deque of task nodes drawn from its
+ *	own recycled node pool. Tasks submitted from a worker are pushed onto its
+ *	deque and popped last-in, first-out while the task data is likely still in
+ *	cache; idle workers steal first-in, first-out from randomly chosen
+ *	victims. Tasks submitted from other threads are constructed directly in
+ *	the slots of a shared mpmc_function_queue. Workers without work sleep on
+ *	an event count, which uses futex on Linux. Neither submission nor
+ *	execution allocates once the node pools have warmed up.
+ *	@tparam TaskCapacity The number of in-place storage bytes per task.
+ */
+template <std::size_t TaskCapacity = sizeof(void*) * 6>
+class thread_pool final
+{
+public:
+	using task_type = sh::inplace_move_only_function<void(), TaskCapacity>;
+	using size_type = std::size_t;
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool(thread_pool&&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+	thread_pool& operator=(thread_pool&&) = delete;
+
+	/**	Constructor.
+	 *	@param thread_count The number of worker threads, or zero for one per hardware thread.
+	 *	@param queue_capacity The minimum capacity of each worker's deque and of the external submission queue.
+	 */
+	explicit thread_pool(size_type thread_count = 0, const size_type queue_capacity = 1024)
+		: m_injection{ queue_capacity }
+	{
+		if (thread_count == 0)
+		{
+			thread_count = std::max<size_type>(1, std::thread::hardware_concurrency());
+		}
+		const size_type deque_capacity = m_injection.capacity();
+		m_workers.reserve(thread_count);
+		for (size_type i = 0; i < thread_count; ++i)
+		{
+			m_workers.push_back(std::make_unique<worker>(*this, i, deque_capacity));
+		}
+		m_threads.reserve(thread_count);
+		for (size_type i = 0; i < thread_count; ++i)
+		{
+			m_threads.emplace_back([this, i]() { run(*m_workers[i]); });
+		}
+	}
+	/**	Destructor.
+	 *	@detail Executes all submitted tasks, including any they submit, and then joins the worker threads.
+	 */
+	~thread_pool()
+	{
+		m_stopping.store(true, std::memory_order_seq_cst);
+		m_idle.notify_all();
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	/**	The number of worker threads.
+	 *	@return The worker thread count.
+	 */
+	size_type thread_count() const noexcept
+	{
+		return m_workers.size();
+	}
+
+	/**	Submit a callable for execution on a worker thread.
+	 *	@detail From a worker thread of this pool, the task is pushed onto
+	 *	that worker's deque or, if that is full, onto the external queue. If
+	 *	both are full, it is executed immediately rather than risk every
+	 *	worker waiting upon the others. From any other thread, the task is
+	 *	pushed onto the external queue, yielding while that is full. Tasks
+	 *	must not throw.
+	 *	@param callable An invocable to wrap and call on a worker thread.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_invocable_v<std::decay_t<Callable>&>>>
+	void submit(Callable&& callable)
+	{
+		worker* const current = current_worker();
+		if (current == nullptr)
+		{
+			// Only retried when nothing was constructed, so callable remains intact.
+			while (false == m_injection.try_push(std::forward<Callable>(callable)))
+			{
+				std::this_thread::yield();
+			}
+			m_idle.notify_one();
+			return;
+		}
+		task_node* const node = current->allocate();
+		node->m_task = std::forward<Callable>(callable);
+		if (current->m_deque.push(node))
+		{
+			m_idle.notify_one();
+		}
+		else if (m_injection.try_push(std::move(node->m_task)))
+		{
+			node->m_task = nullptr;
+			current->deallocate(*node);
+			m_idle.notify_one();
+		}
+		else
+		{
+			execute(*node);
+		}
+	}
+	/**	Execute one pending task on the calling thread, if any.
+	 *	@detail Lets a thread waiting on other tasks help rather than block.
+	 *	@return True if a task was executed.
+	 */
+	bool try_run_one() noexcept
+	{
+		worker* const current = current_worker();
+		if (current != nullptr)
+		{
+			return try_run(*current);
+		}
+		if (try_run_external())
+		{
+			return true;
+		}
+		if (task_node* const node = steal(random_index()))
+		{
+			execute(*node);
+			return true;
+		}
+		return false;
+	}
+
+private:
+	struct worker;
+
+	/**	A task on a worker's deque.
+	 */
+	struct task_node final
+	{
+		/**	The task.
+		 */
+		task_type m_task;
+		/**	The worker whose pool this node belongs to.
+		 */
+		worker* m_owner{ nullptr };
+		/**	The next free node.
+		 */
+		task_node* m_next{ nullptr };
+	};
+
+	/**	Per-worker state.
+	 */
+	struct alignas(detail::thread_pool_cache_line_size) worker final
+	{
+		worker(thread_pool& pool, const size_type index, const size_type deque_capacity)
+			: m_pool{ pool }
+			, m_index{ index }
+			, m_deque{ deque_capacity }
+			, m_random{ static_cast<std::uint64_t>(index) * 0x9E3779B97F4A7C15ull + 1 }
+		{ }
+
+		/**	Owner only. Take a free node, reclaiming nodes freed by other threads or allocating more as needed.
+		 *	@return A node with a null task.
+		 */
+		task_node* allocate()
+		{
+			if (m_free == nullptr)
+			{
+				m_free = m_remote_free.exchange(nullptr, std::memory_order_acquire);
+				if (m_free == nullptr)
+				{
+					constexpr size_type chunk_size = 64;
+					m_chunks.push_back(std::make_unique<task_node[]>(chunk_size));
+					task_node* const chunk = m_chunks.back().get();
+					for (size_type i = 0; i < chunk_size; ++i)
+					{
+						chunk[i].m_owner = this;
+						chunk[i].m_next = i + 1 < chunk_size ? &chunk[i + 1] : nullptr;
+					}
+					m_free = chunk;
+				}
+			}
+			return std::exchange(m_free, m_free->m_next);
+		}
+		/**	Any thread. Return a node whose task is null to this worker's pool.
+		 *	@param node The node to return.
+		 */
+		void deallocate(task_node& node) noexcept
+		{
+			if (m_pool.current_worker() == this)
+			{
+				node.m_next = m_free;
+				m_free = &node;
+			}
+			else
+			{
+				node.m_next = m_remote_free.load(std::memory_order_relaxed);
+				while (false == m_remote_free.compare_exchange_weak(node.m_next, &node, std::memory_order_release, std::memory_order_relaxed))
+				{ }
+			}
+		}
+
+		/**	The pool to which this belongs.
+		 */
+		thread_pool& m_pool;
+		/**	The index of this within the pool's workers.
+		 */
+		const size_type m_index;
+		/**	Tasks submitted from this worker.
+		 */
+		detail::thread_pool_deque<task_node> m_deque;
+		/**	State for choosing steal victims.
+		 */
+		std::uint64_t m_random;
+		/**	Owner only. Free nodes.
+		 */
+		task_node* m_free{ nullptr };
+		/**	Owner only. Allocated node arrays.
+		 */
+		std::vector<std::unique_ptr<task_node[]>> m_chunks;
+		/**	Nodes freed by other threads after executing stolen tasks.
+		 */
+		alignas(detail::thread_pool_cache_line_size) std::atomic<task_node*> m_remote_free{ nullptr };
+	};
+
+	/**	The worker running on the calling thread.
+	 *	@return The worker or null if the calling thread is not a worker of this pool.
+	 */
+	worker* current_worker() const noexcept
+	{
+		worker* const current = t_current;
+		return current != nullptr && &current->m_pool == this ? current : nullptr;
+	}
+	/**	Generate a pseudo-random index, used to choose steal victims from non-worker threads.
+	 *	@return A pseudo-random value.
+	 */
+	static std::uint64_t random_index() noexcept
+	{
+		thread_local std::uint64_t state = reinterpret_cast<std::uintptr_t>(&state) | 1;
+		return next_random(state);
+	}
+	/**	Advance an xorshift generator.
+	 *	@param state The generator state, which must be non-zero.
+	 *	@return The next value.
+	 */
+	static std::uint64_t next_random(std::uint64_t& state) noexcept
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+	/**	Try each worker's deque once, starting at a given index.
+	 *	@param start The index at which to start, modulo the worker count.
+	 *	@return A stolen node or null.
+	 */
+	task_node* steal(const std::uint64_t start) noexcept
+	{
+		const size_type count = m_workers.size();
+		for (size_type i = 0; i < count; ++i)
+		{
+			if (task_node* const node = m_workers[(start + i) % count]->m_deque.steal())
+			{
+				return node;
+			}
+		}
+		return nullptr;
+	}
+	/**	Execute and recycle a task node.
+	 *	@param node The node to execute.
+	 */
+	static void execute(task_node& node) noexcept
+	{
+		node.m_task();
+		node.m_task = nullptr;
+		node.m_owner->deallocate(node);
+	}
+	/**	Execute one task from the external queue, if any.
+	 *	@detail The task is moved out of its slot before being called, so the
+	 *	slot can be reused while the task runs. Otherwise a task submitting
+	 *	from a non-worker thread could wait upon its own slot.
+	 *	@return True if a task was executed.
+	 */
+	bool try_run_external() noexcept
+	{
+		task_type task;
+		if (m_injection.try_pop(task))
+		{
+			task();
+			return true;
+		}
+		return false;
+	}
+	/**	Execute one task found locally, externally or by stealing, in that order.
+	 *	@param self The calling thread's worker.
+	 *	@return True if a task was executed.
+	 */
+	bool try_run(worker& self) noexcept
+	{
+		if (task_node* const node = self.m_deque.pop())
+		{
+			execute(*node);
+			return true;
+		}
+		if (try_run_external())
+		{
+			return true;
+		}
+		if (task_node* const node = steal(next_random(self.m_random)))
+		{
+			execute(*node);
+			return true;
+		}
+		return false;
+	}
+	/**	Test if any work appears available.
+	 *	@return True if any queue appears non-empty.
+	 */
+	bool has_work() const noexcept
+	{
+		if (false == m_injection.empty())
+		{
+			return true;
+		}
+		for (const std::unique_ptr<worker>& other : m_workers)
+		{
+			if (false == other->m_deque.empty())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	/**	The main loop of a worker thread.
+	 *	@param self The worker to run.
+	 */
+	void run(worker& self) noexcept
+	{
+		t_current = &self;
+		for (;;)
+		{
+			if (try_run(self))
+			{
+				continue;
+			}
+			const std::uint32_t key = m_idle.prepare_wait();
+			if (has_work())
+			{
+				m_idle.cancel_wait();
+				continue;
+			}
+			if (m_stopping.load(std::memory_order_seq_cst))
+			{
+				m_idle.cancel_wait();
+				break;
+			}
+			m_idle.wait(key);
+		}
+		t_current = nullptr;
+	}
+
+	/**	The worker running on the calling thread, if any, of any pool with the same TaskCapacity.
+	 */
+	static inline thread_local worker* t_current = nullptr;
+
+	/**	Tasks submitted from outside the pool, or that did not fit a worker's deque.
+	 */
+	mpmc_function_queue<void(), TaskCapacity> m_injection;
+	/**	Per-worker state.
+	 */
+	std::vector<std::unique_ptr<worker>> m_workers;
+	/**	Worker threads.
+	 */
+	std::vector<std::thread> m_threads;
+	/**	Parks idle workers.
+	 */
+	detail::thread_pool_event_count m_idle;
+	/**	Set upon destruction.
+	 */
+	std::atomic<bool> m_stopping{ false };
+};
+
+} // namespace sh
+
+#endif
@@ -0,0 +1,466 @@
+/*	BSD 3-Clause License
+
+	Copyright (c) 2024, Paul Varga
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INC_SH__TIMER_WHEEL_HPP
+#define INC_SH__TIMER_WHEEL_HPP
+
+/**	@file
+ *	This file declares a hierarchical timer wheel whose timers store their
+ *	callbacks in-place.
+ */
+
+#include "inplace_move_only_function.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sh
+{
+
+/**	Implements a hierarchical hashed timer wheel.
+ *	@detail Each level has 256 slots, each a doubly linked list of timer
+ *	nodes. A timer is placed on the lowest level whose span covers its delay
+ *	and moves down a level each time the slot containing it is reached, so
+ *	scheduling, re-arming and cancelling are O(1) and each timer is touched at
+ *	most once per level before expiring. Nodes live in fixed-size chunks that
+ *	never move and are recycled through a free list, so once warmed no
+ *	operation allocates. Time is measured in ticks of the caller's choosing
+ *	and only advances when asked. Not thread-safe.
+ *	@tparam CallbackCapacity The number of in-place storage bytes per callback.
+ *	@tparam Levels The number of levels, which together span 256^Levels ticks.
+ */
+template <std::size_t CallbackCapacity = sizeof(void*) * 6, std::size_t Levels = 4>
+class timer_wheel final
+{
+	static_assert(Levels > 0 && Levels <= 8, "timer_wheel requires between 1 and 8 levels.");
+
+public:
+	using callback_type = sh::inplace_move_only_function<void(), CallbackCapacity>;
+	using size_type = std::size_t;
+	using tick_type = std::uint64_t;
+
+	/**	Identifies a scheduled timer. Becomes stale once the timer is cancelled or has fired without being re-armed.
+	 */
+	struct handle final
+	{
+		std::uint32_t m_index{ 0 };
+		/**	Zero for a handle that never identified a timer.
+		 */
+		std::uint32_t m_generation{ 0 };
+
+		constexpr bool operator==(const handle& other) const noexcept
+		{
+			return m_index == other.m_index && m_generation == other.m_generation;
+		}
+		constexpr bool operator!=(const handle& other) const noexcept
+		{
+			return false == (*this == other);
+		}
+	};
+
+	timer_wheel(const timer_wheel&) = delete;
+	timer_wheel(timer_wheel&&) = delete;
+	timer_wheel& operator=(const timer_wheel&) = delete;
+	timer_wheel& operator=(timer_wheel&&) = delete;
+
+	/**	Constructor.
+	 *	@param now The current tick.
+	 *	@param capacity The number of timers for which to reserve nodes.
+	 */
+	explicit timer_wheel(const tick_type now = 0, const size_type capacity = 0)
+		: m_now{ now }
+	{
+		std::fill(std::begin(m_heads), std::end(m_heads), npos);
+		reserve(capacity);
+	}
+	/**	Destructor.
+	 *	@detail Destroys pending callbacks without calling them.
+	 */
+	~timer_wheel() = default;
+
+	/**	Reserve nodes so that scheduling up to the given number of timers does not allocate.
+	 *	@param capacity The number of timers.
+	 */
+	void reserve(const size_type capacity)
+	{
+		while (m_chunks.size() * chunk_size < capacity)
+		{
+			add_chunk();
+		}
+	}
+	/**	The current tick.
+	 *	@return The last tick processed by advance.
+	 */
+	tick_type now() const noexcept
+	{
+		return m_now;
+	}
+	/**	The number of pending timers.
+	 *	@return The count of timers scheduled and not yet fired or cancelled.
+	 */
+	size_type size() const noexcept
+	{
+		return m_size;
+	}
+	/**	Test if no timers are pending.
+	 *	@return True if size() is zero.
+	 */
+	bool empty() const noexcept
+	{
+		return m_size == 0;
+	}
+
+	/**	Schedule a callback to run once.
+	 *	@param delay The number of ticks from now at which to fire, where zero fires upon the next tick.
+	 *	@param callable An invocable to wrap and call when the timer fires.
+	 *	@return A handle for cancelling or re-arming the timer.
+	 *	@tparam Callable The type of the given invocable target.
+	 */
+	template <typename Callable,
+		typename = std::enable_if_t<std::is_invocable_v<std::decay_t<Callable>&>>>
+	handle schedule(const tick_type delay, Callable&& callable)
+	{
+		if (m_free == npos)
+		{
+			add_chunk();
+		}
+		const std::uint32_t index = m_free;
+		node& scheduled = at(index);
+		m_free = scheduled.m_next;
+		scheduled.m_callback = std::forward<Callable>(callable);
+		insert(index, expiry(delay));
+		++m_size;
+		return handle{ index, scheduled.m_generation };
+	}
+	/**	Move a pending or currently firing timer to a new expiry without reallocating its node.
+	 *	@param timer The timer's handle.
+	 *	@param delay The number of ticks from now at which to fire, where zero fires upon the next tick.
+	 *	@return True if rescheduled, or false if the handle is stale.
+	 */
+	bool rearm(const handle timer, const tick_type delay) noexcept
+	{
+		if (false == valid(timer))
+		{
+			return false;
+		}
+		if (at(timer.m_index).m_list == firing_list)
+		{
+			++m_size;
+		}
+		else
+		{
+			unlink(timer.m_index);
+		}
+		insert(timer.m_index, expiry(delay));
+		return true;
+	}
+	/**	Cancel a pending timer, destroying its callback without calling it.
+	 *	@param timer The timer's handle.
+	 *	@return True if cancelled, or false if the handle is stale or the timer is currently firing.
+	 */
+	bool cancel(const handle timer) noexcept
+	{
+		if (false == valid(timer) || at(timer.m_index).m_list == firing_list)
+		{
+			return false;
+		}
+		unlink(timer.m_index);
+		--m_size;
+		if (timer.m_index == m_firing)
+		{
+			// Re-armed and cancelled by its own callback, which is still running; fire frees the node once it returns.
+			at(timer.m_index).m_list = firing_list;
+			return true;
+		}
+		release(timer.m_index);
+		return true;
+	}
+	/**	Test if a timer is pending.
+	 *	@param timer The timer's handle.
+	 *	@return True if the timer is scheduled and has not yet fired.
+	 */
+	bool pending(const handle timer) const noexcept
+	{
+		return valid(timer) && at(timer.m_index).m_list != firing_list;
+	}
+
+	/**	Process every tick up to and including the given one, firing expired timers.
+	 *	@detail Timers expiring on the same tick are detached from their slot
+	 *	together and fired in unspecified order. Callbacks may schedule,
+	 *	re-arm or cancel any timer, including their own, but must not call
+	 *	advance. If a callback throws, the exception propagates and the rest of
+	 *	its batch fires on the next call to advance.
+	 *	@param tick The tick to process through. Ticks at or before now() are ignored.
+	 *	@return The number of callbacks called.
+	 */
+	size_type advance_to(const tick_type tick)
+	{
+		assert(m_firing == npos);
+		size_type fired = fire();
+		while (m_now < tick)
+		{
+			if (m_size == 0)
+			{
+				m_now = tick;
+				break;
+			}
+			++m_now;
+			cascade();
+			std::uint32_t index = std::exchange(m_heads[m_now & slot_mask], npos);
+			while (index != npos)
+			{
+				const std::uint32_t next = at(index).m_next;
+				if (at(index).m_expiry > m_now)
+				{
+					// Only when a single level cannot span the delay.
+					insert(index, at(index).m_expiry);
+				}
+				else
+				{
+					link(index, expiring_list);
+				}
+				index = next;
+			}
+			fired += fire();
+		}
+		return fired;
+	}
+	/**	Process the given number of ticks, firing expired timers.
+	 *	@see advance_to
+	 *	@param ticks The number of ticks.
+	 *	@return The number of callbacks called.
+	 */
+	size_type advance(const tick_type ticks)
+	{
+		return advance_to(m_now + ticks);
+	}
+
+private:
+	static constexpr std::uint32_t npos = std::numeric_limits<std::uint32_t>::max();
+	static constexpr unsigned slot_bits = 8;
+	static constexpr std::size_t slot_count = std::size_t{ 1 } << slot_bits;
+	static constexpr tick_type slot_mask = slot_count - 1;
+	/**	The list of timers detached from a slot and awaiting their callbacks.
+	 */
+	static constexpr std::uint32_t expiring_list = static_cast<std::uint32_t>(Levels * slot_count);
+	/**	Marks a node whose callback is running and which is in no list.
+	 */
+	static constexpr std::uint32_t firing_list = expiring_list + 1;
+	/**	Marks a node on the free list.
+	 */
+	static constexpr std::uint32_t free_list = expiring_list + 2;
+	/**	The largest delay that can be placed directly.
+	 */
+	static constexpr tick_type max_delay = Levels * slot_bits >= 64 ? ~tick_type{ 0 } : (tick_type{ 1 } << (Levels * slot_bits)) - 1;
+	static constexpr unsigned chunk_bits = 10;
+	static constexpr std::size_t chunk_size = std::size_t{ 1 } << chunk_bits;
+
+	/**	A timer's callback, expiry and links.
+	 */
+	struct node final
+	{
+		callback_type m_callback;
+		tick_type m_expiry{ 0 };
+		std::uint32_t m_prev{ npos };
+		std::uint32_t m_next{ npos };
+		/**	The index of the list containing this, or one of the marker values.
+		 */
+		std::uint32_t m_list{ free_list };
+		std::uint32_t m_generation{ 1 };
+	};
+
+	node& at(const std::uint32_t index) noexcept
+	{
+		return m_chunks[index >> chunk_bits][index & (chunk_size - 1)];
+	}
+	const node& at(const std::uint32_t index) const noexcept
+	{
+		return m_chunks[index >> chunk_bits][index & (chunk_size - 1)];
+	}
+	bool valid(const handle timer) const noexcept
+	{
+		return timer.m_generation != 0 && timer.m_index < m_chunks.size() * chunk_size
+			&& at(timer.m_index).m_generation == timer.m_generation && at(timer.m_index).m_list != free_list;
+	}
+	tick_type expiry(const tick_type delay) const noexcept
+	{
+		const tick_type ticks = std::max<tick_type>(delay, 1);
+		return ticks > ~tick_type{ 0 } - m_now ? ~tick_type{ 0 } : m_now + ticks;
+	}
+	/**	Allocate another chunk of nodes and push them onto the free list.
+	 */
+	void add_chunk()
+	{
+		assert(m_chunks.size() < (npos >> chunk_bits));
+		m_chunks.push_back(std::make_unique<node[]>(chunk_size));
+		const std::uint32_t first = static_cast<std::uint32_t>((m_chunks.size() - 1) * chunk_size);
+		for (std::uint32_t i = static_cast<std::uint32_t>(chunk_size); i-- > 0; )
+		{
+			at(first + i).m_next = m_free;
+			m_free = first + i;
+		}
+	}
+	/**	Place a node in the slot for the given expiry.
+	 *	@detail Expiries beyond the wheel's span are placed in the furthest
+	 *	slot of the top level and placed again once it is reached.
+	 */
+	void insert(const std::uint32_t index, const tick_type when) noexcept
+	{
+		node& inserted = at(index);
+		inserted.m_expiry = when;
+		const tick_type delta = when > m_now ? when - m_now : 0;
+		const tick_type placed = delta > max_delay ? m_now + max_delay : when;
+		std::size_t level = 0;
+		while (level + 1 < Levels && (placed > m_now ? placed - m_now : 0) >> (slot_bits * (level + 1)) != 0)
+		{
+			++level;
+		}
+		link(index, static_cast<std::uint32_t>(level * slot_count + ((placed >> (slot_bits * level)) & slot_mask)));
+	}
+	void link(const std::uint32_t index, const std::uint32_t list) noexcept
+	{
+		node& linked = at(index);
+		linked.m_list = list;
+		linked.m_prev = npos;
+		linked.m_next = m_heads[list];
+		if (linked.m_next != npos)
+		{
+			at(linked.m_next).m_prev = index;
+		}
+		m_heads[list] = index;
+	}
+	void unlink(const std::uint32_t index) noexcept
+	{
+		node& unlinked = at(index);
+		if (unlinked.m_prev != npos)
+		{
+			at(unlinked.m_prev).m_next = unlinked.m_next;
+		}
+		else
+		{
+			m_heads[unlinked.m_list] = unlinked.m_next;
+		}
+		if (unlinked.m_next != npos)
+		{
+			at(unlinked.m_next).m_prev = unlinked.m_prev;
+		}
+	}
+	/**	Destroy a node's callback and return it to the free list. The callback must not be running.
+	 */
+	void release(const std::uint32_t index) noexcept
+	{
+		node& released = at(index);
+		assert(index != m_firing);
+		released.m_callback = nullptr;
+		released.m_list = free_list;
+		if (++released.m_generation == 0)
+		{
+			released.m_generation = 1;
+		}
+		released.m_next = m_free;
+		m_free = index;
+	}
+	/**	Move the timers in each higher-level slot reached by the current tick down the wheel.
+	 */
+	void cascade() noexcept
+	{
+		for (std::size_t level = 1; level < Levels && ((m_now >> (slot_bits * level)) << (slot_bits * level)) == m_now; ++level)
+		{
+			const std::uint32_t list = static_cast<std::uint32_t>(level * slot_count + ((m_now >> (slot_bits * level)) & slot_mask));
+			std::uint32_t index = std::exchange(m_heads[list], npos);
+			while (index != npos)
+			{
+				const std::uint32_t next = at(index).m_next;
+				insert(index, at(index).m_expiry);
+				index = next;
+			}
+		}
+	}
+	/**	Call the callbacks of the expiring list.
+	 *	@return The number of callbacks called.
+	 */
+	size_type fire()
+	{
+		size_type fired = 0;
+		while (m_heads[expiring_list] != npos)
+		{
+			const std::uint32_t index = m_heads[expiring_list];
+			node& expired = at(index);
+			unlink(index);
+			expired.m_list = firing_list;
+			--m_size;
+			m_firing = index;
+			struct finish_guard final
+			{
+				~finish_guard()
+				{
+					m_wheel.m_firing = npos;
+					if (m_wheel.at(m_index).m_list == firing_list)
+					{
+						m_wheel.release(m_index);
+					}
+				}
+
+				timer_wheel& m_wheel;
+				const std::uint32_t m_index;
+			} guard{ *this, index };
+			expired.m_callback();
+			++fired;
+		}
+		return fired;
+	}
+
+	/**	The head of each slot's list, followed by the expiring list.
+	 */
+	std::uint32_t m_heads[Levels * slot_count + 1];
+	/**	Fixed-size arrays of nodes, addressed by index.
+	 */
+	std::vector<std::unique_ptr<node[]>> m_chunks;
+	/**	The head of the free list, linked through m_next.
+	 */
+	std::uint32_t m_free{ npos };
+	/**	The node whose callback is running, if any.
+	 */
+	std::uint32_t m_firing{ npos };
+	tick_type m_now;
+	size_type m_size{ 0 };
+};
+
+} // namespace sh
+
+#endif
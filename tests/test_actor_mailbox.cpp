@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+
+#include <sh/actor_mailbox.hpp>
+#include <sh/thread_pool.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using sh::actor_mailbox;
+
+namespace
+{
+	/**	Counts destructions of non-moved-from instances.
+	 */
+	struct destruct_counter final
+	{
+		explicit destruct_counter(int& count) noexcept
+			: m_count{ &count }
+		{ }
+		destruct_counter(destruct_counter&& other) noexcept
+			: m_count{ std::exchange(other.m_count, nullptr) }
+		{ }
+		~destruct_counter()
+		{
+			if (m_count != nullptr)
+			{
+				++*m_count;
+			}
+		}
+		void operator()() const noexcept
+		{ }
+
+		int* m_count;
+	};
+
+	/**	Runs submitted tasks only when asked, on the calling thread, in submission order.
+	 */
+	struct manual_executor final
+	{
+		template <typename Callable>
+		void submit(Callable&& callable)
+		{
+			m_tasks.emplace_back(std::forward<Callable>(callable));
+		}
+		bool run_one()
+		{
+			if (m_next == m_tasks.size())
+			{
+				return false;
+			}
+			m_tasks[m_next++]();
+			return true;
+		}
+
+		std::vector<sh::inplace_move_only_function<void(), sizeof(void*) * 3>> m_tasks;
+		std::size_t m_next = 0;
+	};
+} // anonymous namespace
+
+TEST(sh_actor_mailbox, empty)
+{
+	actor_mailbox<> x;
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(x.drain(), 0u);
+}
+TEST(sh_actor_mailbox, fifo)
+{
+	actor_mailbox<> x{ 4 };
+	std::vector<int> order;
+	// Exceeds the pool, so later messages fall back to operator new.
+	for (int i = 0; i < 10; ++i)
+	{
+		x.push([&order, i]() { order.push_back(i); });
+	}
+	EXPECT_FALSE(x.empty());
+	EXPECT_EQ(x.drain(3), 3u);
+	EXPECT_EQ(order, (std::vector<int>{ 0, 1, 2 }));
+	EXPECT_EQ(x.drain(), 7u);
+	EXPECT_EQ(order, (std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+	EXPECT_TRUE(x.empty());
+	x.push([&order]() { order.push_back(10); });
+	EXPECT_EQ(x.drain(), 1u);
+	EXPECT_EQ(order.back(), 10);
+}
+TEST(sh_actor_mailbox, push_while_draining)
+{
+	actor_mailbox<> x;
+	int called = 0;
+	x.push([&x, &called]()
+	{
+		++called;
+		x.push([&called]() { ++called; });
+	});
+	EXPECT_EQ(x.drain(), 2u);
+	EXPECT_EQ(called, 2);
+}
+TEST(sh_actor_mailbox, destroys)
+{
+	int destroyed = 0;
+	{
+		actor_mailbox<> x{ 1 };
+		x.push(destruct_counter{ destroyed });
+		x.push(destruct_counter{ destroyed });
+		x.push(destruct_counter{ destroyed });
+		EXPECT_EQ(x.drain(1), 1u);
+		EXPECT_EQ(destroyed, 1);
+	}
+	EXPECT_EQ(destroyed, 3);
+}
+TEST(sh_actor_mailbox, throwing_message)
+{
+	actor_mailbox<> x;
+	int called = 0;
+	x.push([]() { throw std::runtime_error{ "message" }; });
+	x.push([&called]() { ++called; });
+	EXPECT_THROW(x.drain(), std::runtime_error);
+	EXPECT_EQ(x.drain(), 1u);
+	EXPECT_EQ(called, 1);
+}
+TEST(sh_actor_mailbox, post_schedules_once)
+{
+	manual_executor executor;
+	actor_mailbox<> x{ 64, 2 };
+	std::vector<int> order;
+	for (int i = 0; i < 5; ++i)
+	{
+		x.post(executor, [&order, i]() { order.push_back(i); });
+	}
+	EXPECT_EQ(executor.m_tasks.size(), 1u);
+	// Each drain task calls one batch, then reschedules while messages remain.
+	EXPECT_TRUE(executor.run_one());
+	EXPECT_EQ(order.size(), 2u);
+	EXPECT_TRUE(executor.run_one());
+	EXPECT_TRUE(executor.run_one());
+	EXPECT_FALSE(executor.run_one());
+	EXPECT_EQ(order, (std::vector<int>{ 0, 1, 2, 3, 4 }));
+	x.post(executor, [&order]() { order.push_back(5); });
+	EXPECT_TRUE(executor.run_one());
+	EXPECT_EQ(order.size(), 6u);
+}
+TEST(sh_actor_mailbox, concurrent_producers)
+{
+	constexpr int producers = 4;
+	constexpr int per_producer = 5000;
+	struct actor_state final
+	{
+		actor_mailbox<> m_mailbox{ 256, 32 };
+		std::vector<int> m_last = std::vector<int>(producers, -1);
+		std::atomic<int> m_received{ 0 };
+		bool m_ordered{ true };
+	};
+	// Declared first so the pool's drain tasks finish before the actors are destroyed.
+	actor_state actors[3];
+	{
+		sh::thread_pool<> pool(2);
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p)
+		{
+			threads.emplace_back([&pool, &actors, p]()
+			{
+				for (int i = 0; i < per_producer; ++i)
+				{
+					actor_state& actor = actors[i % 3];
+					actor.m_mailbox.post(pool, [&actor, p, i]()
+					{
+						// Messages from one producer arrive in order and one at a time.
+						actor.m_ordered = actor.m_ordered && actor.m_last[p] < i;
+						actor.m_last[p] = i;
+						actor.m_received.fetch_add(1, std::memory_order_release);
+					});
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+	int total = 0;
+	for (actor_state& actor : actors)
+	{
+		total += actor.m_received.load();
+		EXPECT_TRUE(actor.m_ordered);
+		EXPECT_TRUE(actor.m_mailbox.empty());
+	}
+	EXPECT_EQ(total, producers * per_producer);
+}
+TEST(sh_actor_mailbox, drains_finishing_while_posting)
+{
+	// Single-message batches on many workers end drains constantly, racing each drain's final check with posts.
+	constexpr int producers = 3;
+	constexpr int per_producer = 20000;
+	actor_mailbox<> x{ 64, 1 };
+	std::atomic<int> running{ 0 };
+	std::atomic<int> received{ 0 };
+	std::atomic<bool> overlapped{ false };
+	{
+		sh::thread_pool<> pool(4);
+		std::vector<std::thread> threads;
+		for (int p = 0; p < producers; ++p)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int i = 0; i < per_producer; ++i)
+				{
+					x.post(pool, [&]()
+					{
+						if (running.fetch_add(1, std::memory_order_relaxed) != 0)
+						{
+							overlapped.store(true, std::memory_order_relaxed);
+						}
+						received.fetch_add(1, std::memory_order_relaxed);
+						running.fetch_sub(1, std::memory_order_relaxed);
+					});
+					if (i % 64 == 0)
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		while (received.load() != producers * per_producer)
+		{
+			std::this_thread::yield();
+		}
+	}
+	EXPECT_FALSE(overlapped.load());
+	EXPECT_TRUE(x.empty());
+}
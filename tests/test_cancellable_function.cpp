@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <sh/cancellable_function.hpp>
+#include <sh/inplace_move_only_function.hpp>
+#include <sh/move_only_function.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using sh::cancel_source;
+using sh::cancel_token;
+using sh::cancellable_function;
+
+TEST(sh_cancellable_function, default_token)
+{
+	const cancel_token token;
+	EXPECT_FALSE(token.cancellable());
+	EXPECT_FALSE(token.cancelled());
+}
+TEST(sh_cancellable_function, cancel)
+{
+	cancel_source source;
+	const cancel_token before = source.token();
+	EXPECT_TRUE(before.cancellable());
+	EXPECT_FALSE(before.cancelled());
+	source.cancel();
+	EXPECT_TRUE(before.cancelled());
+	// Tokens taken afterwards form a new group.
+	const cancel_token after = source.token();
+	EXPECT_FALSE(after.cancelled());
+	source.cancel();
+	EXPECT_TRUE(after.cancelled());
+}
+TEST(sh_cancellable_function, group)
+{
+	cancel_source first;
+	cancel_source second;
+	std::vector<cancel_token> tokens;
+	for (int i = 0; i < 100; ++i)
+	{
+		tokens.push_back((i % 2 == 0 ? first : second).token());
+	}
+	first.cancel();
+	for (int i = 0; i < 100; ++i)
+	{
+		EXPECT_EQ(tokens[i].cancelled(), i % 2 == 0);
+	}
+}
+TEST(sh_cancellable_function, destroyed_source)
+{
+	cancel_token token;
+	{
+		cancel_source source;
+		token = source.token();
+	}
+	EXPECT_TRUE(token.cancelled());
+	// The entry is reused without reviving old tokens.
+	cancel_source reused;
+	EXPECT_TRUE(token.cancelled());
+	EXPECT_FALSE(reused.token().cancelled());
+}
+TEST(sh_cancellable_function, moved_source)
+{
+	cancel_source source;
+	const cancel_token token = source.token();
+	cancel_source moved{ std::move(source) };
+	EXPECT_FALSE(token.cancelled());
+	moved.cancel();
+	EXPECT_TRUE(token.cancelled());
+}
+TEST(sh_cancellable_function, call)
+{
+	cancel_source source;
+	int called = 0;
+	cancellable_function<void()> x{ source.token(), [&called]() { ++called; } };
+	EXPECT_TRUE(x);
+	x();
+	EXPECT_EQ(called, 1);
+	source.cancel();
+	EXPECT_TRUE(x.cancelled());
+	x();
+	EXPECT_EQ(called, 1);
+}
+TEST(sh_cancellable_function, result)
+{
+	cancel_source source;
+	cancellable_function<int(int), sh::inplace_move_only_function<int(int), sizeof(void*)>> x{ source.token(), [](const int value) { return value * 2; } };
+	EXPECT_EQ(x(4), 8);
+	source.cancel();
+	EXPECT_FALSE(x(4).has_value());
+}
+TEST(sh_cancellable_function, queued)
+{
+	cancel_source source;
+	int called = 0;
+	std::vector<sh::move_only_function<void()>> queue;
+	for (int i = 0; i < 3; ++i)
+	{
+		queue.emplace_back(cancellable_function<void()>{ source.token(), [&called]() { ++called; } });
+	}
+	queue.front()();
+	source.cancel();
+	for (auto& each : queue)
+	{
+		each();
+	}
+	EXPECT_EQ(called, 1);
+}
+TEST(sh_cancellable_function, concurrent)
+{
+	std::vector<cancel_source> sources(8);
+	std::vector<cancel_token> tokens;
+	for (const cancel_source& source : sources)
+	{
+		tokens.push_back(source.token());
+	}
+	std::atomic<bool> cancelled{ false };
+	std::thread checker{ [&tokens, &cancelled]()
+	{
+		while (false == cancelled.load(std::memory_order_acquire))
+		{
+			for (const cancel_token& token : tokens)
+			{
+				(void)token.cancelled();
+			}
+			cancel_source created;
+		}
+		for (const cancel_token& token : tokens)
+		{
+			EXPECT_TRUE(token.cancelled());
+		}
+	} };
+	for (cancel_source& source : sources)
+	{
+		source.cancel();
+	}
+	cancelled.store(true, std::memory_order_release);
+	checker.join();
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include <sh/coalescing_queue.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using sh::coalescing_queue;
+
+namespace
+{
+	int g_called = 0;
+	void increment() noexcept
+	{
+		++g_called;
+	}
+} // anonymous namespace
+
+TEST(sh_coalescing_queue, empty)
+{
+	coalescing_queue<void()> x;
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(x.flush(), 0u);
+	EXPECT_FALSE(x.pending(nullptr));
+}
+TEST(sh_coalescing_queue, coalesces_function_pointer)
+{
+	g_called = 0;
+	coalescing_queue<void()> x;
+	EXPECT_TRUE(x.post(&increment));
+	EXPECT_FALSE(x.post(&increment));
+	EXPECT_FALSE(x.post(&increment));
+	EXPECT_EQ(x.size(), 1u);
+	EXPECT_TRUE(x.pending(&increment));
+	EXPECT_EQ(x.flush(), 1u);
+	EXPECT_EQ(g_called, 1);
+	EXPECT_FALSE(x.pending(&increment));
+	EXPECT_TRUE(x.post(&increment));
+	EXPECT_EQ(x.flush(), 1u);
+	EXPECT_EQ(g_called, 2);
+}
+TEST(sh_coalescing_queue, order_and_arguments)
+{
+	std::vector<std::string> calls;
+	const auto a = [&calls](const std::string& value) { calls.push_back("a" + value); };
+	const auto b = [&calls](const std::string& value) { calls.push_back("b" + value); };
+	coalescing_queue<void(const std::string&)> x;
+	EXPECT_TRUE(x.post(a, "1"));
+	EXPECT_TRUE(x.post(b, "1"));
+	EXPECT_FALSE(x.post(a, "2"));
+	EXPECT_FALSE(x.post_latest(b, "2"));
+	EXPECT_EQ(x.flush(), 2u);
+	EXPECT_EQ(calls, (std::vector<std::string>{ "a1", "b2" }));
+}
+TEST(sh_coalescing_queue, keys)
+{
+	std::vector<int> calls;
+	const auto record = [&calls](const int value) { calls.push_back(value); };
+	int first_object = 0;
+	int second_object = 0;
+	coalescing_queue<void(int)> x;
+	EXPECT_TRUE(x.post_for(&first_object, record, 1));
+	EXPECT_TRUE(x.post_for(&second_object, record, 2));
+	EXPECT_FALSE(x.post_for(&first_object, record, 3));
+	EXPECT_FALSE(x.post_latest_for(&second_object, record, 4));
+	EXPECT_TRUE(x.pending(&first_object));
+	EXPECT_FALSE(x.pending(record));
+	EXPECT_EQ(x.flush(), 2u);
+	EXPECT_EQ(calls, (std::vector<int>{ 1, 4 }));
+}
+TEST(sh_coalescing_queue, post_during_flush)
+{
+	coalescing_queue<void()> x;
+	int called = 0;
+	sh::function_ptr<void()> self;
+	const auto repost = [&x, &called, &self]()
+	{
+		++called;
+		EXPECT_TRUE(x.post(self));
+		EXPECT_FALSE(x.post(self));
+	};
+	self = repost;
+	x.post(self);
+	EXPECT_EQ(x.flush(), 1u);
+	EXPECT_EQ(called, 1);
+	EXPECT_EQ(x.size(), 1u);
+	EXPECT_EQ(x.flush(), 1u);
+	EXPECT_EQ(called, 2);
+}
+TEST(sh_coalescing_queue, many_keys)
+{
+	std::vector<int> counts(1000);
+	const auto count = [&counts](const int index) { ++counts[index]; };
+	coalescing_queue<void(int)> x;
+	for (int tick = 0; tick < 3; ++tick)
+	{
+		for (int repeat = 0; repeat < 5; ++repeat)
+		{
+			for (int i = 0; i < 1000; ++i)
+			{
+				x.post_for(&counts[i], count, i);
+			}
+		}
+		EXPECT_EQ(x.size(), 1000u);
+		EXPECT_EQ(x.flush(), 1000u);
+	}
+	for (const int each : counts)
+	{
+		EXPECT_EQ(each, 3);
+	}
+}
+TEST(sh_coalescing_queue, throwing_callback)
+{
+	std::vector<int> calls;
+	const auto record = [&calls](const int value) { calls.push_back(value); };
+	coalescing_queue<void(int)> x;
+	int keys[3];
+	const auto thrower = [&x, &keys, &record](int)
+	{
+		x.post_for(&keys[2], record, 5);
+		x.post_for(&keys[1], record, 6);
+		throw std::runtime_error{ "callback" };
+	};
+	x.post_for(&keys[0], thrower, 0);
+	x.post_for(&keys[1], record, 1);
+	x.post_for(&keys[2], record, 2);
+	EXPECT_THROW(x.flush(), std::runtime_error);
+	// Uncalled entries keep their place and arguments ahead of those posted since.
+	EXPECT_EQ(x.size(), 2u);
+	EXPECT_EQ(x.flush(), 2u);
+	EXPECT_EQ(calls, (std::vector<int>{ 1, 2 }));
+}
+TEST(sh_coalescing_queue, throwing_callback_latest)
+{
+	std::vector<int> calls;
+	const auto record = [&calls](const int value) { calls.push_back(value); };
+	coalescing_queue<void(int)> x;
+	int keys[3];
+	const auto thrower = [&x, &keys, &record](int)
+	{
+		x.post_latest_for(&keys[1], record, 5);
+		x.post_for(&keys[2], record, 6);
+		throw std::runtime_error{ "callback" };
+	};
+	x.post_for(&keys[0], thrower, 0);
+	x.post_for(&keys[1], record, 1);
+	x.post_for(&keys[2], record, 2);
+	EXPECT_THROW(x.flush(), std::runtime_error);
+	// Latest-wins posts made during the flush still replace the restored arguments, in place.
+	EXPECT_EQ(x.size(), 2u);
+	EXPECT_EQ(x.flush(), 2u);
+	EXPECT_EQ(calls, (std::vector<int>{ 5, 2 }));
+}
+TEST(sh_coalescing_queue, clear)
+{
+	g_called = 0;
+	coalescing_queue<void()> x{ 8 };
+	x.post(&increment);
+	x.clear();
+	EXPECT_TRUE(x.empty());
+	EXPECT_FALSE(x.pending(&increment));
+	EXPECT_EQ(x.flush(), 0u);
+	EXPECT_EQ(g_called, 0);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <sh/combiner.hpp>
+
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using sh::combiner;
+
+TEST(sh_combiner, apply)
+{
+	combiner<int> x{ 5 };
+	x.apply([](int& state) { state += 2; });
+	EXPECT_EQ(x.unsafe_state(), 7);
+}
+TEST(sh_combiner, execute)
+{
+	combiner<std::vector<int>> x;
+	EXPECT_EQ(x.execute([](std::vector<int>& state) { state.push_back(1); return state.size(); }), 1u);
+	x.execute([](std::vector<int>& state) { state.push_back(2); });
+	EXPECT_EQ(x.unsafe_state(), (std::vector<int>{ 1, 2 }));
+}
+TEST(sh_combiner, execute_reference)
+{
+	combiner<std::vector<int>> x{ std::vector<int>{ 1, 2 } };
+	int& back = x.execute([](std::vector<int>& state) -> int& { return state.back(); });
+	EXPECT_EQ(&back, &x.unsafe_state().back());
+	std::vector<int>&& moved = x.execute([](std::vector<int>& state) -> std::vector<int>&& { return std::move(state); });
+	EXPECT_EQ(&moved, &x.unsafe_state());
+}
+TEST(sh_combiner, exception)
+{
+	combiner<int> x;
+	EXPECT_THROW(x.apply([](int&) { throw std::runtime_error{ "operation" }; }), std::runtime_error);
+	// The slot and lock are released afterwards.
+	x.apply([](int& state) { ++state; });
+	EXPECT_EQ(x.unsafe_state(), 1);
+}
+TEST(sh_combiner, contended)
+{
+	constexpr int thread_count = 8;
+	constexpr int per_thread = 20000;
+	// Fewer slots than threads also exercises applying directly.
+	for (const std::size_t slot_count : { std::size_t{ 0 }, std::size_t{ 2 } })
+	{
+		combiner<std::vector<int>> x{ std::vector<int>(thread_count, 0), slot_count };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < thread_count; ++t)
+		{
+			threads.emplace_back([&x, t]()
+			{
+				for (int i = 0; i < per_thread; ++i)
+				{
+					const int previous = x.execute([t](std::vector<int>& state) { return state[t]++; });
+					EXPECT_EQ(previous, i);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		EXPECT_EQ(x.unsafe_state(), std::vector<int>(thread_count, per_thread));
+	}
+}
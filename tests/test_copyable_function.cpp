@@ -2,6 +2,9 @@
 
 #include <sh/copyable_function.hpp>
 
+#include <array>
+#include <cstdint>
+
 using sh::copyable_function;
 
 namespace
@@ -113,6 +116,34 @@ TEST(sh_copyable_function, assign)
 	ASSERT_NE(x, nullptr);
 	ASSERT_EQ(x(), 'x');
 }
+TEST(sh_copyable_function, assign_copy)
+{
+	int small_value = 0, large_value = 0;
+	{
+		const copyable_function<char()> small([c = counter(&small_value)]() { return 's'; });
+		// Too large to store in-place, so copied through the heap.
+		const copyable_function<char()> large([c = counter(&large_value), padding = std::array<char, 64>{}]() { return 'l'; });
+		EXPECT_EQ(small_value, 1);
+		EXPECT_EQ(large_value, 1);
+
+		copyable_function<char()> x;
+		x = small;
+		EXPECT_EQ(x(), 's');
+		EXPECT_EQ(small_value, 2);
+		x = large;
+		EXPECT_EQ(x(), 'l');
+		EXPECT_EQ(small_value, 1);
+		EXPECT_EQ(large_value, 2);
+		const copyable_function<char()> y(x);
+		EXPECT_EQ(y(), 'l');
+		EXPECT_EQ(large_value, 3);
+		x = x;
+		EXPECT_EQ(x(), 'l');
+		EXPECT_EQ(large_value, 3);
+	}
+	EXPECT_EQ(small_value, 0);
+	EXPECT_EQ(large_value, 0);
+}
 TEST(sh_copyable_function, assign_nullptr)
 {
 	int value = 0;
@@ -296,3 +327,18 @@ TEST(sh_copyable_function, lambda_mutable)
 	ASSERT_NE(x, nullptr);
 	EXPECT_EQ(x(0), 3);
 }
+TEST(sh_copyable_function, lambda_overaligned)
+{
+	struct alignas(16) aligned_value
+	{
+		int m_value;
+	};
+	auto plus_value = [value = aligned_value{ 5 }](const int input) -> int
+	{
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&value) % alignof(aligned_value), 0u);
+		return input + value.m_value;
+	};
+	static_assert(sizeof(plus_value) <= sh::detail::copyable_function_storage::capacity, "lambda_overaligned test isn't storing a callable that fits but for alignment.");
+	copyable_function<int(int)> x(std::move(plus_value));
+	EXPECT_EQ(x(1), 6);
+}
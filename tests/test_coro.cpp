@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <sh/coro.hpp>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <sh/move_only_function.hpp>
+#include <sh/thread_pool.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using sh::task;
+
+namespace
+{
+	task<int> value(const int result)
+	{
+		co_return result;
+	}
+	task<int> sum(const int count)
+	{
+		int total = 0;
+		for (int i = 1; i <= count; ++i)
+		{
+			total += co_await value(i);
+		}
+		co_return total;
+	}
+	task<void> fail()
+	{
+		throw std::runtime_error{ "task" };
+		co_return;
+	}
+
+	/**	Queues submitted callables and runs them only when asked, on the calling thread.
+	 */
+	struct legacy_executor final
+	{
+		void execute(sh::move_only_function<void()> callable)
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			m_queue.push_back(std::move(callable));
+		}
+		bool run_one()
+		{
+			sh::move_only_function<void()> next;
+			{
+				const std::lock_guard<std::mutex> lock{ m_mutex };
+				if (m_queue.empty())
+				{
+					return false;
+				}
+				next = std::move(m_queue.front());
+				m_queue.erase(m_queue.begin());
+			}
+			next();
+			return true;
+		}
+
+		std::mutex m_mutex;
+		std::vector<sh::move_only_function<void()>> m_queue;
+	};
+} // anonymous namespace
+
+TEST(sh_coro, lazy)
+{
+	bool started = false;
+	auto make = [&started]() -> task<int>
+	{
+		started = true;
+		co_return 7;
+	};
+	task<int> x = make();
+	EXPECT_TRUE(x);
+	EXPECT_FALSE(started);
+	EXPECT_EQ(sh::sync_wait(std::move(x)), 7);
+	EXPECT_TRUE(started);
+}
+TEST(sh_coro, nested)
+{
+	EXPECT_EQ(sh::sync_wait(sum(100)), 5050);
+}
+TEST(sh_coro, long_chain)
+{
+	// Each synchronous completion resumes the awaiter by symmetric transfer.
+	EXPECT_EQ(sh::sync_wait(sum(10000)), 50005000);
+}
+TEST(sh_coro, exception)
+{
+	EXPECT_THROW(sh::sync_wait(fail()), std::runtime_error);
+	auto catcher = []() -> task<bool>
+	{
+		try
+		{
+			co_await fail();
+		}
+		catch (const std::runtime_error&)
+		{
+			co_return true;
+		}
+		co_return false;
+	};
+	EXPECT_TRUE(sh::sync_wait(catcher()));
+}
+TEST(sh_coro, move_only_result)
+{
+	auto make = []() -> task<std::unique_ptr<int>>
+	{
+		co_return std::make_unique<int>(3);
+	};
+	EXPECT_EQ(*sh::sync_wait(make()), 3);
+}
+TEST(sh_coro, schedule_on_thread_pool)
+{
+	sh::thread_pool<> pool(2);
+	const auto caller = std::this_thread::get_id();
+	auto hop = [&pool, caller]() -> task<bool>
+	{
+		co_await sh::schedule_on(pool);
+		co_return std::this_thread::get_id() != caller;
+	};
+	EXPECT_TRUE(sh::sync_wait(hop()));
+}
+TEST(sh_coro, spawn)
+{
+	sh::thread_pool<> pool(2);
+	std::atomic<int> finished{ 0 };
+	auto work = [&finished]() -> task<void>
+	{
+		finished.fetch_add(co_await value(1));
+	};
+	for (int i = 0; i < 100; ++i)
+	{
+		sh::spawn(pool, work());
+	}
+	while (finished.load() != 100)
+	{
+		std::this_thread::yield();
+	}
+}
+TEST(sh_coro, coroutine_executor)
+{
+	legacy_executor legacy;
+	sh::coroutine_executor executor{ [&legacy](sh::move_only_function<void()> callable) { legacy.execute(std::move(callable)); } };
+	int step = 0;
+	auto steps = [&executor, &step]() -> task<void>
+	{
+		step = 1;
+		co_await executor.schedule();
+		step = 2;
+		co_await sh::schedule_on(executor);
+		step = 3;
+	};
+	sh::spawn(executor, steps());
+	EXPECT_EQ(step, 0);
+	EXPECT_TRUE(legacy.run_one());
+	EXPECT_EQ(step, 1);
+	EXPECT_TRUE(legacy.run_one());
+	EXPECT_EQ(step, 2);
+	EXPECT_TRUE(legacy.run_one());
+	EXPECT_EQ(step, 3);
+	EXPECT_FALSE(legacy.run_one());
+}
+TEST(sh_coro, frame_pool)
+{
+	sh::coroutine_frame_pool::trim();
+	void* const first = sh::coroutine_frame_pool::allocate(100);
+	sh::coroutine_frame_pool::deallocate(first, 100);
+	// Sizes within the same class reuse the cached frame.
+	void* const second = sh::coroutine_frame_pool::allocate(120);
+	EXPECT_EQ(first, second);
+	sh::coroutine_frame_pool::deallocate(second, 120);
+	void* const large = sh::coroutine_frame_pool::allocate(sh::coroutine_frame_pool::granularity * sh::coroutine_frame_pool::class_count + 1);
+	sh::coroutine_frame_pool::deallocate(large, sh::coroutine_frame_pool::granularity * sh::coroutine_frame_pool::class_count + 1);
+	sh::coroutine_frame_pool::trim();
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <sh/function_bulk.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using sh::function_bulk_builder;
+using sh::make_functions_bulk;
+using sh::make_functions_bulk_n;
+
+namespace
+{
+	/**	An oversized closure that reports its own address and counts its destructions.
+	 */
+	struct oversized final
+	{
+		oversized(const int value, std::shared_ptr<int> destroyed) noexcept
+			: m_value{ value }
+			, m_destroyed{ std::move(destroyed) }
+		{ }
+		oversized(const oversized&) = default;
+		oversized(oversized&&) noexcept = default;
+		~oversized()
+		{
+			if (m_destroyed)
+			{
+				++*m_destroyed;
+			}
+		}
+		std::uintptr_t operator()(int) const noexcept
+		{
+			return reinterpret_cast<std::uintptr_t>(this);
+		}
+
+		int m_value;
+		std::shared_ptr<int> m_destroyed;
+		char m_padding[40]{};
+	};
+} // anonymous namespace
+
+TEST(sh_function_bulk, contiguous)
+{
+	auto destroyed = std::make_shared<int>(0);
+	{
+		const auto functions = make_functions_bulk_n<std::uintptr_t(int)>(1000, [&destroyed](const std::size_t i)
+		{
+			return oversized{ static_cast<int>(i), destroyed };
+		});
+		ASSERT_EQ(functions.size(), 1000u);
+		// Factory results are moved into the block, leaving nothing to count.
+		EXPECT_EQ(*destroyed, 0);
+		const std::uintptr_t first = functions[0](0);
+		const std::uintptr_t stride = functions[1](0) - first;
+		EXPECT_GE(stride, sizeof(oversized));
+		for (std::size_t i = 0; i < functions.size(); ++i)
+		{
+			EXPECT_EQ(functions[i](0), first + i * stride);
+		}
+	}
+	EXPECT_EQ(*destroyed, 1000);
+}
+TEST(sh_function_bulk, heterogeneous)
+{
+	const std::string long_string(100, 'x');
+	auto functions = make_functions_bulk<std::size_t()>(
+		[long_string]() { return long_string.size(); },
+		[]() { return std::size_t{ 7 }; },
+		[a = std::array<std::size_t, 8>{ 1, 2, 3, 4, 5, 6, 7, 8 }]() { return a[7]; });
+	EXPECT_EQ(functions[0](), 100u);
+	EXPECT_EQ(functions[1](), 7u);
+	EXPECT_EQ(functions[2](), 8u);
+}
+TEST(sh_function_bulk, outlives_builder_and_shares_on_copy)
+{
+	auto token = std::make_shared<int>(0);
+	sh::copyable_function<int()> copy;
+	{
+		int calls = 0;
+		auto counting = [calls]() mutable { return ++calls; };
+		auto holding = [token]() { return *token; };
+		function_bulk_builder<int()> builder;
+		builder.reserve<decltype(counting)>();
+		builder.reserve<decltype(holding)>();
+		EXPECT_GE(builder.reserved(), sizeof(counting) + sizeof(holding));
+		auto counter = builder.emplace(counting);
+		EXPECT_EQ(counter(), 1);
+		copy = counter;
+		// Copies refer to the same closure.
+		EXPECT_EQ(copy(), 2);
+		EXPECT_EQ(counter(), 3);
+		auto holder = builder.emplace(std::move(holding));
+		EXPECT_EQ(token.use_count(), 2);
+	}
+	// The block, including the other closure, persists while any function refers to it.
+	EXPECT_EQ(token.use_count(), 2);
+	EXPECT_EQ(copy(), 4);
+	copy = nullptr;
+	EXPECT_EQ(token.use_count(), 1);
+}
+TEST(sh_function_bulk, capacity_exceeded)
+{
+	function_bulk_builder<int()> builder;
+	builder.reserve<int(*)()>(1);
+	auto first = builder.emplace(+[]() { return 1; });
+	EXPECT_THROW(builder.emplace(+[]() { return 2; }), std::length_error);
+	EXPECT_EQ(first(), 1);
+}
+TEST(sh_function_bulk, empty_builder)
+{
+	function_bulk_builder<void()> builder;
+	EXPECT_EQ(builder.reserved(), 0u);
+	EXPECT_THROW(builder.emplace([]() {}), std::length_error);
+}
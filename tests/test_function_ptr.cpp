@@ -265,3 +265,14 @@ TEST(sh_function_ptr, swap_noexcept)
 	y(param);
 	ASSERT_EQ(param, 0);
 }
+TEST(sh_function_ptr, target_address)
+{
+	const auto inc = [](int& arg) { ++arg; };
+
+	function_ptr<void(int&)> x;
+	EXPECT_EQ(x.target_address(), nullptr);
+	x = inc;
+	EXPECT_EQ(x.target_address(), &inc);
+	function_ptr<void(int&)> y(inc);
+	EXPECT_EQ(x.target_address(), y.target_address());
+}
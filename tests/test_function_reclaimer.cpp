@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <sh/function_reclaimer.hpp>
+#include <sh/move_only_function.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using sh::deferred_move_only_function;
+using sh::function_reclaimer;
+
+namespace
+{
+	/**	Records the thread that destroys it.
+	 */
+	struct destroyed_on final
+	{
+		explicit destroyed_on(std::atomic<int>& count, std::thread::id& thread) noexcept
+			: m_count{ &count }
+			, m_thread{ &thread }
+		{ }
+		destroyed_on(destroyed_on&& other) noexcept
+			: m_count{ std::exchange(other.m_count, nullptr) }
+			, m_thread{ other.m_thread }
+		{ }
+		~destroyed_on()
+		{
+			if (m_count != nullptr)
+			{
+				*m_thread = std::this_thread::get_id();
+				m_count->fetch_add(1);
+			}
+		}
+		void operator()() const noexcept
+		{ }
+
+		std::atomic<int>* m_count;
+		std::thread::id* m_thread;
+	};
+} // anonymous namespace
+
+TEST(sh_function_reclaimer, retire)
+{
+	std::atomic<int> destroyed{ 0 };
+	std::thread::id thread;
+	function_reclaimer x;
+	sh::move_only_function<void()> f = destroyed_on{ destroyed, thread };
+	x.retire(std::move(f));
+	EXPECT_FALSE(f);
+	EXPECT_EQ(destroyed.load(), 0);
+	x.synchronize();
+	EXPECT_EQ(destroyed.load(), 1);
+	EXPECT_NE(thread, std::this_thread::get_id());
+}
+TEST(sh_function_reclaimer, heap_target)
+{
+	function_reclaimer x;
+	auto shared = std::make_shared<int>(1);
+	std::array<char, 256> large{};
+	sh::move_only_function<int()> f = [shared, large]() { return *shared + large[0]; };
+	EXPECT_EQ(shared.use_count(), 2);
+	x.retire(std::move(f));
+	x.synchronize();
+	EXPECT_EQ(shared.use_count(), 1);
+}
+TEST(sh_function_reclaimer, batches)
+{
+	std::atomic<int> destroyed{ 0 };
+	std::thread::id thread;
+	function_reclaimer x;
+	const int count = static_cast<int>(function_reclaimer::batch_size) * 3 + 5;
+	for (int i = 0; i < count; ++i)
+	{
+		x.retire(sh::move_only_function<void()>{ destroyed_on{ destroyed, thread } });
+	}
+	x.synchronize();
+	EXPECT_EQ(destroyed.load(), count);
+}
+TEST(sh_function_reclaimer, threads)
+{
+	std::atomic<int> destroyed{ 0 };
+	std::thread::id thread;
+	{
+		function_reclaimer x;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&x, &destroyed, &thread]()
+			{
+				for (int i = 0; i < 1000; ++i)
+				{
+					x.retire(sh::move_only_function<void()>{ destroyed_on{ destroyed, thread } });
+				}
+				x.flush();
+			});
+		}
+		for (std::thread& each : threads)
+		{
+			each.join();
+		}
+	}
+	EXPECT_EQ(destroyed.load(), 4000);
+}
+TEST(sh_function_reclaimer, deferred_move_only_function)
+{
+	std::atomic<int> destroyed{ 0 };
+	std::thread::id thread;
+	{
+		deferred_move_only_function<void()> f = destroyed_on{ destroyed, thread };
+		f();
+		deferred_move_only_function<void()> g;
+		g = std::move(f);
+		EXPECT_FALSE(f);
+		EXPECT_TRUE(g);
+		g = destroyed_on{ destroyed, thread };
+		g = nullptr;
+		EXPECT_FALSE(g);
+		f = destroyed_on{ destroyed, thread };
+	}
+	function_reclaimer::instance().synchronize();
+	EXPECT_EQ(destroyed.load(), 3);
+	EXPECT_NE(thread, std::this_thread::get_id());
+}
+TEST(sh_function_reclaimer, retire_then_exit)
+{
+	// The main thread's batch is destroyed before the static reclaimer, which must not then touch it.
+	::testing::FLAGS_gtest_death_test_style = "threadsafe";
+	EXPECT_EXIT(
+	{
+		deferred_move_only_function<int()> function{ [value = std::make_unique<int>(1)]() { return *value; } };
+		function = nullptr;
+		std::exit(function == nullptr ? 0 : 1);
+	}, ::testing::ExitedWithCode(0), "");
+}
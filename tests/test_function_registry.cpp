@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <sh/function_registry.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+
+using sh::function_registry;
+
+namespace
+{
+	int g_total = 0;
+	void add_to_total(const int value)
+	{
+		g_total += value;
+	}
+
+	struct point final
+	{
+		std::int32_t x;
+		std::int32_t y;
+	};
+} // anonymous namespace
+
+TEST(sh_function_registry, id_of)
+{
+	static_assert(function_registry::id_of("") == 2166136261u);
+	static_assert(function_registry::id_of("a") == 0xe40c292cu);
+	EXPECT_NE(function_registry::id_of("add"), function_registry::id_of("sub"));
+}
+TEST(sh_function_registry, function_pointer)
+{
+	g_total = 0;
+	function_registry x;
+	x.add<int>(1, &add_to_total);
+	EXPECT_TRUE(x.contains(1));
+	EXPECT_FALSE(x.contains(2));
+	EXPECT_EQ(x.argument_size(1), sizeof(int));
+	const int value = 5;
+	x.invoke(1, &value, sizeof(value));
+	x.invoke(1, &value, sizeof(value));
+	EXPECT_EQ(g_total, 10);
+}
+TEST(sh_function_registry, lambdas)
+{
+	g_total = 0;
+	function_registry x;
+	x.add(function_registry::id_of("reset"), []() { g_total = 0; });
+	x.add<point>(function_registry::id_of("area"), [](const point& p) { g_total = p.x * p.y; });
+	EXPECT_EQ(x.size(), 2u);
+	EXPECT_EQ(x.argument_size(function_registry::id_of("reset")), 0u);
+	// Unaligned bytes are accepted.
+	unsigned char bytes[sizeof(point) + 1];
+	const point p{ 3, 4 };
+	std::memcpy(bytes + 1, &p, sizeof(p));
+	x.invoke(function_registry::id_of("area"), bytes + 1, sizeof(point));
+	EXPECT_EQ(g_total, 12);
+	x.invoke(function_registry::id_of("reset"), nullptr, 0);
+	EXPECT_EQ(g_total, 0);
+}
+TEST(sh_function_registry, errors)
+{
+	function_registry x;
+	x.add<int>(7, &add_to_total);
+	EXPECT_THROW(x.add(7, []() {}), std::invalid_argument);
+	EXPECT_THROW(x.invoke(8, nullptr, 0), std::out_of_range);
+	EXPECT_THROW(x.argument_size(8), std::out_of_range);
+	const std::int64_t wide = 1;
+	EXPECT_THROW(x.invoke(7, &wide, sizeof(wide)), std::invalid_argument);
+}
+TEST(sh_function_registry, sorted_lookup)
+{
+	g_total = 0;
+	function_registry x;
+	for (std::uint32_t id = 100; id-- > 0; )
+	{
+		x.add<int>(id * 7919u, &add_to_total);
+	}
+	for (std::uint32_t id = 0; id < 100; ++id)
+	{
+		const int value = 1;
+		x.invoke(id * 7919u, &value, sizeof(value));
+	}
+	EXPECT_EQ(g_total, 100);
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include <sh/future.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using sh::future;
+using sh::promise;
+
+namespace
+{
+	/**	Counts destructions of non-moved-from instances.
+	 */
+	struct destruct_counter final
+	{
+		explicit destruct_counter(int& count) noexcept
+			: m_count{ &count }
+		{ }
+		destruct_counter(destruct_counter&& other) noexcept
+			: m_count{ std::exchange(other.m_count, nullptr) }
+		{ }
+		~destruct_counter()
+		{
+			if (m_count != nullptr)
+			{
+				++*m_count;
+			}
+		}
+
+		int* m_count;
+	};
+} // anonymous namespace
+
+TEST(sh_future, get)
+{
+	promise<int> p;
+	future<int> f = p.get_future();
+	EXPECT_TRUE(f.valid());
+	EXPECT_FALSE(f.is_ready());
+	p.set_value(5);
+	EXPECT_TRUE(f.is_ready());
+	EXPECT_EQ(f.get(), 5);
+	EXPECT_FALSE(f.valid());
+}
+TEST(sh_future, then_before_value)
+{
+	promise<std::string> p;
+	std::string received;
+	p.get_future().then([&received](std::string&& value) { received = std::move(value); });
+	EXPECT_TRUE(received.empty());
+	p.set_value("value");
+	EXPECT_EQ(received, "value");
+}
+TEST(sh_future, then_after_value)
+{
+	promise<std::unique_ptr<int>> p;
+	future<std::unique_ptr<int>> f = p.get_future();
+	p.set_value(std::make_unique<int>(9));
+	int received = 0;
+	f.then([&received](std::unique_ptr<int>&& value) { received = *value; });
+	EXPECT_EQ(received, 9);
+}
+TEST(sh_future, chained)
+{
+	promise<int> first;
+	promise<int> second;
+	future<int> result = second.get_future();
+	// A promise is one pointer, so capturing it fits the continuation storage.
+	first.get_future().then([next = std::move(second)](int&& value) mutable { next.set_value(value * 2); });
+	first.set_value(21);
+	EXPECT_EQ(result.get(), 42);
+}
+TEST(sh_future, broken)
+{
+	future<int> f;
+	{
+		promise<int> p;
+		f = p.get_future();
+	}
+	EXPECT_THROW(f.get(), sh::broken_promise);
+	bool called = false;
+	{
+		promise<int> p;
+		p.get_future().then([&called](int&&) { called = true; });
+	}
+	EXPECT_FALSE(called);
+}
+TEST(sh_future, discarded)
+{
+	int destroyed = 0;
+	{
+		promise<destruct_counter> p;
+		p.set_value(destroyed);
+	}
+	EXPECT_EQ(destroyed, 1);
+	{
+		promise<destruct_counter> p;
+		p.get_future();
+		p.set_value(destroyed);
+	}
+	EXPECT_EQ(destroyed, 2);
+	{
+		promise<int> p;
+	}
+}
+TEST(sh_future, cross_thread_get)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+		promise<int> p;
+		future<int> f = p.get_future();
+		std::thread producer{ [&p, i]() { p.set_value(i); } };
+		EXPECT_EQ(f.get(), i);
+		producer.join();
+	}
+}
+TEST(sh_future, cross_thread_then)
+{
+	std::atomic<int> total{ 0 };
+	for (int i = 0; i < 1000; ++i)
+	{
+		promise<int> p;
+		future<int> f = p.get_future();
+		std::thread producer{ [p = std::move(p), i]() mutable { p.set_value(i); } };
+		f.then([&total](int&& value) { total.fetch_add(value); });
+		producer.join();
+	}
+	EXPECT_EQ(total.load(), 999 * 1000 / 2);
+}
+TEST(sh_future, pool)
+{
+	sh::future_pool<int> pool{ 2 };
+	std::vector<int> received;
+	for (int i = 0; i < 10; ++i)
+	{
+		promise<int> p{ pool };
+		p.get_future().then([&received](int&& value) { received.push_back(value); });
+		p.set_value(i);
+	}
+	EXPECT_EQ(received, (std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+	promise<int> p{ pool };
+	future<int> f = p.get_future();
+	p.set_value(1);
+	EXPECT_EQ(f.get(), 1);
+}
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <sh/intrusive_task.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using sh::intrusive_task;
+using sh::intrusive_task_forward_list;
+using sh::intrusive_task_list;
+using sh::intrusive_task_queue;
+using sh::intrusive_task_stack;
+
+namespace
+{
+	using task = intrusive_task<void(std::vector<int>&)>;
+
+	/**	Pop and call every task of a container, recording their order.
+	 *	@param container The container.
+	 *	@return The values the tasks recorded.
+	 *	@tparam Container A list with pop_front.
+	 */
+	template <typename Container>
+	std::vector<int> run_all(Container& container)
+	{
+		std::vector<int> order;
+		while (task* const popped = container.pop_front())
+		{
+			(*popped)(order);
+		}
+		return order;
+	}
+} // anonymous namespace
+
+TEST(sh_intrusive_task, call_and_reassign)
+{
+	auto value = std::make_unique<int>(3);
+	intrusive_task<int(int)> x{ [value = std::move(value)](const int arg) { return *value + arg; } };
+	EXPECT_TRUE(static_cast<bool>(x));
+	EXPECT_EQ(x(4), 7);
+	x = [](const int arg) { return arg * 2; };
+	EXPECT_EQ(x(4), 8);
+	x = nullptr;
+	EXPECT_FALSE(static_cast<bool>(x));
+	static_assert(sizeof(intrusive_task<void(), 32>) <= 2 * sizeof(void*) + sizeof(void*) + 32);
+}
+TEST(sh_intrusive_task, forward_list)
+{
+	task a{ [](std::vector<int>& out) { out.push_back(1); } };
+	task b{ [](std::vector<int>& out) { out.push_back(2); } };
+	task c{ [](std::vector<int>& out) { out.push_back(3); } };
+	intrusive_task_forward_list<task> x;
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(x.pop_front(), nullptr);
+	x.push_back(b);
+	x.push_back(c);
+	x.push_front(a);
+	EXPECT_EQ(x.size(), 3u);
+	EXPECT_EQ(x.front(), &a);
+	EXPECT_EQ(run_all(x), (std::vector<int>{ 1, 2, 3 }));
+	EXPECT_TRUE(x.empty());
+
+	intrusive_task_forward_list<task> y;
+	x.push_back(a);
+	y.push_back(b);
+	y.push_back(c);
+	x.splice_back(y);
+	EXPECT_TRUE(y.empty());
+	EXPECT_EQ(x.size(), 3u);
+	EXPECT_EQ(run_all(x), (std::vector<int>{ 1, 2, 3 }));
+}
+TEST(sh_intrusive_task, list)
+{
+	task tasks[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		tasks[i] = [i](std::vector<int>& out) { out.push_back(i); };
+	}
+	intrusive_task_list<task> x;
+	x.push_back(tasks[1]);
+	x.push_back(tasks[2]);
+	x.push_front(tasks[0]);
+	x.push_back(tasks[3]);
+	EXPECT_EQ(x.back(), &tasks[3]);
+	x.erase(tasks[2]);
+	x.erase(tasks[0]);
+	EXPECT_EQ(x.size(), 2u);
+	EXPECT_EQ(x.front(), &tasks[1]);
+	EXPECT_EQ(x.pop_back(), &tasks[3]);
+	x.push_front(tasks[2]);
+	EXPECT_EQ(run_all(x), (std::vector<int>{ 2, 1 }));
+	x.push_back(tasks[0]);
+	x.erase(tasks[0]);
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(x.back(), nullptr);
+}
+TEST(sh_intrusive_task, stack)
+{
+	task a{ [](std::vector<int>& out) { out.push_back(1); } };
+	task b{ [](std::vector<int>& out) { out.push_back(2); } };
+	intrusive_task_stack<task> x;
+	EXPECT_TRUE(x.empty());
+	x.push(a);
+	x.push(b);
+	EXPECT_FALSE(x.empty());
+	auto popped = x.pop_all();
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(run_all(popped), (std::vector<int>{ 1, 2 }));
+}
+TEST(sh_intrusive_task, stack_concurrent)
+{
+	constexpr int per_thread = 10000;
+	std::vector<intrusive_task<void()>> tasks(4 * per_thread);
+	std::atomic<int> called{ 0 };
+	intrusive_task_stack<intrusive_task<void()>> x;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&tasks, &called, &x, t]()
+		{
+			for (int i = 0; i < per_thread; ++i)
+			{
+				auto& pushed = tasks[t * per_thread + i];
+				pushed = [&called]() { called.fetch_add(1, std::memory_order_relaxed); };
+				x.push(pushed);
+			}
+		});
+	}
+	int drained = 0;
+	while (drained != 4 * per_thread)
+	{
+		auto popped = x.pop_all();
+		while (auto* const each = popped.pop_front())
+		{
+			(*each)();
+			++drained;
+		}
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(called.load(), 4 * per_thread);
+}
+TEST(sh_intrusive_task, queue)
+{
+	task a{ [](std::vector<int>& out) { out.push_back(1); } };
+	task b{ [](std::vector<int>& out) { out.push_back(2); } };
+	intrusive_task_queue<task> x;
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(x.try_pop(), nullptr);
+	x.push(a);
+	EXPECT_FALSE(x.empty());
+	EXPECT_EQ(x.try_pop(), &a);
+	EXPECT_TRUE(x.empty());
+	// Nodes may be pushed again once popped.
+	x.push(b);
+	x.push(a);
+	std::vector<int> order;
+	while (task* const popped = x.try_pop())
+	{
+		(*popped)(order);
+	}
+	EXPECT_EQ(order, (std::vector<int>{ 2, 1 }));
+}
+TEST(sh_intrusive_task, queue_concurrent)
+{
+	constexpr int per_thread = 20000;
+	constexpr int producers = 3;
+	std::vector<task> tasks(producers * per_thread);
+	intrusive_task_queue<task> x;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < producers; ++t)
+	{
+		threads.emplace_back([&tasks, &x, t]()
+		{
+			for (int i = 0; i < per_thread; ++i)
+			{
+				task& pushed = tasks[t * per_thread + i];
+				pushed = [t, i](std::vector<int>& last) { EXPECT_EQ(last[t] + 1, i); last[t] = i; };
+				x.push(pushed);
+			}
+		});
+	}
+	std::vector<int> last(producers, -1);
+	int popped = 0;
+	while (popped != producers * per_thread)
+	{
+		if (task* const each = x.try_pop())
+		{
+			(*each)(last);
+			++popped;
+		}
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(last, std::vector<int>(producers, per_thread - 1));
+}
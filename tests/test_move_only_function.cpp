@@ -2,6 +2,7 @@
 
 #include <sh/move_only_function.hpp>
 
+#include <cstdint>
 #include <memory>
 
 using sh::move_only_function;
@@ -608,3 +609,18 @@ TEST(sh_move_only_function, lambda_large)
 	ASSERT_NE(x, nullptr);
 	EXPECT_EQ(x(0), 1);
 }
+TEST(sh_move_only_function, lambda_overaligned)
+{
+	struct alignas(16) aligned_value
+	{
+		int m_value;
+	};
+	auto plus_value = [value = aligned_value{ 5 }](const int input) -> int
+	{
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&value) % alignof(aligned_value), 0u);
+		return input + value.m_value;
+	};
+	static_assert(sizeof(plus_value) <= sh::detail::move_only_function_storage::capacity, "lambda_overaligned test isn't storing a callable that fits but for alignment.");
+	move_only_function<int(int)> x(std::move(plus_value));
+	EXPECT_EQ(x(1), 6);
+}
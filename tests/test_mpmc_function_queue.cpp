@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <sh/mpmc_function_queue.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using sh::mpmc_function_queue;
+
+namespace
+{
+	struct counter final
+	{
+		int* m_value;
+
+		counter(int* const value)
+			: m_value(value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		~counter()
+		{
+			if (m_value != nullptr)
+			{
+				--(*m_value);
+			}
+		}
+		counter(const counter& other)
+			: m_value(other.m_value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		counter(counter&& other) noexcept
+			: m_value(std::exchange(other.m_value, nullptr))
+		{ }
+		counter& operator=(const counter&) = delete;
+		counter& operator=(counter&&) = delete;
+	};
+
+	struct throw_on_copy final
+	{
+		throw_on_copy() = default;
+		throw_on_copy(const throw_on_copy&)
+		{
+			throw std::runtime_error("copy");
+		}
+		throw_on_copy(throw_on_copy&&) noexcept = default;
+
+		void operator()() const
+		{ }
+	};
+} // anonymous namespace
+
+TEST(sh_mpmc_function_queue, capacity)
+{
+	mpmc_function_queue<void(), sizeof(void*)> x(3);
+	EXPECT_EQ(x.capacity(), 4);
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_mpmc_function_queue, push_invoke)
+{
+	mpmc_function_queue<void(int&), sizeof(void*)> x(4);
+	int value = 0;
+	EXPECT_FALSE(x.try_invoke(value));
+	EXPECT_TRUE(x.try_push([](int& v) { v += 1; }));
+	EXPECT_TRUE(x.try_push([](int& v) { v *= 10; }));
+	EXPECT_FALSE(x.empty());
+	EXPECT_TRUE(x.try_invoke(value));
+	EXPECT_EQ(value, 1);
+	EXPECT_TRUE(x.try_invoke(value));
+	EXPECT_EQ(value, 10);
+	EXPECT_FALSE(x.try_invoke(value));
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_mpmc_function_queue, full)
+{
+	mpmc_function_queue<int(), sizeof(void*)> x(2);
+	EXPECT_TRUE(x.try_push([]() { return 1; }));
+	EXPECT_TRUE(x.try_push([]() { return 2; }));
+	EXPECT_FALSE(x.try_push([]() { return 3; }));
+
+	mpmc_function_queue<int(), sizeof(void*)>::function_type result;
+	ASSERT_TRUE(x.try_pop(result));
+	EXPECT_EQ(result(), 1);
+	EXPECT_TRUE(x.try_push([]() { return 3; }));
+	ASSERT_TRUE(x.try_pop(result));
+	EXPECT_EQ(result(), 2);
+	ASSERT_TRUE(x.try_pop(result));
+	EXPECT_EQ(result(), 3);
+	EXPECT_FALSE(x.try_pop(result));
+}
+TEST(sh_mpmc_function_queue, destroy_in_place)
+{
+	int value = 0;
+	{
+		mpmc_function_queue<void(), sizeof(counter)> x(4);
+		EXPECT_TRUE(x.try_push([c = counter(&value)]() { }));
+		EXPECT_TRUE(x.try_push([c = counter(&value)]() { }));
+		EXPECT_TRUE(x.try_push([c = counter(&value)]() { }));
+		EXPECT_EQ(value, 3);
+		EXPECT_TRUE(x.try_invoke());
+		EXPECT_EQ(value, 2);
+	}
+	EXPECT_EQ(value, 0);
+}
+TEST(sh_mpmc_function_queue, invoke_throws)
+{
+	int value = 0;
+	mpmc_function_queue<void(), sizeof(counter)> x(4);
+	EXPECT_TRUE(x.try_push([c = counter(&value)]() { throw std::runtime_error("call"); }));
+	EXPECT_THROW(x.try_invoke(), std::runtime_error);
+	EXPECT_EQ(value, 0);
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_mpmc_function_queue, push_throws)
+{
+	mpmc_function_queue<void(), sizeof(throw_on_copy)> x(4);
+	const throw_on_copy callable;
+	EXPECT_THROW(x.try_push(callable), std::runtime_error);
+	EXPECT_TRUE(x.try_push(throw_on_copy{}));
+	EXPECT_TRUE(x.try_invoke());
+	EXPECT_FALSE(x.try_invoke());
+}
+TEST(sh_mpmc_function_queue, concurrent)
+{
+	constexpr int producers = 4;
+	constexpr int consumers = 4;
+	constexpr int per_producer = 10000;
+
+	mpmc_function_queue<void(std::atomic<long>&), sizeof(int)> x(64);
+	std::atomic<long> sum{ 0 };
+	std::atomic<int> invoked{ 0 };
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.emplace_back([&x]()
+		{
+			for (int i = 1; i <= per_producer; ++i)
+			{
+				while (false == x.try_push([i](std::atomic<long>& s) { s += i; }))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (int c = 0; c < consumers; ++c)
+	{
+		threads.emplace_back([&x, &sum, &invoked]()
+		{
+			while (invoked.load() < producers * per_producer)
+			{
+				if (x.try_invoke(sum))
+				{
+					++invoked;
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(sum, long{ producers } * per_producer * (per_producer + 1) / 2);
+	EXPECT_TRUE(x.empty());
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <sh/parallel_for.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+using sh::parallel_for;
+using sh::parallel_partition;
+using sh::parallel_reduce;
+
+namespace
+{
+	/**	Runs submitted tasks only when asked, on the calling thread.
+	 */
+	struct manual_executor final
+	{
+		std::size_t thread_count() const noexcept
+		{
+			return 3;
+		}
+		template <typename Callable>
+		void submit(Callable&& callable)
+		{
+			if (m_tasks.size() >= m_capacity)
+			{
+				throw std::bad_alloc{};
+			}
+			m_tasks.emplace_back(std::forward<Callable>(callable));
+		}
+		bool try_run_one() noexcept
+		{
+			if (m_tasks.empty())
+			{
+				return false;
+			}
+			auto task = std::move(m_tasks.back());
+			m_tasks.pop_back();
+			task();
+			++m_ran;
+			return true;
+		}
+
+		std::vector<sh::inplace_move_only_function<void(), sizeof(void*) * 2>> m_tasks;
+		int m_ran = 0;
+		/**	The number of pending tasks beyond which submit throws.
+		 */
+		std::size_t m_capacity = ~std::size_t{ 0 };
+	};
+} // anonymous namespace
+
+TEST(sh_parallel_for, empty)
+{
+	sh::thread_pool<> pool(2);
+	bool called = false;
+	parallel_for(pool, 5, 5, 1, [&called](std::size_t, std::size_t) { called = true; });
+	EXPECT_FALSE(called);
+}
+TEST(sh_parallel_for, single_chunk)
+{
+	sh::thread_pool<> pool(2);
+	std::vector<std::pair<std::size_t, std::size_t>> calls;
+	parallel_for(pool, 3, 10, 100, [&calls](const std::size_t begin, const std::size_t end) { calls.emplace_back(begin, end); });
+	ASSERT_EQ(calls.size(), 1);
+	EXPECT_EQ(calls[0].first, 3);
+	EXPECT_EQ(calls[0].second, 10);
+}
+TEST(sh_parallel_for, cover_adaptive)
+{
+	sh::thread_pool<> pool(4);
+	std::vector<std::atomic<int>> visits(10000);
+	parallel_for(pool, 0, visits.size(), 7, [&visits](const std::size_t begin, const std::size_t end)
+	{
+		EXPECT_LE(end - begin, visits.size());
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			visits[i].fetch_add(1);
+		}
+	});
+	for (const std::atomic<int>& visit : visits)
+	{
+		ASSERT_EQ(visit, 1);
+	}
+}
+TEST(sh_parallel_for, cover_static)
+{
+	sh::thread_pool<> pool(3);
+	std::vector<std::atomic<int>> visits(1001);
+	parallel_for(pool, 1, visits.size(), 10, [&visits](const std::size_t begin, const std::size_t end)
+	{
+		EXPECT_LE(end - begin, 10);
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			visits[i].fetch_add(1);
+		}
+	}, parallel_partition::static_blocks);
+	EXPECT_EQ(visits[0], 0);
+	for (std::size_t i = 1; i < visits.size(); ++i)
+	{
+		ASSERT_EQ(visits[i], 1);
+	}
+}
+TEST(sh_parallel_for, nested)
+{
+	sh::thread_pool<> pool(2);
+	std::atomic<int> total{ 0 };
+	parallel_for(pool, 0, 16, 1, [&pool, &total](const std::size_t begin, const std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			parallel_for(pool, 0, 100, 10, [&total](const std::size_t inner_begin, const std::size_t inner_end)
+			{
+				total.fetch_add(static_cast<int>(inner_end - inner_begin));
+			});
+		}
+	});
+	EXPECT_EQ(total, 1600);
+}
+TEST(sh_parallel_for, custom_executor)
+{
+	manual_executor executor;
+	std::vector<int> visits(100);
+	parallel_for(executor, 0, visits.size(), 10, [&visits](const std::size_t begin, const std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			++visits[i];
+		}
+	}, parallel_partition::static_blocks);
+	EXPECT_EQ(executor.m_ran, 3);
+	for (const int visit : visits)
+	{
+		ASSERT_EQ(visit, 1);
+	}
+}
+TEST(sh_parallel_for, submit_throws)
+{
+	manual_executor executor;
+	executor.m_capacity = 1;
+	std::vector<int> visits(100);
+	parallel_for(executor, 0, visits.size(), 10, [&visits](const std::size_t begin, const std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			++visits[i];
+		}
+	}, parallel_partition::static_blocks);
+	// The refused participants ran on the calling thread.
+	EXPECT_EQ(executor.m_ran, 1);
+	for (const int visit : visits)
+	{
+		ASSERT_EQ(visit, 1);
+	}
+}
+TEST(sh_parallel_for, default_executor)
+{
+	std::atomic<std::size_t> total{ 0 };
+	parallel_for(0, 1000, 10, [&total](const std::size_t begin, const std::size_t end) { total.fetch_add(end - begin); });
+	EXPECT_EQ(total, 1000);
+}
+TEST(sh_parallel_reduce, sum)
+{
+	sh::thread_pool<> pool(4);
+	const std::uint64_t result = parallel_reduce(pool, 1, 100001, 16, std::uint64_t{ 0 },
+		[](const std::size_t begin, const std::size_t end, std::uint64_t partial)
+		{
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				partial += i;
+			}
+			return partial;
+		},
+		[](const std::uint64_t lhs, const std::uint64_t rhs) { return lhs + rhs; });
+	EXPECT_EQ(result, std::uint64_t{ 100000 } * 100001 / 2);
+}
+TEST(sh_parallel_reduce, max_static)
+{
+	sh::thread_pool<> pool(3);
+	std::vector<int> values(5000);
+	for (std::size_t i = 0; i < values.size(); ++i)
+	{
+		values[i] = static_cast<int>((i * 7919) % 4999);
+	}
+	const int result = parallel_reduce(pool, 0, values.size(), 50, 0,
+		[&values](const std::size_t begin, const std::size_t end, int partial)
+		{
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				partial = std::max(partial, values[i]);
+			}
+			return partial;
+		},
+		[](const int lhs, const int rhs) { return std::max(lhs, rhs); },
+		parallel_partition::static_blocks);
+	EXPECT_EQ(result, 4998);
+}
+TEST(sh_parallel_reduce, empty)
+{
+	sh::thread_pool<> pool(2);
+	const int result = parallel_reduce(pool, 3, 3, 1, 42,
+		[](std::size_t, std::size_t, int partial) { return partial + 1; },
+		[](const int lhs, const int rhs) { return lhs + rhs; });
+	EXPECT_EQ(result, 42);
+}
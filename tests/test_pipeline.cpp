@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <sh/pipeline.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using sh::pipeline;
+using sh::pipeline_mode;
+
+TEST(sh_pipeline, empty)
+{
+	pipeline<int> x;
+	x.add_stage([](int&) {});
+	EXPECT_EQ(x.stage_count(), 1u);
+	x.start();
+	x.close();
+	EXPECT_EQ(x.statistics(0).items, 0u);
+	EXPECT_EQ(x.statistics(0).batches, 0u);
+}
+TEST(sh_pipeline, batches)
+{
+	std::vector<std::size_t> sizes;
+	pipeline<int> x{ 4, 2 };
+	x.add_stage([&sizes](const pipeline<int>::span_type batch) { sizes.push_back(batch.size()); });
+	x.start();
+	for (int i = 0; i < 10; ++i)
+	{
+		x.push(i);
+	}
+	x.close();
+	EXPECT_EQ(sizes, (std::vector<std::size_t>{ 4, 4, 2 }));
+	EXPECT_EQ(x.statistics(0).items, 10u);
+	EXPECT_EQ(x.statistics(0).batches, 3u);
+}
+TEST(sh_pipeline, flush)
+{
+	std::atomic<int> seen{ 0 };
+	pipeline<int> x{ 64, 2 };
+	x.add_stage([&seen](int&) { seen.fetch_add(1); });
+	x.start();
+	x.push(1);
+	x.push(2);
+	x.flush();
+	while (seen.load() != 2)
+	{
+		std::this_thread::yield();
+	}
+	x.close();
+	EXPECT_EQ(x.statistics(0).batches, 1u);
+}
+TEST(sh_pipeline, stages_in_order)
+{
+	std::vector<int> output;
+	pipeline<int> x{ 8, 2 };
+	x.add_stage([](int& item) { item *= 2; })
+		.add_stage([](int& item) { item += 1; })
+		.add_stage([&output](int& item) { output.push_back(item); });
+	x.start();
+	for (int i = 0; i < 1000; ++i)
+	{
+		x.push(i);
+	}
+	x.close();
+	ASSERT_EQ(output.size(), 1000u);
+	for (int i = 0; i < 1000; ++i)
+	{
+		EXPECT_EQ(output[i], i * 2 + 1);
+	}
+	for (std::size_t i = 0; i < x.stage_count(); ++i)
+	{
+		EXPECT_EQ(x.statistics(i).items, 1000u);
+		EXPECT_EQ(x.statistics(i).batches, 125u);
+		EXPECT_EQ(x.statistics(i).queue_depth, 0u);
+		EXPECT_LE(x.statistics(i).max_queue_depth, 2u);
+	}
+}
+TEST(sh_pipeline, parallel_restores_order)
+{
+	std::vector<int> output;
+	pipeline<int> x{ 3, 4 };
+	x.add_stage([](const pipeline<int>::span_type batch)
+	{
+		// Uneven delays let later batches finish first.
+		if (batch[0] % 2 == 0)
+		{
+			std::this_thread::yield();
+		}
+		for (int& item : batch)
+		{
+			item = -item;
+		}
+	}, pipeline_mode::parallel, 4);
+	x.add_stage([&output](int& item) { output.push_back(item); });
+	x.start();
+	for (int i = 0; i < 3000; ++i)
+	{
+		x.push(i);
+	}
+	x.close();
+	ASSERT_EQ(output.size(), 3000u);
+	for (int i = 0; i < 3000; ++i)
+	{
+		EXPECT_EQ(output[i], -i);
+	}
+}
+TEST(sh_pipeline, backpressure)
+{
+	std::atomic<bool> release{ false };
+	std::atomic<int> pushed{ 0 };
+	std::atomic<int> processed{ 0 };
+	pipeline<int> x{ 1, 1 };
+	x.add_stage([&release, &processed](int&)
+	{
+		while (false == release.load())
+		{
+			std::this_thread::yield();
+		}
+		processed.fetch_add(1);
+	});
+	x.start();
+	std::thread producer{ [&x, &pushed]()
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			x.push(i);
+			pushed.fetch_add(1);
+		}
+		x.close();
+	} };
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	// One queue slot, one batch in the stage and one spare limit the producer.
+	EXPECT_LE(pushed.load(), 3);
+	release.store(true);
+	producer.join();
+	EXPECT_EQ(processed.load(), 100);
+}
+TEST(sh_pipeline, move_only_items)
+{
+	std::vector<int> output;
+	pipeline<std::unique_ptr<int>> x{ 2, 2 };
+	x.add_stage([](std::unique_ptr<int>& item) { *item += 1; });
+	x.add_stage([&output](std::unique_ptr<int>& item) { output.push_back(*item); item.reset(); });
+	x.start();
+	for (int i = 0; i < 5; ++i)
+	{
+		x.push(std::make_unique<int>(i));
+	}
+	x.close();
+	EXPECT_EQ(output, (std::vector<int>{ 1, 2, 3, 4, 5 }));
+}
+TEST(sh_pipeline, closes_on_destruction)
+{
+	std::atomic<int> seen{ 0 };
+	{
+		pipeline<int> x{ 4, 2 };
+		x.add_stage([&seen](int&) { seen.fetch_add(1); }, pipeline_mode::parallel, 2);
+		x.start();
+		for (int i = 0; i < 10; ++i)
+		{
+			x.push(i);
+		}
+	}
+	EXPECT_EQ(seen.load(), 10);
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <sh/priority_function_queue.hpp>
+
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using sh::priority_function_queue;
+
+namespace
+{
+	/**	Checks that random pushes and pops run in priority, then push, order.
+	 *	@param priorities The number of distinct priorities to push.
+	 *	@tparam Queue The queue type.
+	 */
+	template <typename Queue>
+	void check_random_order(const unsigned priorities)
+	{
+		std::mt19937 random{ 7 };
+		Queue x;
+		std::vector<std::pair<unsigned, int>> popped;
+		int pushed = 0;
+		for (int round = 0; round < 50; ++round)
+		{
+			for (int i = 0; i < 100; ++i, ++pushed)
+			{
+				const unsigned priority = random() % priorities;
+				x.push(priority, [&popped, priority, pushed]() { popped.emplace_back(priority, pushed); });
+			}
+			popped.clear();
+			for (int i = 0; i < 60; ++i)
+			{
+				EXPECT_TRUE(x.run_one());
+			}
+			for (std::size_t i = 1; i < popped.size(); ++i)
+			{
+				EXPECT_TRUE(popped[i - 1].first > popped[i].first
+					|| (popped[i - 1].first == popped[i].first && popped[i - 1].second < popped[i].second));
+			}
+		}
+		EXPECT_EQ(x.size(), 50u * 40u);
+		x.clear();
+		EXPECT_TRUE(x.empty());
+	}
+} // anonymous namespace
+
+TEST(sh_priority_function_queue, empty)
+{
+	priority_function_queue<void()> x;
+	EXPECT_TRUE(x.empty());
+	EXPECT_FALSE(x.run_one());
+	priority_function_queue<void()>::function_type f;
+	EXPECT_FALSE(x.try_pop(f));
+}
+TEST(sh_priority_function_queue, heap_order)
+{
+	std::vector<int> order;
+	priority_function_queue<void(std::vector<int>&)> x{ 4 };
+	x.push(1, [](std::vector<int>& out) { out.push_back(1); });
+	x.push(5, [](std::vector<int>& out) { out.push_back(5); });
+	x.push(3, [](std::vector<int>& out) { out.push_back(3); });
+	x.push(5, [](std::vector<int>& out) { out.push_back(6); });
+	EXPECT_EQ(x.size(), 4u);
+	EXPECT_EQ(x.top_priority(), 5u);
+	while (x.run_one(order))
+	{ }
+	EXPECT_EQ(order, (std::vector<int>{ 5, 6, 3, 1 }));
+}
+TEST(sh_priority_function_queue, bucket_order)
+{
+	std::vector<int> order;
+	priority_function_queue<void(std::vector<int>&), sizeof(void*) * 6, 200> x;
+	x.push(1, [](std::vector<int>& out) { out.push_back(1); });
+	x.push(130, [](std::vector<int>& out) { out.push_back(130); });
+	x.push(64, [](std::vector<int>& out) { out.push_back(64); });
+	x.push(130, [](std::vector<int>& out) { out.push_back(131); });
+	EXPECT_EQ(x.top_priority(), 130u);
+	while (x.run_one(order))
+	{ }
+	EXPECT_EQ(order, (std::vector<int>{ 130, 131, 64, 1 }));
+}
+TEST(sh_priority_function_queue, random_heap)
+{
+	check_random_order<priority_function_queue<void()>>(1000);
+}
+TEST(sh_priority_function_queue, random_buckets)
+{
+	check_random_order<priority_function_queue<void(), sizeof(void*) * 6, 4096>>(4096);
+	check_random_order<priority_function_queue<void(), sizeof(void*) * 6, 8>>(8);
+}
+TEST(sh_priority_function_queue, try_pop)
+{
+	auto value = std::make_unique<int>(42);
+	priority_function_queue<int()> x;
+	x.push(0, [value = std::move(value)]() { return *value; });
+	priority_function_queue<int()>::function_type f;
+	EXPECT_TRUE(x.try_pop(f));
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(f(), 42);
+}
+TEST(sh_priority_function_queue, push_while_running)
+{
+	std::vector<int> order;
+	priority_function_queue<void(), sizeof(void*) * 6, 4> x;
+	x.push(1, [&x, &order]()
+	{
+		order.push_back(1);
+		x.push(3, [&order]() { order.push_back(3); });
+	});
+	x.push(2, [&order]() { order.push_back(2); });
+	while (x.run_one())
+	{ }
+	EXPECT_EQ(order, (std::vector<int>{ 2, 1, 3 }));
+}
+TEST(sh_priority_function_queue, throwing)
+{
+	auto counter = std::make_shared<int>(0);
+	priority_function_queue<void()> x;
+	x.push(1, [counter]() { throw std::runtime_error{ "task" }; });
+	x.push(0, [counter]() {});
+	EXPECT_EQ(counter.use_count(), 3);
+	EXPECT_THROW(x.run_one(), std::runtime_error);
+	EXPECT_EQ(counter.use_count(), 2);
+	EXPECT_EQ(x.size(), 1u);
+	x.clear();
+	EXPECT_EQ(counter.use_count(), 1);
+}
+TEST(sh_priority_function_queue, recycles_nodes)
+{
+	priority_function_queue<void()> x{ 16 };
+	int called = 0;
+	for (int i = 0; i < 10000; ++i)
+	{
+		x.push(static_cast<unsigned>(i % 7), [&called]() { ++called; });
+		if (i % 2 == 1)
+		{
+			x.run_one();
+			x.run_one();
+		}
+	}
+	EXPECT_EQ(called, 10000);
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_priority_function_queue, bucket_out_of_range)
+{
+	priority_function_queue<void(), sizeof(void*) * 6, 4> x;
+	int called = 0;
+	EXPECT_THROW(x.push(4, [&called]() { ++called; }), std::out_of_range);
+	EXPECT_THROW(x.push(~0u, [&called]() { ++called; }), std::out_of_range);
+	EXPECT_TRUE(x.empty());
+	x.push(3, [&called]() { ++called; });
+	EXPECT_TRUE(x.run_one());
+	EXPECT_EQ(called, 1);
+}
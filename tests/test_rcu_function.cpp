@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include <sh/rcu_function.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using sh::rcu_function;
+
+namespace
+{
+	int plus_1(const int input)
+	{
+		return input + 1;
+	}
+
+	struct counter final
+	{
+		std::atomic<int>* m_value;
+
+		counter(std::atomic<int>* const value)
+			: m_value(value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		~counter()
+		{
+			if (m_value != nullptr)
+			{
+				--(*m_value);
+			}
+		}
+		counter(const counter& other)
+			: m_value(other.m_value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		counter(counter&& other) noexcept
+			: m_value(std::exchange(other.m_value, nullptr))
+		{ }
+		counter& operator=(const counter&) = delete;
+		counter& operator=(counter&&) = delete;
+	};
+} // anonymous namespace
+
+TEST(sh_rcu_function, ctor_default)
+{
+	rcu_function<int(int)> x;
+	EXPECT_FALSE(bool(x));
+	EXPECT_EQ(x, nullptr);
+}
+TEST(sh_rcu_function, ctor_nullptr)
+{
+	rcu_function<int(int)> x(nullptr);
+	EXPECT_FALSE(bool(x));
+	EXPECT_EQ(x, nullptr);
+}
+TEST(sh_rcu_function, ctor_func)
+{
+	rcu_function<int(int)> x(plus_1);
+	ASSERT_TRUE(bool(x));
+	ASSERT_NE(x, nullptr);
+	EXPECT_EQ(x(0), 1);
+}
+TEST(sh_rcu_function, ctor_copyable_function)
+{
+	sh::copyable_function<int(int)> f(plus_1);
+	rcu_function<int(int)> x(std::move(f));
+	ASSERT_TRUE(bool(x));
+	EXPECT_EQ(x(1), 2);
+}
+TEST(sh_rcu_function, noexcept)
+{
+	rcu_function<int(int) noexcept> x([](const int input) noexcept { return input * 2; });
+	EXPECT_EQ(x(2), 4);
+}
+TEST(sh_rcu_function, assign)
+{
+	std::atomic<int> a_value{ 0 }, b_value{ 0 };
+	{
+		rcu_function<char()> x([c = counter(&a_value)]() { return 'a'; });
+		EXPECT_EQ(x(), 'a');
+		EXPECT_EQ(a_value, 1);
+
+		x = [c = counter(&b_value)]() { return 'b'; };
+		EXPECT_EQ(x(), 'b');
+		EXPECT_EQ(b_value, 1);
+
+		EXPECT_TRUE(x.reclaim());
+		EXPECT_EQ(a_value, 0);
+	}
+	EXPECT_EQ(a_value, 0);
+	EXPECT_EQ(b_value, 0);
+}
+TEST(sh_rcu_function, assign_nullptr)
+{
+	std::atomic<int> value{ 0 };
+	rcu_function<char()> x([c = counter(&value)]() { return 'x'; });
+	EXPECT_EQ(value, 1);
+
+	x = nullptr;
+	EXPECT_FALSE(bool(x));
+	EXPECT_EQ(x, nullptr);
+	x.synchronize();
+	EXPECT_EQ(value, 0);
+}
+TEST(sh_rcu_function, store_during_call)
+{
+	std::atomic<int> value{ 0 };
+	rcu_function<int()> x;
+	x.store([&x, c = counter(&value)]() -> int
+	{
+		// Replace this handler while running; it must remain alive until return.
+		x.store([]() { return 2; });
+		EXPECT_FALSE(x.reclaim());
+		return c.m_value != nullptr ? 1 : 0;
+	});
+	EXPECT_EQ(x(), 1);
+	EXPECT_EQ(x(), 2);
+	x.synchronize();
+	EXPECT_EQ(value, 0);
+}
+TEST(sh_rcu_function, nested)
+{
+	rcu_function<int(int)> inner(plus_1);
+	rcu_function<int(int)> outer([&inner](int input) { return inner(std::move(input)) * 2; });
+	EXPECT_EQ(outer(0), 2);
+	inner.store([](const int input) { return input + 2; });
+	inner.synchronize();
+	EXPECT_EQ(outer(0), 4);
+}
+TEST(sh_rcu_function, concurrent)
+{
+	std::atomic<int> value{ 0 };
+	{
+		rcu_function<int()> x([c = counter(&value)]() { return 0; });
+		std::atomic<bool> done{ false };
+		std::vector<std::thread> readers;
+		for (int i = 0; i < 4; ++i)
+		{
+			readers.emplace_back([&x, &done]()
+			{
+				int last = 0;
+				while (false == done.load(std::memory_order_relaxed))
+				{
+					const int result = x();
+					EXPECT_GE(result, last);
+					last = result;
+				}
+			});
+		}
+		for (int i = 1; i <= 1000; ++i)
+		{
+			x.store([i, c = counter(&value)]() { return i; });
+		}
+		done = true;
+		for (std::thread& reader : readers)
+		{
+			reader.join();
+		}
+		x.synchronize();
+		EXPECT_EQ(value, 1);
+		EXPECT_EQ(x(), 1000);
+	}
+	EXPECT_EQ(value, 0);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <sh/reactor.hpp>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using sh::reactor;
+
+namespace
+{
+	/**	Owns both ends of a pipe.
+	 */
+	struct pipe_pair final
+	{
+		pipe_pair()
+		{
+			EXPECT_EQ(::pipe(m_fds), 0);
+		}
+		~pipe_pair()
+		{
+			::close(m_fds[0]);
+			::close(m_fds[1]);
+		}
+		void write_byte(const char value = 'x') const
+		{
+			EXPECT_EQ(::write(m_fds[1], &value, 1), 1);
+		}
+		char read_byte() const
+		{
+			char value = 0;
+			EXPECT_EQ(::read(m_fds[0], &value, 1), 1);
+			return value;
+		}
+
+		int m_fds[2];
+	};
+} // anonymous namespace
+
+TEST(sh_reactor, empty)
+{
+	reactor<> x;
+	EXPECT_EQ(x.size(), 0u);
+	EXPECT_EQ(x.run_once(0), 0u);
+	EXPECT_FALSE(x.remove(reactor<>::handle{}));
+	EXPECT_FALSE(x.modify(reactor<>::handle{}, EPOLLIN));
+}
+TEST(sh_reactor, readable)
+{
+	pipe_pair pipe;
+	reactor<> x;
+	std::vector<char> received;
+	const auto registration = x.add(pipe.m_fds[0], EPOLLIN, [&pipe, &received](const std::uint32_t events)
+	{
+		EXPECT_TRUE(events & EPOLLIN);
+		received.push_back(pipe.read_byte());
+	});
+	EXPECT_EQ(x.size(), 1u);
+	EXPECT_EQ(x.run_once(0), 0u);
+	pipe.write_byte('a');
+	EXPECT_EQ(x.run_once(1000), 1u);
+	pipe.write_byte('b');
+	EXPECT_EQ(x.run_once(1000), 1u);
+	EXPECT_EQ(received, (std::vector<char>{ 'a', 'b' }));
+	EXPECT_TRUE(x.remove(registration));
+	EXPECT_FALSE(x.remove(registration));
+	pipe.write_byte('c');
+	EXPECT_EQ(x.run_once(0), 0u);
+	EXPECT_EQ(x.size(), 0u);
+}
+TEST(sh_reactor, modify)
+{
+	pipe_pair pipe;
+	reactor<> x;
+	int called = 0;
+	const auto registration = x.add(pipe.m_fds[0], 0, [&called](std::uint32_t) { ++called; });
+	pipe.write_byte();
+	EXPECT_EQ(x.run_once(0), 0u);
+	EXPECT_TRUE(x.modify(registration, EPOLLIN));
+	EXPECT_EQ(x.run_once(1000), 1u);
+	EXPECT_EQ(called, 1);
+}
+TEST(sh_reactor, remove_during_dispatch)
+{
+	pipe_pair first;
+	pipe_pair second;
+	reactor<> x;
+	int called = 0;
+	reactor<>::handle a;
+	reactor<>::handle b;
+	// Whichever runs first removes both, so the other's event is ignored.
+	a = x.add(first.m_fds[0], EPOLLIN, [&x, &a, &b, &called](std::uint32_t)
+	{
+		++called;
+		EXPECT_TRUE(x.remove(a));
+		EXPECT_TRUE(x.remove(b));
+	});
+	b = x.add(second.m_fds[0], EPOLLIN, [&x, &a, &b, &called](std::uint32_t)
+	{
+		++called;
+		EXPECT_TRUE(x.remove(b));
+		EXPECT_TRUE(x.remove(a));
+	});
+	first.write_byte();
+	second.write_byte();
+	EXPECT_EQ(x.run_once(1000), 1u);
+	EXPECT_EQ(called, 1);
+	EXPECT_EQ(x.size(), 0u);
+	// The freed slots are reused under new generations.
+	const auto c = x.add(first.m_fds[0], EPOLLIN, [&called](std::uint32_t) { ++called; });
+	EXPECT_NE(c, a);
+	EXPECT_NE(c, b);
+	EXPECT_EQ(x.run_once(1000), 1u);
+	EXPECT_EQ(called, 2);
+}
+TEST(sh_reactor, post)
+{
+	reactor<> x;
+	int called = 0;
+	EXPECT_TRUE(x.post([&called]() { ++called; }));
+	EXPECT_TRUE(x.post([&called]() { ++called; }));
+	EXPECT_EQ(x.run_once(0), 2u);
+	EXPECT_EQ(called, 2);
+	EXPECT_EQ(x.run_once(0), 0u);
+}
+TEST(sh_reactor, post_full)
+{
+	reactor<> x{ 2 };
+	EXPECT_TRUE(x.post([]() {}));
+	EXPECT_TRUE(x.post([]() {}));
+	EXPECT_FALSE(x.post([]() {}));
+	EXPECT_EQ(x.run_once(0), 2u);
+}
+TEST(sh_reactor, cross_thread)
+{
+	reactor<> x;
+	std::atomic<int> called{ 0 };
+	constexpr int per_thread = 2000;
+	std::vector<std::thread> posters;
+	for (int t = 0; t < 3; ++t)
+	{
+		posters.emplace_back([&x, &called]()
+		{
+			for (int i = 0; i < per_thread; ++i)
+			{
+				while (false == x.post([&called]() { called.fetch_add(1, std::memory_order_relaxed); }))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	while (called.load(std::memory_order_relaxed) != per_thread * 3)
+	{
+		x.run_once(-1);
+	}
+	for (std::thread& poster : posters)
+	{
+		poster.join();
+	}
+}
+TEST(sh_reactor, stop)
+{
+	reactor<> x;
+	std::thread stopper{ [&x]()
+	{
+		x.post([&x]() { x.stop(); });
+	} };
+	x.run();
+	stopper.join();
+	x.stop();
+	EXPECT_EQ(x.run(), 0u);
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+
+#include <sh/shm_task_ring.hpp>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using sh::function_registry;
+using sh::shm_task_ring;
+using sh::shm_task_ring_producers;
+
+namespace
+{
+	constexpr function_registry::id_type add_id = function_registry::id_of("add");
+	constexpr function_registry::id_type count_id = function_registry::id_of("count");
+
+	std::uint64_t g_sum = 0;
+	std::uint64_t g_count = 0;
+
+	/**	A registry of the functions every test process agrees upon.
+	 *	@return The registry.
+	 */
+	function_registry make_registry()
+	{
+		g_sum = 0;
+		g_count = 0;
+		function_registry registry;
+		registry.add<std::uint64_t>(add_id, [](const std::uint64_t value) { g_sum += value; ++g_count; });
+		registry.add(count_id, []() { ++g_count; });
+		return registry;
+	}
+	/**	Wait for a forked child and return its exit status.
+	 *	@param child The child's process identifier.
+	 *	@return The exit status, or -1 if it did not exit normally.
+	 */
+	int wait_child(const pid_t child)
+	{
+		int status = 0;
+		EXPECT_EQ(::waitpid(child, &status, 0), child);
+		return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	}
+} // anonymous namespace
+
+TEST(sh_shm_task_ring, push_pop)
+{
+	const function_registry registry = make_registry();
+	auto x = shm_task_ring<shm_task_ring_producers::single>::create(4, 16);
+	EXPECT_EQ(x.capacity(), 4u);
+	EXPECT_GE(x.argument_capacity(), 16u);
+	EXPECT_FALSE(x.ready());
+	EXPECT_FALSE(x.try_pop(registry));
+	EXPECT_TRUE(x.try_push(add_id, std::uint64_t{ 3 }));
+	EXPECT_TRUE(x.try_push(count_id));
+	EXPECT_TRUE(x.try_push(add_id, std::uint64_t{ 4 }));
+	EXPECT_TRUE(x.try_push(add_id, std::uint64_t{ 5 }));
+	EXPECT_FALSE(x.try_push(count_id));
+	EXPECT_TRUE(x.try_pop(registry));
+	EXPECT_EQ(g_sum, 3u);
+	EXPECT_TRUE(x.try_push(count_id));
+	EXPECT_EQ(x.drain(registry), 4u);
+	EXPECT_EQ(g_sum, 12u);
+	EXPECT_EQ(g_count, 5u);
+}
+TEST(sh_shm_task_ring, unknown_function)
+{
+	const function_registry registry = make_registry();
+	auto x = shm_task_ring<>::create(4);
+	x.push(12345);
+	x.push(count_id);
+	EXPECT_THROW(x.try_pop(registry), std::out_of_range);
+	// The failed record was consumed.
+	EXPECT_TRUE(x.try_pop(registry));
+	EXPECT_EQ(g_count, 1u);
+}
+TEST(sh_shm_task_ring, wait_and_close)
+{
+	auto x = shm_task_ring<>::create(4);
+	EXPECT_FALSE(x.wait(1));
+	x.push(count_id);
+	EXPECT_TRUE(x.wait());
+	x.close();
+	EXPECT_TRUE(x.closed());
+	EXPECT_TRUE(x.wait());
+	const function_registry registry = make_registry();
+	EXPECT_EQ(x.drain(registry), 1u);
+	EXPECT_FALSE(x.wait());
+}
+TEST(sh_shm_task_ring, attach_mismatch)
+{
+	auto x = shm_task_ring<shm_task_ring_producers::single>::create(4);
+	EXPECT_THROW(shm_task_ring<shm_task_ring_producers::multiple>::attach(x.fd()), std::invalid_argument);
+	auto y = shm_task_ring<shm_task_ring_producers::single>::attach(x.fd());
+	y.push(count_id);
+	EXPECT_TRUE(x.ready());
+}
+TEST(sh_shm_task_ring, attach_corrupt)
+{
+	auto x = shm_task_ring<>::create(4);
+	void* const memory = ::mmap(nullptr, sizeof(sh::detail::shm_task_ring_header), PROT_READ | PROT_WRITE, MAP_SHARED, x.fd(), 0);
+	ASSERT_NE(memory, MAP_FAILED);
+	auto& header = *static_cast<sh::detail::shm_task_ring_header*>(memory);
+	const std::uint32_t slot_count = header.m_slot_count;
+	const std::uint32_t slot_size = header.m_slot_size;
+	header.m_slot_count = 0;
+	EXPECT_THROW(shm_task_ring<>::attach(x.fd()), std::invalid_argument);
+	header.m_slot_count = 3;
+	EXPECT_THROW(shm_task_ring<>::attach(x.fd()), std::invalid_argument);
+	header.m_slot_count = slot_count;
+	header.m_slot_size = 1;
+	EXPECT_THROW(shm_task_ring<>::attach(x.fd()), std::invalid_argument);
+	header.m_slot_size = slot_size;
+	EXPECT_NO_THROW(shm_task_ring<>::attach(x.fd()));
+	::munmap(memory, sizeof(sh::detail::shm_task_ring_header));
+}
+TEST(sh_shm_task_ring, oversized)
+{
+	struct large final
+	{
+		unsigned char m_bytes[128];
+	};
+	const function_registry registry = make_registry();
+	auto x = shm_task_ring<>::create(4, 16);
+	EXPECT_FALSE(x.try_push(add_id, large{}));
+	EXPECT_THROW(x.push(add_id, large{}), std::length_error);
+	EXPECT_FALSE(x.ready());
+	// A record whose size a peer corrupted is rejected before its argument is read, and consumed.
+	x.push(add_id, std::uint64_t{ 3 });
+	x.push(count_id);
+	const std::size_t mapped = sizeof(sh::detail::shm_task_ring_header) + sizeof(sh::detail::shm_task_ring_record);
+	void* const memory = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, x.fd(), 0);
+	ASSERT_NE(memory, MAP_FAILED);
+	auto& first = *reinterpret_cast<sh::detail::shm_task_ring_record*>(static_cast<unsigned char*>(memory) + sizeof(sh::detail::shm_task_ring_header));
+	first.m_size = 1u << 20;
+	EXPECT_THROW(x.try_pop(registry), std::length_error);
+	EXPECT_TRUE(x.try_pop(registry));
+	EXPECT_EQ(g_sum, 0u);
+	EXPECT_EQ(g_count, 1u);
+	::munmap(memory, mapped);
+}
+TEST(sh_shm_task_ring, named)
+{
+	const std::string name = "/sh_shm_task_ring_test_" + std::to_string(::getpid());
+	auto x = shm_task_ring<>::create(name.c_str(), 8);
+	EXPECT_THROW(shm_task_ring<>::create(name.c_str(), 8), std::system_error);
+	auto y = shm_task_ring<>::attach(name.c_str());
+	shm_task_ring<>::unlink(name.c_str());
+	EXPECT_THROW(shm_task_ring<>::attach(name.c_str()), std::system_error);
+	y.push(add_id, std::uint64_t{ 9 });
+	const function_registry registry = make_registry();
+	EXPECT_EQ(x.drain(registry), 1u);
+	EXPECT_EQ(g_sum, 9u);
+}
+TEST(sh_shm_task_ring, threads)
+{
+	const function_registry registry = make_registry();
+	auto x = shm_task_ring<shm_task_ring_producers::single>::create(64);
+	constexpr std::uint64_t count = 100000;
+	std::thread producer{ [&x]()
+	{
+		for (std::uint64_t i = 1; i <= count; ++i)
+		{
+			x.push(add_id, i);
+		}
+		x.close();
+	} };
+	while (x.wait())
+	{
+		x.drain(registry);
+	}
+	producer.join();
+	EXPECT_EQ(g_count, count);
+	EXPECT_EQ(g_sum, count * (count + 1) / 2);
+}
+TEST(sh_shm_task_ring, forked_consumer)
+{
+	const function_registry registry = make_registry();
+	auto x = shm_task_ring<shm_task_ring_producers::single>::create(256);
+	constexpr std::uint64_t count = 100000;
+	const pid_t child = ::fork();
+	ASSERT_NE(child, -1);
+	if (child == 0)
+	{
+		while (x.wait())
+		{
+			x.drain(registry);
+		}
+		::_exit(g_count == count && g_sum == count * (count + 1) / 2 ? 0 : 1);
+	}
+	for (std::uint64_t i = 1; i <= count; ++i)
+	{
+		x.push(add_id, i);
+	}
+	x.close();
+	EXPECT_EQ(wait_child(child), 0);
+	EXPECT_EQ(g_count, 0u);
+}
+TEST(sh_shm_task_ring, forked_producers)
+{
+	const function_registry registry = make_registry();
+	auto x = shm_task_ring<>::create(256);
+	constexpr std::uint64_t count = 50000;
+	constexpr int producers = 3;
+	pid_t children[producers];
+	for (int p = 0; p < producers; ++p)
+	{
+		children[p] = ::fork();
+		ASSERT_NE(children[p], -1);
+		if (children[p] == 0)
+		{
+			for (std::uint64_t i = 1; i <= count; ++i)
+			{
+				x.push(add_id, i);
+			}
+			::_exit(0);
+		}
+	}
+	while (g_count != count * producers && x.wait(1000))
+	{
+		x.drain(registry);
+	}
+	for (const pid_t child : children)
+	{
+		EXPECT_EQ(wait_child(child), 0);
+	}
+	EXPECT_EQ(g_count, count * producers);
+	EXPECT_EQ(g_sum, producers * count * (count + 1) / 2);
+}
+
+#endif
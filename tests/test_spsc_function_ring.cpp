@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <sh/spsc_function_ring.hpp>
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using sh::spsc_function_ring;
+
+namespace
+{
+	struct counter final
+	{
+		int* m_value;
+
+		counter(int* const value)
+			: m_value(value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		~counter()
+		{
+			if (m_value != nullptr)
+			{
+				--(*m_value);
+			}
+		}
+		counter(const counter& other)
+			: m_value(other.m_value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		counter(counter&& other) noexcept
+			: m_value(std::exchange(other.m_value, nullptr))
+		{ }
+		counter& operator=(const counter&) = delete;
+		counter& operator=(counter&&) = delete;
+	};
+
+	/**	A callable of configurable size that appends its identifier to a vector.
+	 */
+	template <std::size_t Size>
+	struct append final
+	{
+		int m_id;
+		std::array<char, Size> m_padding{};
+
+		void operator()(std::vector<int>& out) const
+		{
+			out.push_back(m_id);
+		}
+	};
+} // anonymous namespace
+
+TEST(sh_spsc_function_ring, size)
+{
+	spsc_function_ring<void()> x(100);
+	EXPECT_EQ(x.size(), 128);
+	EXPECT_EQ(x.record_size<append<1>>() % alignof(std::max_align_t), 0);
+}
+TEST(sh_spsc_function_ring, push_invoke)
+{
+	spsc_function_ring<void(int&)> x(256);
+	int value = 0;
+	EXPECT_FALSE(x.try_invoke(value));
+	EXPECT_TRUE(x.try_push([](int& v) { v += 1; }));
+	EXPECT_TRUE(x.try_push([](int& v) { v *= 10; }));
+	EXPECT_TRUE(x.try_invoke(value));
+	EXPECT_EQ(value, 1);
+	EXPECT_TRUE(x.try_invoke(value));
+	EXPECT_EQ(value, 10);
+	EXPECT_FALSE(x.try_invoke(value));
+}
+TEST(sh_spsc_function_ring, noexcept)
+{
+	spsc_function_ring<void(int&) noexcept> x(256);
+	int value = 0;
+	EXPECT_TRUE(x.try_push([](int& v) noexcept { v = 7; }));
+	EXPECT_TRUE(x.try_invoke(value));
+	EXPECT_EQ(value, 7);
+}
+TEST(sh_spsc_function_ring, write_publish)
+{
+	spsc_function_ring<void(std::vector<int>&)> x(256);
+	std::vector<int> out;
+	EXPECT_TRUE(x.try_write(append<1>{ 1 }));
+	EXPECT_TRUE(x.try_write(append<1>{ 2 }));
+	EXPECT_FALSE(x.try_invoke(out));
+	x.publish();
+	EXPECT_EQ(x.invoke_batch(8, out), 2);
+	EXPECT_EQ(out, (std::vector<int>{ 1, 2 }));
+}
+TEST(sh_spsc_function_ring, move_only_arguments)
+{
+	spsc_function_ring<int(std::unique_ptr<int>&&)> x(256);
+	EXPECT_TRUE(x.try_push([](std::unique_ptr<int>&& value) { return *value; }));
+	EXPECT_TRUE(x.try_push([](std::unique_ptr<int> value) { return *value; }));
+	EXPECT_TRUE(x.try_invoke(std::make_unique<int>(1)));
+	EXPECT_TRUE(x.try_invoke(std::make_unique<int>(2)));
+	EXPECT_FALSE(x.try_invoke(std::make_unique<int>(3)));
+}
+TEST(sh_spsc_function_ring, too_large)
+{
+	spsc_function_ring<void(std::vector<int>&)> x(128);
+	using record = append<40>;
+	ASSERT_EQ(x.record_size<record>(), 64);
+	EXPECT_THROW(x.try_push(append<60>{ 1 }), std::length_error);
+	EXPECT_TRUE(x.try_push(record{ 1 }));
+}
+TEST(sh_spsc_function_ring, full)
+{
+	spsc_function_ring<void(std::vector<int>&)> x(128);
+	using record = append<40>;
+	ASSERT_EQ(x.record_size<record>(), 64);
+	std::vector<int> out;
+	EXPECT_TRUE(x.try_push(record{ 1 }));
+	EXPECT_TRUE(x.try_push(record{ 2 }));
+	EXPECT_FALSE(x.try_push(record{ 3 }));
+	EXPECT_TRUE(x.try_invoke(out));
+	EXPECT_TRUE(x.try_push(record{ 3 }));
+	EXPECT_EQ(x.invoke_batch(8, out), 2);
+	EXPECT_EQ(out, (std::vector<int>{ 1, 2, 3 }));
+}
+TEST(sh_spsc_function_ring, wrap)
+{
+	spsc_function_ring<void(std::vector<int>&)> x(128);
+	std::vector<int> out, expected;
+	// Sizes chosen so records regularly straddle the end of the buffer.
+	for (int i = 0; i < 100; ++i)
+	{
+		if (i % 2 == 0)
+		{
+			ASSERT_TRUE(x.try_push(append<40>{ i }));
+		}
+		else
+		{
+			ASSERT_TRUE(x.try_push(append<8>{ i }));
+		}
+		expected.push_back(i);
+		ASSERT_TRUE(x.try_invoke(out));
+	}
+	EXPECT_EQ(out, expected);
+}
+TEST(sh_spsc_function_ring, destroy)
+{
+	int value = 0;
+	{
+		spsc_function_ring<void()> x(256);
+		EXPECT_TRUE(x.try_push([c = counter(&value)]() { }));
+		EXPECT_TRUE(x.try_push([c = counter(&value)]() { }));
+		EXPECT_TRUE(x.try_write([c = counter(&value)]() { }));
+		EXPECT_EQ(value, 3);
+		EXPECT_TRUE(x.try_invoke());
+		EXPECT_EQ(value, 2);
+	}
+	EXPECT_EQ(value, 0);
+}
+TEST(sh_spsc_function_ring, invoke_throws)
+{
+	int value = 0;
+	spsc_function_ring<void()> x(256);
+	EXPECT_TRUE(x.try_push([c = counter(&value)]() { throw std::runtime_error("call"); }));
+	EXPECT_TRUE(x.try_push([c = counter(&value)]() { }));
+	EXPECT_THROW(x.try_invoke(), std::runtime_error);
+	EXPECT_EQ(value, 1);
+	EXPECT_TRUE(x.try_invoke());
+	EXPECT_EQ(value, 0);
+}
+TEST(sh_spsc_function_ring, concurrent)
+{
+	constexpr int count = 100000;
+	spsc_function_ring<void(std::vector<int>&)> x(1024);
+	std::vector<int> out;
+	out.reserve(count);
+	std::thread producer([&x]()
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			bool written;
+			do
+			{
+				written = i % 3 == 0 ? x.try_write(append<100>{ i }) : x.try_write(append<4>{ i });
+				if (false == written || i % 8 == 0)
+				{
+					x.publish();
+				}
+				if (false == written)
+				{
+					std::this_thread::yield();
+				}
+			} while (false == written);
+		}
+		x.publish();
+	});
+	while (out.size() < count)
+	{
+		if (x.invoke_batch(16, out) == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+	producer.join();
+	for (int i = 0; i < count; ++i)
+	{
+		ASSERT_EQ(out[i], i);
+	}
+}
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+
+#include <sh/task_graph.hpp>
+#include <sh/thread_pool.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using sh::task_graph;
+
+namespace
+{
+	/**	Runs submitted tasks only when asked, on the calling thread, in submission order.
+	 */
+	struct manual_executor final
+	{
+		template <typename Callable>
+		void submit(Callable&& callable)
+		{
+			m_tasks.emplace_back(std::forward<Callable>(callable));
+		}
+		bool try_run_one() noexcept
+		{
+			if (m_next == m_tasks.size())
+			{
+				return false;
+			}
+			m_tasks[m_next++]();
+			return true;
+		}
+
+		std::vector<sh::inplace_move_only_function<void(), sizeof(void*) * 3>> m_tasks;
+		std::size_t m_next = 0;
+	};
+
+	/**	A manual_executor whose every other submit throws, as if its queue were full.
+	 */
+	struct refusing_executor final
+	{
+		template <typename Callable>
+		void submit(Callable&& callable)
+		{
+			if (++m_submits % 2 == 0)
+			{
+				throw std::runtime_error{ "full" };
+			}
+			m_executor.submit(std::forward<Callable>(callable));
+		}
+		bool try_run_one() noexcept
+		{
+			return m_executor.try_run_one();
+		}
+
+		manual_executor m_executor;
+		std::size_t m_submits = 0;
+	};
+
+	/**	Records the order in which tasks run.
+	 */
+	struct order final
+	{
+		void push(const int id)
+		{
+			const std::lock_guard<std::mutex> lock{ m_mutex };
+			m_ids.push_back(id);
+		}
+		std::size_t position(const int id) const
+		{
+			for (std::size_t i = 0; i < m_ids.size(); ++i)
+			{
+				if (m_ids[i] == id)
+				{
+					return i;
+				}
+			}
+			return m_ids.size();
+		}
+
+		std::mutex m_mutex;
+		std::vector<int> m_ids;
+	};
+} // anonymous namespace
+
+TEST(sh_task_graph, empty)
+{
+	sh::thread_pool<> pool(2);
+	task_graph<> x;
+	EXPECT_TRUE(x.empty());
+	x.run(pool);
+}
+TEST(sh_task_graph, diamond)
+{
+	manual_executor executor;
+	order log;
+	task_graph<> x;
+	const auto a = x.emplace([&log]() { log.push(0); });
+	const auto b = x.emplace([&log]() { log.push(1); });
+	const auto c = x.emplace([&log]() { log.push(2); });
+	const auto d = x.emplace([&log]() { log.push(3); });
+	x.precede(a, b);
+	x.precede(a, c);
+	x.precede(b, d);
+	x.precede(c, d);
+	EXPECT_EQ(x.size(), 4);
+	x.run(executor);
+	ASSERT_EQ(log.m_ids.size(), 4);
+	EXPECT_EQ(log.m_ids.front(), 0);
+	EXPECT_EQ(log.m_ids.back(), 3);
+	// Only the root and the first of b and c to become ready needed submitting.
+	EXPECT_EQ(executor.m_tasks.size(), 2);
+}
+TEST(sh_task_graph, rerun)
+{
+	sh::thread_pool<> pool(3);
+	std::atomic<int> value{ 0 };
+	task_graph<> x(16, 16);
+	std::vector<task_graph<>::node_id> chain;
+	for (int i = 0; i < 10; ++i)
+	{
+		chain.push_back(x.emplace([&value, i]()
+		{
+			EXPECT_EQ(value.load() % 10, i);
+			value.fetch_add(1);
+		}));
+		if (i > 0)
+		{
+			x.precede(chain[i - 1], chain[i]);
+		}
+	}
+	for (int run = 1; run <= 5; ++run)
+	{
+		x.run(pool);
+		EXPECT_EQ(value, run * 10);
+	}
+}
+TEST(sh_task_graph, layers)
+{
+	sh::thread_pool<> pool(4);
+	constexpr int width = 32;
+	constexpr int depth = 8;
+	order log;
+	task_graph<> x;
+	std::vector<task_graph<>::node_id> previous, current;
+	for (int layer = 0; layer < depth; ++layer)
+	{
+		current.clear();
+		for (int i = 0; i < width; ++i)
+		{
+			const int id = layer * width + i;
+			current.push_back(x.emplace([&log, id]() { log.push(id); }));
+			for (const task_graph<>::node_id before : previous)
+			{
+				if ((before + i) % 3 == 0)
+				{
+					x.precede(before, current.back());
+				}
+			}
+		}
+		std::swap(previous, current);
+	}
+	x.run(pool);
+	ASSERT_EQ(log.m_ids.size(), std::size_t{ width * depth });
+	for (int layer = 1; layer < depth; ++layer)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			for (int before = (layer - 1) * width; before < layer * width; ++before)
+			{
+				if ((before + i) % 3 == 0)
+				{
+					EXPECT_LT(log.position(before), log.position(layer * width + i));
+				}
+			}
+		}
+	}
+}
+TEST(sh_task_graph, clear)
+{
+	sh::thread_pool<> pool(2);
+	std::atomic<int> value{ 0 };
+	task_graph<> x;
+	const auto a = x.emplace([&value]() { value.fetch_add(1); });
+	const auto b = x.emplace([&value]() { value.fetch_add(10); });
+	x.precede(a, b);
+	x.run(pool);
+	EXPECT_EQ(value, 11);
+
+	x.clear();
+	EXPECT_TRUE(x.empty());
+	x.emplace([&value]() { value.fetch_add(100); });
+	x.run(pool);
+	EXPECT_EQ(value, 111);
+}
+TEST(sh_task_graph, submit_throws)
+{
+	refusing_executor executor;
+	std::atomic<int> ran{ 0 };
+	task_graph<> x;
+	const auto root = x.emplace([&ran]() { ++ran; });
+	for (int i = 0; i < 8; ++i)
+	{
+		x.precede(root, x.emplace([&ran]() { ++ran; }));
+	}
+	x.emplace([&ran]() { ++ran; });
+	x.run(executor);
+	EXPECT_EQ(ran.load(), 10);
+	EXPECT_GT(executor.m_submits, executor.m_executor.m_tasks.size());
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <sh/thread_pool.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using sh::thread_pool;
+
+namespace
+{
+	struct counter final
+	{
+		std::atomic<int>* m_value;
+
+		counter(std::atomic<int>* const value)
+			: m_value(value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		~counter()
+		{
+			if (m_value != nullptr)
+			{
+				--(*m_value);
+			}
+		}
+		counter(const counter& other)
+			: m_value(other.m_value)
+		{
+			if (m_value != nullptr)
+			{
+				++(*m_value);
+			}
+		}
+		counter(counter&& other) noexcept
+			: m_value(std::exchange(other.m_value, nullptr))
+		{ }
+		counter& operator=(const counter&) = delete;
+		counter& operator=(counter&&) = delete;
+	};
+
+	/**	Help the pool until value reaches target.
+	 */
+	template <typename Pool>
+	void wait_for(Pool& pool, const std::atomic<int>& value, const int target)
+	{
+		while (value.load() < target)
+		{
+			if (false == pool.try_run_one())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	/**	Recursively submit tasks forming a binary tree of the given depth.
+	 */
+	template <typename Pool>
+	void spawn_tree(Pool& pool, std::atomic<int>& done, const int depth)
+	{
+		done.fetch_add(1);
+		if (depth > 0)
+		{
+			pool.submit([&pool, &done, depth]() { spawn_tree(pool, done, depth - 1); });
+			pool.submit([&pool, &done, depth]() { spawn_tree(pool, done, depth - 1); });
+		}
+	}
+} // anonymous namespace
+
+TEST(sh_thread_pool, thread_count)
+{
+	thread_pool<> x(3);
+	EXPECT_EQ(x.thread_count(), 3);
+}
+TEST(sh_thread_pool, submit)
+{
+	thread_pool<> x(4);
+	std::atomic<int> done{ 0 };
+	for (int i = 0; i < 1000; ++i)
+	{
+		x.submit([&done]() { done.fetch_add(1); });
+	}
+	wait_for(x, done, 1000);
+	EXPECT_EQ(done, 1000);
+}
+TEST(sh_thread_pool, submit_nested)
+{
+	thread_pool<> x(4);
+	std::atomic<int> done{ 0 };
+	x.submit([&x, &done]() { spawn_tree(x, done, 12); });
+	wait_for(x, done, (1 << 13) - 1);
+	EXPECT_EQ(done, (1 << 13) - 1);
+}
+TEST(sh_thread_pool, submit_overflow)
+{
+	// Small deques force nested submissions through the external queue.
+	thread_pool<> x(2, 4);
+	std::atomic<int> done{ 0 };
+	x.submit([&x, &done]() { spawn_tree(x, done, 8); });
+	wait_for(x, done, (1 << 9) - 1);
+	EXPECT_EQ(done, (1 << 9) - 1);
+}
+TEST(sh_thread_pool, destroy_tasks)
+{
+	std::atomic<int> value{ 0 };
+	std::atomic<int> done{ 0 };
+	{
+		thread_pool<sizeof(void*) * 2> x(2);
+		for (int i = 0; i < 100; ++i)
+		{
+			x.submit([&done, c = counter(&value)]() { done.fetch_add(1); });
+		}
+	}
+	EXPECT_EQ(done, 100);
+	EXPECT_EQ(value, 0);
+}
+TEST(sh_thread_pool, destroy_drains_nested)
+{
+	std::atomic<int> done{ 0 };
+	{
+		thread_pool<> x(3);
+		x.submit([&x, &done]() { spawn_tree(x, done, 10); });
+	}
+	EXPECT_EQ(done, (1 << 11) - 1);
+}
+TEST(sh_thread_pool, external_threads)
+{
+	thread_pool<> x(2, 16);
+	std::atomic<int> done{ 0 };
+	std::vector<std::thread> submitters;
+	for (int t = 0; t < 4; ++t)
+	{
+		submitters.emplace_back([&x, &done]()
+		{
+			for (int i = 0; i < 500; ++i)
+			{
+				x.submit([&done]() { done.fetch_add(1); });
+			}
+		});
+	}
+	for (std::thread& submitter : submitters)
+	{
+		submitter.join();
+	}
+	wait_for(x, done, 2000);
+	EXPECT_EQ(done, 2000);
+}
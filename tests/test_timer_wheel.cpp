@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+
+#include <sh/timer_wheel.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using sh::timer_wheel;
+
+namespace
+{
+	/**	Counts destructions of non-moved-from instances.
+	 */
+	struct destruct_counter final
+	{
+		explicit destruct_counter(int& count) noexcept
+			: m_count{ &count }
+		{ }
+		destruct_counter(destruct_counter&& other) noexcept
+			: m_count{ std::exchange(other.m_count, nullptr) }
+		{ }
+		~destruct_counter()
+		{
+			if (m_count != nullptr)
+			{
+				++*m_count;
+			}
+		}
+		void operator()() const noexcept
+		{ }
+
+		int* m_count;
+	};
+} // anonymous namespace
+
+TEST(sh_timer_wheel, empty)
+{
+	timer_wheel<> x;
+	EXPECT_TRUE(x.empty());
+	EXPECT_EQ(x.advance(1000), 0u);
+	EXPECT_EQ(x.now(), 1000u);
+	EXPECT_FALSE(x.pending(timer_wheel<>::handle{}));
+	EXPECT_FALSE(x.cancel(timer_wheel<>::handle{}));
+	EXPECT_FALSE(x.rearm(timer_wheel<>::handle{}, 1));
+}
+TEST(sh_timer_wheel, fires_on_tick)
+{
+	timer_wheel<> x{ 100 };
+	std::uint64_t fired_at = 0;
+	const auto timer = x.schedule(5, [&x, &fired_at]() { fired_at = x.now(); });
+	EXPECT_TRUE(x.pending(timer));
+	EXPECT_EQ(x.size(), 1u);
+	EXPECT_EQ(x.advance(4), 0u);
+	EXPECT_EQ(fired_at, 0u);
+	EXPECT_EQ(x.advance(1), 1u);
+	EXPECT_EQ(fired_at, 105u);
+	EXPECT_FALSE(x.pending(timer));
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_timer_wheel, zero_delay)
+{
+	timer_wheel<> x;
+	int fired = 0;
+	x.schedule(0, [&fired]() { ++fired; });
+	EXPECT_EQ(x.advance(0), 0u);
+	EXPECT_EQ(x.advance(1), 1u);
+	EXPECT_EQ(fired, 1);
+}
+TEST(sh_timer_wheel, cancel)
+{
+	int destroyed = 0;
+	timer_wheel<> x;
+	const auto timer = x.schedule(10, destruct_counter{ destroyed });
+	EXPECT_TRUE(x.cancel(timer));
+	EXPECT_EQ(destroyed, 1);
+	EXPECT_FALSE(x.cancel(timer));
+	EXPECT_FALSE(x.pending(timer));
+	EXPECT_EQ(x.advance(20), 0u);
+}
+TEST(sh_timer_wheel, stale_handle)
+{
+	timer_wheel<> x;
+	const auto first = x.schedule(1, []() {});
+	x.advance(1);
+	// Reuses the freed node under a new generation.
+	const auto second = x.schedule(1, []() {});
+	EXPECT_EQ(first.m_index, second.m_index);
+	EXPECT_NE(first, second);
+	EXPECT_FALSE(x.cancel(first));
+	EXPECT_TRUE(x.pending(second));
+}
+TEST(sh_timer_wheel, rearm)
+{
+	timer_wheel<> x;
+	std::uint64_t fired_at = 0;
+	const auto timer = x.schedule(10, [&x, &fired_at]() { fired_at = x.now(); });
+	x.advance(8);
+	EXPECT_TRUE(x.rearm(timer, 10));
+	EXPECT_EQ(x.size(), 1u);
+	x.advance(9);
+	EXPECT_EQ(fired_at, 0u);
+	x.advance(1);
+	EXPECT_EQ(fired_at, 18u);
+	EXPECT_FALSE(x.rearm(timer, 10));
+}
+TEST(sh_timer_wheel, periodic)
+{
+	timer_wheel<> x;
+	std::vector<std::uint64_t> fired_at;
+	timer_wheel<>::handle timer;
+	timer = x.schedule(300, [&x, &fired_at, &timer]()
+	{
+		fired_at.push_back(x.now());
+		if (fired_at.size() < 3)
+		{
+			EXPECT_TRUE(x.rearm(timer, 300));
+		}
+	});
+	EXPECT_EQ(x.advance(2000), 3u);
+	EXPECT_EQ(fired_at, (std::vector<std::uint64_t>{ 300, 600, 900 }));
+	EXPECT_FALSE(x.pending(timer));
+}
+TEST(sh_timer_wheel, cancel_while_firing)
+{
+	int destroyed = 0;
+	timer_wheel<> x;
+	timer_wheel<>::handle self;
+	timer_wheel<>::handle other;
+	self = x.schedule(1, [&x, &self, &other, counter = destruct_counter{ destroyed }]()
+	{
+		EXPECT_FALSE(x.pending(self));
+		EXPECT_FALSE(x.cancel(self));
+		EXPECT_TRUE(x.rearm(self, 5));
+		EXPECT_TRUE(x.cancel(self));
+		EXPECT_TRUE(x.cancel(other));
+	});
+	other = x.schedule(2, destruct_counter{ destroyed });
+	const auto fired = x.advance(10);
+	EXPECT_EQ(fired, 1u);
+	EXPECT_EQ(destroyed, 2);
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_timer_wheel, levels)
+{
+	timer_wheel<> x{ 12345 };
+	std::vector<std::uint64_t> delays{ 1, 255, 256, 257, 65535, 65536, 65537, 70000, (1u << 24) + 5 };
+	std::vector<std::uint64_t> fired_at(delays.size());
+	for (std::size_t i = 0; i < delays.size(); ++i)
+	{
+		x.schedule(delays[i], [&x, &fired_at, i]() { fired_at[i] = x.now(); });
+	}
+	EXPECT_EQ(x.advance((1u << 24) + 5), delays.size());
+	for (std::size_t i = 0; i < delays.size(); ++i)
+	{
+		EXPECT_EQ(fired_at[i], 12345 + delays[i]);
+	}
+}
+TEST(sh_timer_wheel, beyond_span)
+{
+	timer_wheel<sizeof(void*) * 6, 1> x{ 7 };
+	std::uint64_t fired_at = 0;
+	x.schedule(1000, [&x, &fired_at]() { fired_at = x.now(); });
+	x.advance(999);
+	EXPECT_EQ(fired_at, 0u);
+	x.advance(1);
+	EXPECT_EQ(fired_at, 1007u);
+}
+TEST(sh_timer_wheel, random)
+{
+	std::mt19937_64 random{ 42 };
+	timer_wheel<sizeof(void*) * 6, 2> x{ 0, 4096 };
+	std::vector<std::uint64_t> expected;
+	std::vector<std::uint64_t> fired_at;
+	std::vector<timer_wheel<sizeof(void*) * 6, 2>::handle> handles;
+	for (std::size_t i = 0; i < 4096; ++i)
+	{
+		const std::uint64_t delay = 1 + random() % 200000;
+		expected.push_back(delay);
+		fired_at.push_back(0);
+		handles.push_back(x.schedule(delay, [&x, &fired_at, i]() { fired_at[i] = x.now(); }));
+	}
+	for (std::size_t i = 0; i < handles.size(); i += 3)
+	{
+		EXPECT_TRUE(x.cancel(handles[i]));
+		expected[i] = 0;
+	}
+	std::uint64_t now = 0;
+	while (false == x.empty())
+	{
+		now += 1 + random() % 1000;
+		x.advance_to(now);
+	}
+	EXPECT_EQ(fired_at, expected);
+}
+TEST(sh_timer_wheel, throwing_callback)
+{
+	timer_wheel<> x;
+	int fired = 0;
+	x.schedule(1, []() { throw std::runtime_error{ "timer" }; });
+	x.schedule(1, [&fired]() { ++fired; });
+	x.schedule(1, [&fired]() { ++fired; });
+	for (int attempt = 0; attempt < 3 && fired < 2; ++attempt)
+	{
+		try
+		{
+			x.advance(1);
+		}
+		catch (const std::runtime_error&)
+		{ }
+	}
+	EXPECT_EQ(fired, 2);
+	EXPECT_TRUE(x.empty());
+}
+TEST(sh_timer_wheel, destroys_pending)
+{
+	int destroyed = 0;
+	{
+		timer_wheel<> x;
+		x.schedule(10, destruct_counter{ destroyed });
+		x.schedule(100000, destruct_counter{ destroyed });
+	}
+	EXPECT_EQ(destroyed, 2);
+}